@@ -0,0 +1,549 @@
+#include <string.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include <fmt/format.h>
+#include "ws/network/ServerSocket.h"
+#include "ws/network/HttpServer.h"
+#include "ws/core/Histogram.h"
+
+using namespace ws::network;
+using namespace std::chrono;
+
+namespace
+{
+	//消息格式：4字节总长度 + 4字节连接序号 + 8字节发送时间（纳秒） + 填充
+	constexpr size_t HEADER_SIZE = 16;
+	//http模式下的请求和服务器的固定响应
+	constexpr std::string_view HTTP_REQUEST = "GET /health HTTP/1.1\r\nHost: localhost\r\n\r\n";
+	constexpr std::string_view HTTP_RESPONSE = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+
+	enum class BenchMode
+	{
+		ECHO,		//原样回显给发送者
+		BROADCAST,	//每条消息广播给所有连接
+		HTTP,		//HttpServer的健康检查，depth为管线化的请求数
+	};
+
+	struct BenchConfig
+	{
+		BenchMode				mode = BenchMode::ECHO;
+		std::vector<int>		connections = { 64 };
+		std::vector<size_t>		messageSizes = { 64 };
+		std::vector<int>		depths = { 1 };			//每个连接同时在途的消息数
+		int						numThreads = 4;			//压测客户端的线程数
+		int						duration = 5;			//每组参数的压测秒数
+		uint16_t				numIOThreads = 1;
+		IOBackend				backend = IOBackend::EPOLL;
+		bool					busyPoll = false;
+		bool					pollInUpdate = false;
+		std::vector<int>		ioThreadCpus;
+		std::string				address = "127.0.0.1";	//IPv4、IPv6或"unix:"开头的unix socket路径
+		uint16_t				port = 20500;
+	};
+
+	struct BenchResult
+	{
+		Histogram				latency;		//往返延迟，纳秒
+		uint64_t				messages = 0;
+		uint64_t				bytes = 0;
+		bool					isFailed = false;
+	};
+
+	class EchoClient : public Client
+	{
+	protected:
+		void onRecv() override
+		{
+			send(readerBuffer.readerPointer(), readerBuffer.readAvailable());
+			readerBuffer.truncate();
+		}
+	};
+
+	class BroadcastClient : public Client
+	{
+	protected:
+		void onPacket(std::span<const uint8_t> frame) override
+		{
+			server->broadcast(std::make_shared<const ByteArray>(frame.data(), frame.size(), true));
+		}
+	};
+
+	inline uint64_t nowNanos()
+	{
+		return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	//一个压测线程负责的连接
+	struct Connection
+	{
+		int						fd = -1;
+		uint32_t				index = 0;
+		std::string				received;
+		std::string				pending;		//未能一次写完的数据
+		std::deque<uint64_t>	sendTimes;		//http模式下在途请求的发送时间，响应按顺序返回
+		bool					isBlocked = false;
+	};
+
+	class LoadGenerator
+	{
+	public:
+		LoadGenerator(const BenchConfig& cfg, size_t size, int depth) : config(cfg), messageSize(size), depth(depth) {}
+
+		bool connect(uint32_t firstIndex, int count)
+		{
+			epfd = epoll_create1(EPOLL_CLOEXEC);
+			sockaddr_storage addr;
+			socklen_t addrLength = 0;
+			if (!resolveAddress(config.address, config.port, addr, addrLength))
+			{
+				return false;
+			}
+			connections.resize(count);
+			for (int i = 0; i < count; ++i)
+			{
+				auto& connection = connections[i];
+				connection.index = firstIndex + i;
+				connection.fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+				if (::connect(connection.fd, (sockaddr*)&addr, addrLength) != 0)
+				{
+					spdlog::error("bench connect error: {}", strerror(errno));
+					return false;
+				}
+				if (addr.ss_family != AF_UNIX)
+				{
+					int flag = 1;
+					setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+				}
+				fcntl(connection.fd, F_SETFL, fcntl(connection.fd, F_GETFL) | O_NONBLOCK);
+				epoll_event ev;
+				ev.events = EPOLLIN;
+				ev.data.ptr = &connection;
+				epoll_ctl(epfd, EPOLL_CTL_ADD, connection.fd, &ev);
+			}
+			return true;
+		}
+
+		void run(const std::atomic_bool& isRunning, BenchResult& result)
+		{
+			for (auto& connection : connections)
+			{
+				for (int i = 0; i < depth; ++i)
+				{
+					sendMessage(connection);
+				}
+			}
+			epoll_event events[EPOLL_SIZE];
+			while (isRunning && !result.isFailed)
+			{
+				int eventCount = epoll_wait(epfd, events, EPOLL_SIZE, 10);
+				for (int i = 0; i < eventCount; ++i)
+				{
+					auto& connection = *(Connection*)events[i].data.ptr;
+					if (events[i].events & EPOLLOUT)
+					{
+						flush(connection);
+					}
+					if ((events[i].events & EPOLLIN) && !onReadable(connection, isRunning, result))
+					{
+						result.isFailed = true;
+					}
+				}
+			}
+		}
+
+		~LoadGenerator()
+		{
+			for (auto& connection : connections)
+			{
+				if (connection.fd != -1)
+				{
+					::close(connection.fd);
+				}
+			}
+			if (epfd != -1)
+			{
+				::close(epfd);
+			}
+		}
+
+	private:
+		const BenchConfig&		config;
+		size_t					messageSize;
+		int						depth;
+		int						epfd = -1;
+		std::vector<Connection>	connections;
+
+		void sendMessage(Connection& connection)
+		{
+			if (config.mode == BenchMode::HTTP)
+			{
+				connection.sendTimes.push_back(nowNanos());
+				connection.pending += HTTP_REQUEST;
+				flush(connection);
+				return;
+			}
+			size_t offset = connection.pending.size();
+			connection.pending.resize(offset + messageSize);
+			char* message = connection.pending.data() + offset;
+			uint32_t length = (uint32_t)messageSize;
+			uint64_t sendTime = nowNanos();
+			memcpy(message, &length, sizeof(length));
+			memcpy(message + 4, &connection.index, sizeof(connection.index));
+			memcpy(message + 8, &sendTime, sizeof(sendTime));
+			flush(connection);
+		}
+
+		void flush(Connection& connection)
+		{
+			while (!connection.pending.empty())
+			{
+				ssize_t length = ::send(connection.fd, connection.pending.data(), connection.pending.size(), MSG_NOSIGNAL);
+				if (length <= 0)
+				{
+					break;
+				}
+				connection.pending.erase(0, length);
+			}
+			// 缓冲区满时等待可写
+			bool isBlocked = !connection.pending.empty();
+			if (isBlocked != connection.isBlocked)
+			{
+				connection.isBlocked = isBlocked;
+				epoll_event ev;
+				ev.events = isBlocked ? EPOLLIN | EPOLLOUT : EPOLLIN;
+				ev.data.ptr = &connection;
+				epoll_ctl(epfd, EPOLL_CTL_MOD, connection.fd, &ev);
+			}
+		}
+
+		bool onReadable(Connection& connection, const std::atomic_bool& isRunning, BenchResult& result)
+		{
+			char buffer[64 * 1024];
+			ssize_t length = recv(connection.fd, buffer, sizeof(buffer), 0);
+			if (length == 0 || (length < 0 && errno != EAGAIN && errno != EINTR))
+			{
+				spdlog::error("bench connection {} closed", connection.index);
+				return false;
+			}
+			if (length < 0)
+			{
+				return true;
+			}
+			connection.received.append(buffer, length);
+			uint64_t now = nowNanos();
+			size_t offset = 0;
+			while (connection.received.size() - offset >= messageSize)
+			{
+				const char* message = connection.received.data() + offset;
+				uint32_t index = connection.index;
+				uint64_t sendTime;
+				if (config.mode == BenchMode::HTTP)
+				{
+					if (std::string_view(message, messageSize) != HTTP_RESPONSE)
+					{
+						spdlog::error("bench connection {} unexpected http response", connection.index);
+						return false;
+					}
+					sendTime = connection.sendTimes.front();
+					connection.sendTimes.pop_front();
+				}
+				else
+				{
+					memcpy(&index, message + 4, sizeof(index));
+					memcpy(&sendTime, message + 8, sizeof(sendTime));
+				}
+				result.latency.record(now - sendTime);
+				++result.messages;
+				result.bytes += messageSize;
+				offset += messageSize;
+				// 广播模式下只有自己发出的消息返回时才补发
+				if (index == connection.index && isRunning)
+				{
+					sendMessage(connection);
+				}
+			}
+			connection.received.erase(0, offset);
+			return true;
+		}
+	};
+
+	//启动服务器，连接全部建立后压测duration秒
+	bool runBench(const BenchConfig& config, int numConnections, size_t messageSize, int depth)
+	{
+		ServerConfig serverConfig;
+		serverConfig.listenAddr = config.address;
+		serverConfig.listenPort = config.port;
+		serverConfig.numIOThreads = config.numIOThreads;
+		serverConfig.ioBackend = config.backend;
+		serverConfig.tcpNoDelay = true;
+		serverConfig.maxAcceptsPerLoop = 0;
+		serverConfig.busyPoll = config.busyPoll;
+		serverConfig.pollInUpdate = config.pollInUpdate;
+		serverConfig.ioThreadCpus = config.ioThreadCpus;
+		std::unique_ptr<ServerSocket> server;
+		if (config.mode == BenchMode::ECHO)
+		{
+			serverConfig.createClient = []() { return std::make_shared<EchoClient>(); };
+			server = std::make_unique<ServerSocket>();
+		}
+		else if (config.mode == BenchMode::HTTP)
+		{
+			auto httpServer = std::make_unique<HttpServer>();
+			auto body = std::make_shared<const ByteArray>("ok", 2, true);
+			httpServer->get("/health", [body](const HttpServerRequest& request, HttpServerResponse& response) { response.write(body); });
+			server = std::move(httpServer);
+		}
+		else
+		{
+			serverConfig.frame.mode = FrameMode::LENGTH_PREFIX;
+			serverConfig.frame.headerSize = 4;
+			serverConfig.frame.lengthBytes = 4;
+			serverConfig.frame.lengthIncludesHeader = true;
+			serverConfig.frame.maxFrameSize = (uint32_t)std::max<size_t>(messageSize, 64 * 1024);
+			serverConfig.createClient = []() { return std::make_shared<BroadcastClient>(); };
+			server = std::make_unique<ServerSocket>();
+		}
+		if (!server->init(serverConfig) || !server->startListen())
+		{
+			return false;
+		}
+
+		int numThreads = std::max(1, std::min(config.numThreads, numConnections));
+		std::vector<std::unique_ptr<LoadGenerator>> generators;
+		std::vector<BenchResult> results(numThreads);
+		std::vector<std::thread> threads;
+		std::atomic_int numConnected = 0, numDone = 0;
+		std::atomic_bool isStarted = false, isRunning = true;
+		for (int i = 0; i < numThreads; ++i)
+		{
+			generators.emplace_back(std::make_unique<LoadGenerator>(config, messageSize, depth));
+		}
+
+		auto connectStart = steady_clock::now();
+		for (int i = 0; i < numThreads; ++i)
+		{
+			int first = numConnections * i / numThreads;
+			int count = numConnections * (i + 1) / numThreads - first;
+			threads.emplace_back([&, i, first, count]()
+				{
+					if (!generators[i]->connect(first, count))
+					{
+						results[i].isFailed = true;
+					}
+					++numConnected;
+					while (!isStarted)
+					{
+						std::this_thread::yield();
+					}
+					if (!results[i].isFailed)
+					{
+						generators[i]->run(isRunning, results[i]);
+					}
+					++numDone;
+				});
+		}
+		//服务器接受全部连接后才开始计时
+		while (server->numOnlines() < (uint32_t)numConnections || numConnected < numThreads)
+		{
+			server->update();
+			if (steady_clock::now() - connectStart > 10s)
+			{
+				break;
+			}
+		}
+		auto connectSeconds = duration_cast<duration<double>>(steady_clock::now() - connectStart).count();
+
+		isStarted = true;
+		auto start = steady_clock::now();
+		auto deadline = start + seconds(config.duration);
+		while (steady_clock::now() < deadline)
+		{
+			server->update();
+		}
+		isRunning = false;
+		auto runSeconds = duration_cast<duration<double>>(steady_clock::now() - start).count();
+		while (numDone < numThreads)
+		{
+			server->update();
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		generators.clear();
+
+		BenchResult total;
+		for (auto& result : results)
+		{
+			total.latency.merge(result.latency);
+			total.messages += result.messages;
+			total.bytes += result.bytes;
+			total.isFailed = total.isFailed || result.isFailed;
+		}
+		const char* modeName = config.mode == BenchMode::ECHO ? "echo" : config.mode == BenchMode::HTTP ? "http" : "broadcast";
+		std::cout << fmt::format("{:>9} {:>6} {:>6} {:>5} {:>10.0f} {:>12.0f} {:>10.2f} {:>9.1f} {:>9.1f} {:>9.1f}{}",
+			modeName, numConnections, messageSize, depth,
+			numConnections / connectSeconds, total.messages / runSeconds, total.bytes / runSeconds / (1024 * 1024),
+			total.latency.percentile(0.5) / 1000.0, total.latency.percentile(0.99) / 1000.0,
+			total.latency.percentile(0.999) / 1000.0, total.isFailed ? "  FAILED" : "") << std::endl;
+		return !total.isFailed;
+	}
+
+	template<typename T>
+	std::vector<T> parseList(const std::string& str)
+	{
+		std::vector<T> values;
+		size_t start = 0;
+		while (start <= str.size())
+		{
+			size_t end = str.find(',', start);
+			end = end == std::string::npos ? str.size() : end;
+			values.push_back((T)std::stoull(str.substr(start, end - start)));
+			start = end + 1;
+		}
+		return values;
+	}
+
+	void printUsage()
+	{
+		std::cout << "usage: wsbench_net [options]\n"
+			"  --mode echo|broadcast|http\n"
+			"                            server behaviour, http answers pipelined GET /health (default echo)\n"
+			"  --connections N[,N...]    connection counts to sweep (default 64)\n"
+			"  --size N[,N...]           message sizes in bytes, at least 16, ignored by http (default 64)\n"
+			"  --depth N[,N...]          in-flight messages per connection (default 1)\n"
+			"  --threads N               load generator threads (default 4)\n"
+			"  --duration N              seconds per run (default 5)\n"
+			"  --io-threads N            server I/O threads (default 1)\n"
+			"  --backend epoll|io_uring  server I/O backend (default epoll)\n"
+			"  --busy-poll 0|1           spin the server I/O threads instead of blocking\n"
+			"  --poll-in-update 0|1      poll I/O inside ServerSocket::update, no I/O thread\n"
+			"  --cpus N[,N...]           pin server I/O thread i to the i-th cpu\n"
+			"  --address ADDR            listen address, IPv4, IPv6 or unix:PATH (default 127.0.0.1)\n"
+			"  --port N                  loopback port (default 20500)" << std::endl;
+	}
+
+	bool parseArgs(int argc, char* argv[], BenchConfig& config)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string name = argv[i];
+			if (name == "--help" || i + 1 >= argc)
+			{
+				return false;
+			}
+			std::string value = argv[++i];
+			if (name == "--mode")
+			{
+				config.mode = value == "broadcast" ? BenchMode::BROADCAST : value == "http" ? BenchMode::HTTP : BenchMode::ECHO;
+			}
+			else if (name == "--connections")
+			{
+				config.connections = parseList<int>(value);
+			}
+			else if (name == "--size")
+			{
+				config.messageSizes = parseList<size_t>(value);
+			}
+			else if (name == "--depth")
+			{
+				config.depths = parseList<int>(value);
+			}
+			else if (name == "--threads")
+			{
+				config.numThreads = std::stoi(value);
+			}
+			else if (name == "--duration")
+			{
+				config.duration = std::stoi(value);
+			}
+			else if (name == "--io-threads")
+			{
+				config.numIOThreads = (uint16_t)std::stoi(value);
+			}
+			else if (name == "--backend")
+			{
+				config.backend = value == "io_uring" ? IOBackend::IO_URING : IOBackend::EPOLL;
+			}
+			else if (name == "--busy-poll")
+			{
+				config.busyPoll = value == "1";
+			}
+			else if (name == "--poll-in-update")
+			{
+				config.pollInUpdate = value == "1";
+			}
+			else if (name == "--cpus")
+			{
+				config.ioThreadCpus = parseList<int>(value);
+			}
+			else if (name == "--address")
+			{
+				config.address = value;
+			}
+			else if (name == "--port")
+			{
+				config.port = (uint16_t)std::stoi(value);
+			}
+			else
+			{
+				return false;
+			}
+		}
+		//http模式按固定的响应长度切分
+		if (config.mode == BenchMode::HTTP)
+		{
+			config.messageSizes = { HTTP_RESPONSE.size() };
+		}
+		for (size_t size : config.messageSizes)
+		{
+			if (size < HEADER_SIZE)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	spdlog::set_level(spdlog::level::warn);
+	BenchConfig config;
+	try
+	{
+		if (!parseArgs(argc, argv, config))
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	catch (const std::exception&)
+	{
+		printUsage();
+		return 1;
+	}
+
+	std::cout << fmt::format("{:>9} {:>6} {:>6} {:>5} {:>10} {:>12} {:>10} {:>9} {:>9} {:>9}",
+		"mode", "conns", "size", "depth", "conn/s", "msg/s", "MB/s", "p50(us)", "p99(us)", "p999(us)") << std::endl;
+	bool result = true;
+	for (int numConnections : config.connections)
+	{
+		for (size_t messageSize : config.messageSizes)
+		{
+			for (int depth : config.depths)
+			{
+				result = runBench(config, numConnections, messageSize, depth) && result;
+			}
+		}
+	}
+	return result ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+#ifndef __WS_CORE_HISTOGRAM_H__
+#define __WS_CORE_HISTOGRAM_H__
+
+#include <stdint.h>
+#include <array>
+#include <bit>
+
+namespace ws
+{
+	namespace core
+	{
+		//HDR直方图，每个2的幂区间分为64个子桶，相对误差小于1/64，记录一次只需一次自增
+		class Histogram
+		{
+		public:
+			inline void record(uint64_t value)
+			{
+				++counts[indexOf(value)];
+				++totalCount;
+			}
+
+			inline void merge(const Histogram& other)
+			{
+				for (size_t i = 0; i < counts.size(); ++i)
+				{
+					counts[i] += other.counts[i];
+				}
+				totalCount += other.totalCount;
+			}
+
+			//返回不小于percentile比例的记录所在桶的上限，percentile取值[0, 1]
+			uint64_t percentile(double percentile) const
+			{
+				uint64_t target = (uint64_t)(percentile * totalCount + 0.5);
+				target = target ? target : 1;
+				uint64_t count = 0;
+				for (size_t i = 0; i < counts.size(); ++i)
+				{
+					count += counts[i];
+					if (count >= target)
+					{
+						return highestValueOf(i);
+					}
+				}
+				return 0;
+			}
+
+			inline uint64_t count() const { return totalCount; }
+
+			inline void clear()
+			{
+				counts.fill(0);
+				totalCount = 0;
+			}
+
+		private:
+			static constexpr uint32_t SUB_BUCKET_BITS = 7;
+			static constexpr uint64_t SUB_BUCKET_COUNT = 1ULL << SUB_BUCKET_BITS;
+			static constexpr uint64_t HALF_COUNT = SUB_BUCKET_COUNT / 2;
+
+			// 小于128的值直接作为下标，之后每个2的幂区间占用64个下标
+			static inline size_t indexOf(uint64_t value)
+			{
+				if (value < SUB_BUCKET_COUNT)
+				{
+					return (size_t)value;
+				}
+				uint32_t shift = (63 - std::countl_zero(value)) - (SUB_BUCKET_BITS - 1);
+				return (size_t)((shift + 1) * HALF_COUNT + ((value >> shift) - HALF_COUNT));
+			}
+
+			static inline uint64_t highestValueOf(size_t index)
+			{
+				if (index < SUB_BUCKET_COUNT)
+				{
+					return index;
+				}
+				uint32_t shift = (uint32_t)(index / HALF_COUNT - 1);
+				uint64_t top = HALF_COUNT + index % HALF_COUNT;
+				return ((top + 1) << shift) - 1;
+			}
+
+			std::array<uint64_t, 64 * HALF_COUNT>	counts{};
+			uint64_t								totalCount = 0;
+		};
+	}
+}
+
+#endif	//__WS_CORE_HISTOGRAM_H__
@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace ws
+{
+	namespace core
+	{
+		//无锁单生产者单消费者队列，无容量上限
+		template<class T>
+		class SpscQueue
+		{
+		public:
+			SpscQueue() : head(new Node), tail(head) {}
+			SpscQueue(const SpscQueue&) = delete;
+			~SpscQueue()
+			{
+				while (head)
+				{
+					Node* next = head->next.load(std::memory_order_relaxed);
+					delete head;
+					head = next;
+				}
+			}
+
+			//生产者线程调用
+			void push(T&& value)
+			{
+				Node* node = new Node;
+				node->value.emplace(std::move(value));
+				tail->next.store(node, std::memory_order_release);
+				tail = node;
+			}
+
+			//消费者线程调用，队列为空返回false
+			bool pop(T& value)
+			{
+				Node* next = head->next.load(std::memory_order_acquire);
+				if (!next)
+				{
+					return false;
+				}
+				value = std::move(*next->value);
+				next->value.reset();
+				delete head;
+				head = next;
+				return true;
+			}
+
+			//消费者线程调用，按顺序处理所有元素，返回处理的个数
+			template<class Callback>
+			size_t consume(Callback&& callback)
+			{
+				size_t count = 0;
+				Node* next = head->next.load(std::memory_order_acquire);
+				while (next)
+				{
+					callback(std::move(*next->value));
+					next->value.reset();
+					delete head;
+					head = next;
+					next = head->next.load(std::memory_order_acquire);
+					++count;
+				}
+				return count;
+			}
+
+			//消费者线程调用
+			bool empty() const { return !head->next.load(std::memory_order_acquire); }
+
+		private:
+			struct Node
+			{
+				std::optional<T>	value;	//哨兵节点为空
+				std::atomic<Node*>	next = nullptr;
+			};
+			Node*		head;	//消费者持有，指向已消费的哨兵节点
+			Node*		tail;	//生产者持有
+		};
+
+		//无锁多生产者单消费者队列，消费者一次取走全部元素
+		template<class T>
+		class MpscQueue
+		{
+		public:
+			MpscQueue() = default;
+			MpscQueue(const MpscQueue&) = delete;
+			~MpscQueue() { consume([](T&&) {}); }
+
+			//任意线程调用
+			void push(T&& value)
+			{
+				Node* node = new Node{ std::move(value), top.load(std::memory_order_relaxed) };
+				while (!top.compare_exchange_weak(node->next, node,
+					std::memory_order_release, std::memory_order_relaxed));
+			}
+
+			//消费者线程调用，按入队顺序处理所有元素，返回处理的个数
+			template<class Callback>
+			size_t consume(Callback&& callback)
+			{
+				Node* node = top.exchange(nullptr, std::memory_order_acquire);
+				// 栈顶是最后入队的元素，先反转
+				Node* reversed = nullptr;
+				while (node)
+				{
+					Node* next = node->next;
+					node->next = reversed;
+					reversed = node;
+					node = next;
+				}
+				size_t count = 0;
+				while (reversed)
+				{
+					Node* next = reversed->next;
+					callback(std::move(reversed->value));
+					delete reversed;
+					reversed = next;
+					++count;
+				}
+				return count;
+			}
+
+			bool empty() const { return !top.load(std::memory_order_acquire); }
+
+		private:
+			struct Node
+			{
+				T			value;
+				Node*		next;
+			};
+			std::atomic<Node*>	top = nullptr;
+		};
+	}
+}
@@ -181,6 +181,9 @@ namespace ws::core::String
 	//生成随机字符串，length指定长度，chars指定取值内容，未指定则使用大小写字母和数字
 	std::string random(uint16_t length, const char* chars = nullptr);
 
+	//忽略ASCII大小写比较，用于协议头的名字和取值
+	bool iequals(std::string_view a, std::string_view b);
+
 	std::string_view ltrim(std::string_view sv);
 	std::string_view rtrim(std::string_view sv);
 	inline std::string_view trim(std::string_view sv)
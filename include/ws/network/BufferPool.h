@@ -0,0 +1,63 @@
+#ifndef __WS_BUFFER_POOL_H__
+#define __WS_BUFFER_POOL_H__
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "ws/network/NetDef.h"
+#include "ws/core/ByteArray.h"
+
+namespace ws
+{
+	namespace network
+	{
+		//按容量分级的缓冲区池，I/O线程分配、update线程归还
+		//规格为BUFFER_SIZE的2的幂倍，与ByteArray扩容的倍数一致
+		//每个线程先使用自己的缓存，不加锁，缓存空了或满了才批量与共享链表交换
+		class BufferPool
+		{
+		public:
+			BufferPool() = default;
+			BufferPool(const BufferPool&) = delete;
+
+			//获取容量不小于size的空缓冲区，任意线程调用
+			ws::core::ByteArray alloc(size_t size = BUFFER_SIZE);
+			//归还缓冲区，容量不符合规格或该级已满时直接释放，任意线程调用
+			void free(ws::core::ByteArray&& bytes);
+
+			//池中空闲的字节数，包括各线程缓存的
+			size_t pooledBytes() const;
+
+		private:
+			static constexpr size_t NUM_CLASSES = 5;	//4K ~ 64K
+			static constexpr size_t MAX_CLASS_BYTES = 4 * 1024 * 1024;	//共享链表每级最多缓存的字节数
+			static constexpr size_t LOCAL_CLASS_BYTES = 512 * 1024;	//每个线程每级最多缓存的字节数
+			static constexpr uint32_t MAX_LOCAL_CACHES = 64;	//超过的线程直接使用共享链表
+
+			struct SizeClass
+			{
+				std::mutex							mtx;
+				std::vector<ws::core::ByteArray>	buffers;
+			};
+			//只由占用该槽位的线程访问，按缓存行对齐避免伪共享
+			struct alignas(64) LocalCache
+			{
+				std::vector<ws::core::ByteArray>	buffers[NUM_CLASSES];
+				std::atomic<size_t>					numBytes = 0;
+			};
+			SizeClass								classes[NUM_CLASSES];
+			std::atomic<size_t>						numSharedBytes = 0;
+			LocalCache								localCaches[MAX_LOCAL_CACHES];
+
+			static size_t classIndex(size_t size);
+			static uint32_t threadSlot();
+			LocalCache* localCache();
+			//从共享链表取出最多count个缓冲区
+			void takeShared(size_t index, std::vector<ws::core::ByteArray>& buffers, size_t count);
+			//把buffers末尾的count个缓冲区放回共享链表，超出上限的直接释放
+			void putShared(size_t index, std::vector<ws::core::ByteArray>& buffers, size_t count);
+		};
+	}
+}
+
+#endif	//__WS_BUFFER_POOL_H__
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <thread>
 #include <mutex>
+#include <memory>
 #include <functional>
 
 #include "ws/network/NetDef.h"
@@ -15,13 +16,18 @@ namespace ws
 {
 	namespace network
 	{
+#ifdef __linux__
+		struct ClientChannel;
+#endif
+
 		class ClientSocket
 		{
 		public:
-			ClientSocket() = default;
+			ClientSocket();
 			ClientSocket(const ClientSocket&) = delete;	//不允许复制
 			virtual ~ClientSocket();
 
+			//linux下ip也可以是IPv6地址或"unix:"开头的unix socket路径
 			void connect(const std::string& ip, uint16_t port);
 			void close();
 
@@ -30,8 +36,13 @@ namespace ws
 			inline bool isConnected() const { return status == SocketStatus::CONNECTED; }
 			inline const std::string& remoteIP() const { return _remoteIP; }
 			inline uint16_t remotePort() const { return _remotePort; }
+			//两次发起连接的最小间隔，由外部控制重连时设为0
+			inline void setConnectCooldown(uint64_t ms) { connectCooldown = ms; }
+			//已调用send但还未写入内核的字节数
+			size_t pendingBytes();
 
 			//发送数据，会复制数据到缓冲区，不必保持数据生命周期
+			//linux下在update中统一发出，未发完的部分由共享的I/O线程在可写时继续发送
 			void send(const ByteArray& packet);
 			void send(const void* data, size_t length);
 
@@ -44,9 +55,11 @@ namespace ws
 			std::string				_remoteIP;
 
 			ByteArray				readerBuffer;
+#ifndef __linux__
 			ByteArray				writerBuffer;
 			std::mutex				readerMtx;
 			std::mutex				writerMtx;
+#endif
 
 		private:
 #ifdef _WIN32
@@ -61,14 +74,25 @@ namespace ws
 			};
 			SocketStatus					lastStatus = SocketStatus::DISCONNECTED;
 			SocketStatus					status = SocketStatus::DISCONNECTED;
+			uint64_t						lastConnectTime = 0;
+			uint64_t						connectCooldown = 3000;
+
+#ifdef __linux__
+			//所有ClientSocket共用一个epoll线程，连接状态由该线程和update线程共享
+			std::shared_ptr<ClientChannel>	channel;
+			bool							isConnectStarted = false;	//冷却结束后才发起连接
+
+			void					startConnect();
+			void					flush();
+#else
 			Socket							sockfd = 0;
 			std::thread						workerThread;
 			bool							isExit = false;
-			uint64_t						lastConnectTime = 0;
 
 			void					workerProc();
 			bool					tryToRecv();
 			bool					tryToSend();
+#endif
 			void					reset();
 		};
 	}
@@ -0,0 +1,80 @@
+#ifndef __WS_CLIENT_SOCKET_POOL_H__
+#define __WS_CLIENT_SOCKET_POOL_H__
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include "ws/network/ClientSocket.h"
+
+namespace ws
+{
+	namespace network
+	{
+		enum class BalancePolicy
+		{
+			ROUND_ROBIN,
+			LEAST_PENDING,		//选择未发出字节数最少的连接
+		};
+
+		struct ClientPoolConfig
+		{
+			size_t					connectionsPerUpstream = 4;
+			BalancePolicy			policy = BalancePolicy::LEAST_PENDING;
+			//断开后按指数退避重连，实际等待时间在[delay/2, delay]之间随机，避免同时重连
+			uint64_t				minReconnectDelay = 100;		//毫秒
+			uint64_t				maxReconnectDelay = 30000;		//毫秒
+		};
+
+		//对每个上游保持多个连接，请求不等待响应直接发出，响应按连接内的顺序返回
+		//所有连接共用ClientSocket的I/O线程，在update线程中使用
+		class ClientSocketPool
+		{
+		public:
+			ClientSocketPool(const ClientPoolConfig& cfg = ClientPoolConfig());
+			ClientSocketPool(const ClientSocketPool&) = delete;
+
+			//返回上游的序号，立即发起连接
+			size_t					addUpstream(const std::string& ip, uint16_t port);
+			void					update();
+
+			//按策略选择一个已连接的连接，全部断开时返回nullptr
+			ClientSocket*			select(size_t upstream);
+			//选择一个连接发送，返回发送所用的连接，全部断开时返回nullptr
+			ClientSocket*			send(size_t upstream, const void* data, size_t length);
+
+			size_t					numConnected(size_t upstream) const;
+			inline size_t			numUpstreams() const { return upstreams.size(); }
+
+			std::function<void(size_t upstream, ClientSocket& socket)>					onConnected;
+			std::function<void(size_t upstream, ClientSocket& socket)>					onClosed;
+			//必须设置，未处理的数据留在缓冲区中
+			std::function<void(size_t upstream, ClientSocket& socket, ByteArray& bytes)>	onReceived;
+
+		private:
+			struct Connection
+			{
+				std::unique_ptr<ClientSocket>	socket;
+				uint32_t				failures = 0;			//连续失败的次数，连接成功后清零
+				uint64_t				nextConnectTime = 0;	//为0时不需要重连
+			};
+
+			struct Upstream
+			{
+				std::string				ip;
+				uint16_t				port = 0;
+				std::vector<Connection>	connections;
+				size_t					nextIndex = 0;			//轮询的位置
+			};
+
+			ClientPoolConfig		config;
+			std::vector<Upstream>	upstreams;
+
+			void					initConnection(size_t upstream, size_t index);
+			uint64_t				getReconnectDelay(uint32_t failures) const;
+		};
+	}
+}
+
+#endif	//__WS_CLIENT_SOCKET_POOL_H__
@@ -0,0 +1,66 @@
+#ifndef __WS_FRAME_DECODER_H__
+#define __WS_FRAME_DECODER_H__
+
+#include <stdint.h>
+#include <span>
+#include <string>
+#include <functional>
+
+namespace ws
+{
+	namespace network
+	{
+		enum class FrameMode
+		{
+			NONE,			//不拆包，由Client::onRecv自行处理
+			LENGTH_PREFIX,	//固定长度的包头中带有长度字段
+			DELIMITER,		//以分隔符结尾
+			CUSTOM,			//由decode函数判断帧长度
+		};
+
+		struct FrameConfig
+		{
+			FrameMode						mode = FrameMode::NONE;
+			uint32_t						maxFrameSize = 64 * 1024;	//超过则断开连接
+
+			//LENGTH_PREFIX，交给onPacket的帧包含包头
+			uint8_t							headerSize = 2;			//包头总长度
+			uint8_t							lengthOffset = 0;		//长度字段在包头中的偏移
+			uint8_t							lengthBytes = 2;		//长度字段的字节数：1、2、4
+			bool							lengthBigEndian = false;
+			bool							lengthIncludesHeader = false;	//长度是否包含包头
+
+			//DELIMITER，交给onPacket的帧不含分隔符
+			std::string						delimiter = "\r\n";
+
+			//CUSTOM，返回data开头完整帧的长度，数据不足返回0，非法数据返回-1
+			std::function<int64_t(std::span<const uint8_t> data)>	decode;
+		};
+
+		enum class FrameResult
+		{
+			COMPLETE,
+			INCOMPLETE,
+			INVALID,
+		};
+
+		//从接收的数据中拆出完整的帧，帧直接引用接收缓冲区，不复制
+		class FrameDecoder
+		{
+		public:
+			//检查配置，配置不合法返回false
+			bool init(const FrameConfig& cfg);
+			inline bool isEnabled() const { return config.mode != FrameMode::NONE; }
+
+			//查找data开头的第一个完整帧，consumed为需要移出缓冲区的长度
+			//数据不足时scanned记录已查找过的长度，下次从该位置继续查找分隔符
+			FrameResult next(std::span<const uint8_t> data, size_t& scanned,
+				std::span<const uint8_t>& frame, size_t& consumed) const;
+
+		private:
+			FrameConfig						config;
+		};
+	}
+}
+
+#endif	//__WS_FRAME_DECODER_H__
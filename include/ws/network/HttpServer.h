@@ -0,0 +1,107 @@
+#ifndef __WS_HTTP_SERVER_H__
+#define __WS_HTTP_SERVER_H__
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ws/network/ServerSocket.h"
+
+namespace ws
+{
+	namespace network
+	{
+		//一个请求，所有字段引用接收缓冲区，只在处理函数执行期间有效
+		struct HttpServerRequest
+		{
+			std::string_view		method;
+			std::string_view		path;		//不含查询参数，未解码
+			std::string_view		query;		//?之后的部分
+			std::string_view		version;
+			std::string_view		body;
+			std::vector<std::pair<std::string_view, std::string_view>>	headers;
+			Client*					client = nullptr;
+
+			//不区分大小写，不存在时返回空
+			std::string_view		getHeader(std::string_view name) const;
+			//查询参数的原始值，不做URL解码
+			std::string_view		getQuery(std::string_view key) const;
+		};
+
+		//响应由状态行、头部和多个数据块组成，发送时各数据块直接进入发送队列
+		class HttpServerResponse
+		{
+			friend class HttpConnection;
+		public:
+			void					setStatus(int code);
+			//追加一个头部，Content-Length和Connection由服务器生成
+			void					setHeader(std::string_view name, std::string_view value);
+			inline void				setContentType(std::string_view type) { setHeader("Content-Type", type); }
+			//复制数据到响应体
+			void					write(std::string_view data);
+			//引用共享的数据包，不复制，适合缓存的响应体
+			void					write(PacketPtr packet);
+			inline int				getStatus() const { return status; }
+
+		private:
+			struct Chunk
+			{
+				PacketPtr			packet;		//为空时引用copied中的一段
+				size_t				offset = 0;
+				size_t				length = 0;
+			};
+
+			int						status = 200;
+			std::string				headers;
+			std::string				copied;
+			std::vector<Chunk>		chunks;
+			size_t					bodySize = 0;
+
+			void					reset();
+		};
+
+		struct HttpConfig
+		{
+			size_t					maxHeaderSize = 8192;		//请求行和头部的上限，超过返回431
+			size_t					maxBodySize = 1024 * 1024;	//请求体的上限，超过返回413
+		};
+
+		//嵌入式HTTP/1.1服务器，用于健康检查、监控和GM接口
+		//支持keep-alive和管线化，不支持分块编码的请求体，处理函数在update线程中执行
+		class HttpServer : public ServerSocket
+		{
+			friend class HttpConnection;
+		public:
+			using Handler = std::function<void(const HttpServerRequest& request, HttpServerResponse& response)>;
+
+			bool					init(const ServerConfig& cfg) override;
+			bool					init(const ServerConfig& cfg, const HttpConfig& httpCfg);
+
+			//path以*结尾时按前缀匹配，精确匹配优先，其次是最长的前缀，GET同时处理HEAD
+			void					route(std::string_view method, std::string_view path, Handler handler);
+			inline void				get(std::string_view path, Handler handler) { route("GET", path, std::move(handler)); }
+			inline void				post(std::string_view path, Handler handler) { route("POST", path, std::move(handler)); }
+
+			inline const HttpConfig&	getHttpConfig() const { return httpConfig; }
+
+		private:
+			struct StringHash
+			{
+				using is_transparent = void;
+				inline size_t operator()(std::string_view str) const { return std::hash<std::string_view>()(str); }
+			};
+			//一个路径下各方法的处理函数
+			using MethodHandlers = std::vector<std::pair<std::string, Handler>>;
+
+			HttpConfig				httpConfig;
+			std::unordered_map<std::string, MethodHandlers, StringHash, std::equal_to<>>	exactRoutes;
+			std::vector<std::pair<std::string, MethodHandlers>>	prefixRoutes;	//按前缀长度从长到短排列
+
+			void					dispatch(const HttpServerRequest& request, HttpServerResponse& response) const;
+		};
+	}
+}
+
+#endif	//__WS_HTTP_SERVER_H__
@@ -0,0 +1,78 @@
+#ifndef __WS_IO_URING_H__
+#define __WS_IO_URING_H__
+
+#ifdef __linux__
+#include <stdint.h>
+#include <atomic>
+#include <linux/io_uring.h>
+
+namespace ws
+{
+	namespace network
+	{
+		//io_uring的最小封装，直接使用系统调用，不依赖liburing
+		//只能由一个线程提交和收割
+		class IoUring
+		{
+		public:
+			IoUring() = default;
+			IoUring(const IoUring&) = delete;
+			~IoUring();
+
+			//创建队列，entries为提交队列长度
+			bool init(uint32_t entries);
+			//检测当前内核是否支持服务器用到的io_uring特性，包括多次触发的accept和使用缓冲区组的多次触发recv
+			static bool isSupported();
+
+			//获取一个空闲的提交项，队列满时先提交再获取
+			io_uring_sqe* getSqe();
+			//提交所有待提交项，并至少等待waitNr个完成事件
+			int submit(uint32_t waitNr = 0);
+			//进入内核的次数，可在其他线程读取
+			inline uint64_t numEnters() const { return enterCount.load(std::memory_order_relaxed); }
+
+			//遍历并消费所有已完成的事件，返回处理的事件数
+			template<class Callback>
+			uint32_t forEachCqe(Callback&& callback)
+			{
+				uint32_t head = *cqHead;
+				uint32_t tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+				uint32_t count = 0;
+				for (; head != tail; ++head, ++count)
+				{
+					callback(cqes[head & *cqMask]);
+				}
+				__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+				return count;
+			}
+
+		private:
+			bool mapRings(const io_uring_params& params);
+
+		private:
+			int					ringFd = -1;
+			void*				sqRing = nullptr;
+			void*				cqRing = nullptr;
+			size_t				sqRingSize = 0;
+			size_t				cqRingSize = 0;
+			io_uring_sqe*		sqes = nullptr;
+			size_t				sqesSize = 0;
+
+			uint32_t*			sqHead = nullptr;
+			uint32_t*			sqTail = nullptr;
+			uint32_t*			sqMask = nullptr;
+			uint32_t*			sqArray = nullptr;
+			uint32_t			sqEntries = 0;
+			uint32_t			sqeTail = 0;	//本地尚未发布的提交位置
+			std::atomic<uint64_t>	enterCount = 0;
+
+			uint32_t*			cqHead = nullptr;
+			uint32_t*			cqTail = nullptr;
+			uint32_t*			cqMask = nullptr;
+			io_uring_cqe*		cqes = nullptr;
+		};
+	}
+}
+#endif
+
+#endif	//__WS_IO_URING_H__
@@ -0,0 +1,105 @@
+#ifndef __WS_KCP_SESSION_H__
+#define __WS_KCP_SESSION_H__
+
+#include <deque>
+#include <map>
+#include <vector>
+#include "ws/network/UdpServer.h"
+
+namespace ws
+{
+	namespace network
+	{
+		//可靠UDP的参数，含义与KCP一致
+		struct KcpConfig
+		{
+			uint32_t				interval = 10;		//发送和重传的检查间隔(毫秒)
+			uint32_t				sendWindow = 128;	//发送窗口(分片数)
+			uint32_t				recvWindow = 128;	//接收窗口(分片数)
+			uint32_t				mtu = 1400;			//每个数据报的最大字节数
+			bool					nodelay = true;		//最小RTO为30毫秒，超时后RTO只增加一半
+			uint32_t				fastResend = 2;		//被跳过多少次ACK后立即重传，0为关闭
+			bool					noCongestion = false;	//关闭拥塞窗口，只受收发窗口限制
+			uint32_t				deadLink = 20;		//同一分片重传多少次后断开
+			uint32_t				maxSendQueue = 4096;	//等待进入发送窗口的最大分片数，超过后断开，0为不限制
+		};
+
+		//基于UdpSession的可靠有序字节流，接口与Client一致
+		//选择性确认、快速重传和拥塞窗口参照KCP实现，由UdpServer::update驱动
+		class KcpSession : public UdpSession
+		{
+		public:
+			KcpSession(const KcpConfig& cfg = KcpConfig());
+
+			//可靠发送，会复制数据，在下一个检查间隔发出，四个重载都按字节流处理
+			void					send(const void* data, size_t length) override;
+			void					send(const ws::core::ByteArray& packet) override;
+			void					send(ws::core::ByteArray&& packet) override;
+			void					send(PacketPtr packet) override;
+
+			//已发送但未确认的字节数
+			size_t					pendingSendBytes() const;
+			inline uint32_t			getRto() const { return rto; }
+
+		protected:
+			//readerBuffer中有新的有序数据
+			virtual void			onRecv() {}
+
+			ws::core::ByteArray		readerBuffer;
+
+			void					onPacket(std::span<const uint8_t> datagram) override;
+			void					onUpdate(uint64_t now) override;
+
+		private:
+			struct Segment
+			{
+				uint32_t					sn = 0;
+				uint32_t					ts = 0;			//最后一次发送的时间
+				uint32_t					resendTs = 0;	//超时重传的时间
+				uint32_t					rto = 0;
+				uint32_t					fastAck = 0;	//被后面的分片跳过的次数
+				uint32_t					xmit = 0;		//发送次数
+				std::vector<uint8_t>		data;
+			};
+
+			KcpConfig					config;
+			uint32_t					mss = 0;			//每个分片的数据长度
+
+			std::deque<Segment>			sendQueue;			//等待进入发送窗口
+			std::deque<Segment>			sendBuffer;			//已发送未确认，按sn排序
+			std::map<uint32_t, std::vector<uint8_t>>	recvBuffer;	//乱序到达的分片
+			std::vector<std::pair<uint32_t, uint32_t>>	ackList;	//待回复的sn和ts
+
+			uint32_t					sendUna = 0;		//最早未确认的sn
+			uint32_t					sendNext = 0;		//下一个分配的sn
+			uint32_t					recvNext = 0;		//下一个期望收到的sn
+			uint32_t					remoteWindow = 0;
+			uint32_t					cwnd = 1;
+			uint32_t					ssthresh = 2;
+			uint32_t					incr = 0;			//拥塞避免阶段的字节计数
+
+			uint32_t					srtt = 0;
+			uint32_t					rttvar = 0;
+			uint32_t					rto = 0;
+			uint32_t					minRto = 0;
+
+			uint32_t					current = 0;		//当前时间(毫秒，回绕)
+			uint32_t					nextFlush = 0;
+			uint32_t					probeTime = 0;		//对方窗口为0时下次询问的时间
+			uint32_t					probeWait = 0;
+			bool						needProbe = false;	//询问对方窗口
+			bool						needTellWindow = false;	//告知对方窗口
+			bool						isUpdated = false;
+			bool						isKicked = false;
+
+			void					parseUna(uint32_t una);
+			void					parseAck(uint32_t sn);
+			void					parseFastAck(uint32_t maxAck);
+			void					updateRtt(int32_t rtt);
+			void					flush();
+			uint16_t				unusedWindow() const;
+		};
+	}
+}
+
+#endif	//__WS_KCP_SESSION_H__
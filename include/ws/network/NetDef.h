@@ -13,11 +13,14 @@ using Socket = SOCKET;
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <netinet/in.h>
 #include <fcntl.h>
 #include <strings.h>
 #include <unistd.h>
 constexpr int EPOLL_SIZE = 1000;
+constexpr int URING_ENTRIES = 1024;			// io_uring提交队列长度
+constexpr int URING_BUFFER_COUNT = 512;		// 每个io_uring提供给内核的接收缓冲区数量
 #ifndef Socket
 using Socket = int;
 #endif
@@ -35,6 +38,8 @@ using Socket = int;
 #endif
 
 constexpr int BUFFER_SIZE = 4096;
+constexpr int MAX_SEND_IOV = 64;		// 每次sendmsg最多合并的数据段数
 constexpr int ADDRESS_LENGTH = sizeof(sockaddr_in) + 16;
 constexpr int NUM_ACCEPTEX = 100;
 
+constexpr int CLIENT_INDEX_BITS = 20;	// 客户端id低位为槽位索引，高位为代数
@@ -0,0 +1,112 @@
+#ifndef __WS_SEND_QUEUE_H__
+#define __WS_SEND_QUEUE_H__
+
+#include <deque>
+#include <memory>
+#include <vector>
+#include "ws/network/NetDef.h"
+#include "ws/core/ByteArray.h"
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+namespace ws
+{
+	namespace network
+	{
+		//不可变的共享数据包，可同时挂在多个发送队列上
+		using PacketPtr = std::shared_ptr<const ws::core::ByteArray>;
+
+		//发送队列，由引用计数的数据块组成
+		//发送后只移动队首偏移，不做内存搬移
+		class SendQueue
+		{
+		public:
+			SendQueue() = default;
+			SendQueue(SendQueue&& other) noexcept { swap(other); }
+			SendQueue& operator=(SendQueue&& other) noexcept
+			{
+				clear();
+				swap(other);
+				return *this;
+			}
+
+			//复制一段数据，小块数据合并到队尾的数据块
+			void push(const void* data, size_t length);
+			//引用一个数据包的全部内容，不复制
+			void push(PacketPtr packet);
+			//把other的全部数据块移到队尾
+			void append(SendQueue&& other);
+#ifdef __linux__
+			//发送文件的一段，接管fd并在发送完成后关闭
+			void pushFile(int fd, off_t offset, size_t length);
+			//队首是文件时返回true，并取出当前的发送位置和剩余长度
+			bool frontFile(int& fd, off_t& offset, size_t& length) const;
+			//队列中是否有文件，文件不能用readData读出
+			bool hasFile() const;
+#endif
+			//之后的数据不再合并到当前队尾的数据块，用于零拷贝发送后保持已发送的内存不变
+			inline void seal() { tail = nullptr; }
+
+			//待发送的字节数
+			inline size_t size() const { return totalBytes; }
+			inline bool empty() const { return !totalBytes; }
+			//数据块个数
+			inline size_t numChunks() const { return chunks.size(); }
+
+#ifndef _WIN32
+			//把队首最多maxCount段数据填入iov，返回填入的段数，遇到文件时停止
+			size_t gather(iovec* iov, size_t maxCount) const;
+#endif
+			//复制最多length字节到outData并移出队列，返回实际大小
+			size_t readData(void* outData, size_t length);
+			//移除队首已发送的length字节
+			void consume(size_t length);
+			//移除队首已发送的length字节，并把涉及的数据块放入pinned，保证内核使用期间不被释放
+			void consume(size_t length, std::vector<PacketPtr>& pinned);
+
+			void clear();
+			void swap(SendQueue& other) noexcept;
+
+		private:
+			//合并小块数据的上限
+			static constexpr size_t COALESCE_LIMIT = BUFFER_SIZE * 4;
+
+#ifdef __linux__
+			//待发送的文件，析构时关闭
+			struct FileChunk
+			{
+				~FileChunk();
+				int					fd = -1;
+				off_t				offset = 0;
+				size_t				length = 0;
+			};
+#endif
+
+			struct Chunk
+			{
+				PacketPtr			packet;
+				size_t				offset = 0;		//已发送的字节数
+#ifdef __linux__
+				std::unique_ptr<FileChunk>	file;
+#endif
+				inline size_t size() const
+				{
+#ifdef __linux__
+					if (file)
+					{
+						return file->length;
+					}
+#endif
+					return packet->size();
+				}
+			};
+			std::deque<Chunk>		chunks;
+			ws::core::ByteArray*	tail = nullptr;	//队尾可追加的数据块，由队列自己创建
+			size_t					totalBytes = 0;
+		};
+	}
+}
+
+#endif	//__WS_SEND_QUEUE_H__
@@ -2,6 +2,7 @@
 #define __WS_SERVER_SOCKET_H__
 
 #include <assert.h>
+#include <atomic>
 #include <mutex>
 #include <list>
 #include <iostream>
@@ -9,11 +10,21 @@
 #include <functional>
 #include <vector>
 #include <set>
+#include <span>
+#include <deque>
 #include <unordered_map>
 
 #include "ws/network/NetDef.h"
+#include "ws/network/SocketAddress.h"
+#include "ws/network/IoUring.h"
+#include "ws/network/SendQueue.h"
+#include "ws/network/BufferPool.h"
+#include "ws/network/FrameDecoder.h"
+#include "ws/network/TlsContext.h"
 #include "ws/core/ByteArray.h"
 #include "ws/core/ObjectPool.h"
+#include "ws/core/LockFreeQueue.h"
+#include "ws/core/Histogram.h"
 
 using namespace ws::core;
 using namespace std::chrono;
@@ -23,58 +34,182 @@ namespace ws
 	namespace network
 	{
 		class ServerSocket;
-		class Client
+
+		//单个连接的流量统计
+		struct ClientStats
+		{
+			uint64_t						bytesIn = 0;
+			uint64_t						bytesOut = 0;		//已发送完成的字节数，TLS连接为明文字节数
+			uint64_t						packetsIn = 0;		//onRecv或onPacket的调用次数
+			uint64_t						packetsOut = 0;		//send和sendFile的调用次数
+			size_t							maxPendingBytes = 0;	//待发送字节数的最高值
+			uint64_t						lifetime = 0;		//已连接的毫秒数
+		};
+
+		class Client : public std::enable_shared_from_this<Client>
 		{
 			friend class ServerSocket;
 		public:
 			Client();
 			virtual ~Client();
 
-			uint16_t				id;
+			uint32_t				id;		//槽位索引和代数组成，断开后不会立即复用
 			uint64_t				lastActiveTime;
 
-			std::string		getIP()
-			{
-				char buffer[20] = {0};
-				std::string result(inet_ntop(AF_INET, (void*)&addr.sin_addr, buffer, 20));
-				return result;
-			}
+			inline std::string	getIP() const { return formatAddress(addr); }
+			//AF_INET、AF_INET6或AF_UNIX
+			inline int		getFamily() const { return addr.ss_family; }
+			//发送数据，会复制数据到发送队列
 			virtual void	send(const void* data, size_t length);
 			virtual void	send(const ByteArray& packet);
-			inline void		kick(){ isClosing = true; }
+			//接管packet的内存，不复制
+			virtual void	send(ByteArray&& packet);
+			//引用共享的数据包，不复制，发送完成前不能修改其内容
+			virtual void	send(PacketPtr packet);
+#ifdef __linux__
+			//发送文件的一段，fd仍由调用者关闭。epoll后端用sendfile直接从文件发送，io_uring后端由I/O线程分块读入后发送，用户态TLS连接分块读入内存后加密
+			bool			sendFile(int fd, off_t offset, size_t length);
+#endif
+			void			kick();
+			//尚未发送完成的字节数，可用于给落后的客户端降低同步频率
+			inline size_t	pendingSendBytes() const { return writerQueue.size() + sendingBytes; }
+			inline bool		isBackpressured() const { return isSendBlocked; }
+			//在update线程调用
+			ClientStats		getStats() const;
 
 		protected:
-			virtual void	onRecv() = 0;
+			//未配置拆包时，收到数据后调用，数据在readerBuffer中
+			virtual void	onRecv() {}
+			//配置了拆包时，每个完整的帧调用一次，frame引用接收缓冲区，只在调用期间有效
+			virtual void	onPacket(std::span<const uint8_t> frame) {}
 			virtual void	onDisconnected() {}
+			//待发送数据超过高水位时调用一次
+			virtual void	onBackpressure() {}
+			//超过高水位后回落到低水位以下时调用
+			virtual void	onWritable() {}
+			//服务器开始drain时调用一次，可以在这里通知对端稍后重连，发完的连接随后断开
+			virtual void	onDrain() {}
 
 		protected:
 			Socket					socket;
-			sockaddr_in				addr;
+			sockaddr_storage		addr;
 			ServerSocket*			server;
-			ByteArray				readerBuffer;
-			ByteArray				writerBuffer;
-			std::mutex				readerMtx;
-			std::mutex				writerMtx;
+			ByteArray				readerBuffer;	//只在update线程访问，收到数据时才分配，读完后归还缓冲池
+			SendQueue				writerQueue;	//只在update线程访问
 
 		private:
-			bool					isClosing;
-			bool					hasNewData;
+			std::atomic_bool		isClosing;
+			std::atomic_bool		isReady;		//是否已在就绪列表中
+			SpscQueue<ByteArray>	recvQueue;		//I/O线程收到的数据，由update线程取出
+			uint16_t				ioIndex = 0;	//所属I/O线程
+			std::atomic<size_t>		sendingBytes = 0;	//已交给I/O线程尚未发送完成的字节数
+			std::atomic_bool		isSendBlocked = false;	//是否超过了高水位
+
+			//以下只在update线程访问
+			bool					isDirty = false;	//是否已在待处理列表中
+			uint32_t				wheelSlot = UINT32_MAX;	//所在的时间轮槽
+			uint32_t				wheelPos = 0;		//在槽中的位置
+			size_t					frameScanned = 0;	//未完成的帧已查找过的长度
+
+			//流量统计，字节数由I/O线程累加
+			std::atomic<uint64_t>	statBytesIn = 0;
+			std::atomic<uint64_t>	statBytesOut = 0;
+			std::atomic<uint64_t>	recvQueuedTime = 0;	//recvQueue中最早的数据到达的时间，微秒，为0时队列为空
+			uint64_t				statPacketsIn = 0;
+			uint64_t				statPacketsOut = 0;
+			size_t					statMaxPending = 0;
+			uint64_t				connectTime = 0;
 		};
 		using ClientPtr = std::shared_ptr<Client>;
 
+		//linux下的I/O后端
+		enum class IOBackend
+		{
+			EPOLL,
+			IO_URING,	//需要linux 6.0以上内核，不支持时回退到epoll
+		};
+
+		//待发送数据超过maxSendBytes时的处理方式
+		enum class SendOverflowPolicy
+		{
+			DROP,	//丢弃新发送的数据
+			KICK,	//断开连接
+		};
+
 		struct ServerConfig
 		{
+			//linux下也可以是IPv6地址，"::"同时接受IPv4和IPv6的连接
+			//或者"unix:"开头的unix socket，只由第一个I/O线程accept，连接轮流分给各个I/O线程
 			std::string						listenAddr;
+			bool							ipv6Only = false;		//IPv6地址不接受IPv4的连接
 			uint16_t						listenPort = 0;
-			uint16_t						maxConnection = 0;
+			uint32_t						maxConnection = 0;
 			uint64_t						kickTime = 0;
+			//I/O线程数，0为默认值（linux为1，windows为cpu核心数）
+			//linux下大于1时每个线程通过SO_REUSEPORT独立监听，各自拥有epoll和客户端
+			uint16_t						numIOThreads = 0;
+			IOBackend						ioBackend = IOBackend::EPOLL;
+			FrameConfig						frame;		//拆包方式，默认不拆包
+			//每个客户端待发送数据的高低水位，0为不限制，低水位默认为高水位的一半
+			size_t							sendHighWatermark = 0;
+			size_t							sendLowWatermark = 0;
+			size_t							maxSendBytes = 0;	//待发送数据的上限，0为不限制
+			SendOverflowPolicy				sendOverflowPolicy = SendOverflowPolicy::KICK;
+			//linux epoll后端单次发送不少于该字节数时使用MSG_ZEROCOPY，0为不使用
+			size_t							zeroCopyThreshold = 0;
+			int								listenBacklog = 0;		//监听队列长度，0为SOMAXCONN
+			//epoll后端每轮事件循环最多accept的连接数，避免连接风暴时其他socket得不到处理
+			uint32_t						maxAcceptsPerLoop = 64;
+			//每个IP每秒最多接受的连接数，超出的直接关闭，0为不限制
+			uint32_t						acceptRatePerIP = 0;
+			uint32_t						acceptBurstPerIP = 0;	//允许的突发连接数，默认与acceptRatePerIP相同
+			//linux下连接收到数据后才accept，最多等待的秒数，只适合客户端先发送数据的协议，0为不使用
+			uint32_t						deferAcceptTime = 0;
+			bool							tcpNoDelay = false;		//关闭Nagle算法，一次update产生多个小响应时避免等待ACK
+			//linux下I/O线程不阻塞等待事件而是持续轮询，占用一个CPU核心换取更低的延迟，也不再需要eventfd唤醒
+			bool							busyPoll = false;
+			uint32_t						socketBusyPollUs = 0;	//连接的SO_BUSY_POLL，读取时在网卡队列上轮询的微秒数，0为不设置
+			std::vector<int>				ioThreadCpus;			//第i个I/O线程绑定到ioThreadCpus[i]上，为空时不绑定
+			//linux epoll后端只有一个I/O线程时可用，不创建I/O线程，由update轮询事件并在本帧末尾发出数据
+			bool							pollInUpdate = false;
+			//配置证书后所有连接使用TLS，只支持linux，握手和加解密在I/O线程中完成
+			TlsConfig						tls;
 			std::function<ClientPtr()>		createClient;
 			std::function<void(ClientPtr)>	onClientConnected;
 			std::function<void(ClientPtr)>	onClientDestroyed;
 		};
 
+		//连接占用的内存统计
+		struct MemoryStats
+		{
+			size_t							numClients = 0;
+			size_t							readerBytes = 0;	//所有接收缓冲区的容量
+			size_t							writerBytes = 0;	//所有待发送的字节数
+			size_t							pooledBytes = 0;	//缓冲池中空闲的字节数
+			size_t							bytesPerClient = 0;	//平均每个连接占用的缓冲区字节数
+		};
+
+		//服务器启动后的累计统计，两次快照相减可得到一段时间内的值
+		struct NetStats
+		{
+			uint64_t						bytesIn = 0;
+			uint64_t						bytesOut = 0;
+			uint64_t						packetsIn = 0;
+			uint64_t						packetsOut = 0;
+			uint64_t						numUpdates = 0;
+			//linux下I/O线程和pollInUpdate时update中的系统调用次数，io_uring后端按进入内核的次数统计
+			uint64_t						syscalls = 0;
+			uint64_t						recvEagain = 0;		//读到EAGAIN的次数
+			uint64_t						sendEagain = 0;		//发送缓冲区已满的次数
+			size_t							maxPendingBytes = 0;	//所有连接待发送字节数的最高值
+			Histogram						updateTime;			//update耗时，微秒
+			Histogram						queueTime;			//数据从I/O线程收到到onRecv的时间，微秒
+			Histogram						lifetime;			//已断开连接的连接时长，毫秒
+		};
+
 		class ServerSocket
 		{
+			friend class Client;
 		public:
 			virtual ~ServerSocket() { cleanup(); }
 
@@ -82,29 +217,93 @@ namespace ws
 			virtual void								update();
 			virtual void								cleanup();
 			bool										startListen();
-			bool										kickClient(uint16_t clientID);
-			ClientPtr									getClient(uint16_t clientID);
-			inline uint16_t								numOnlines(){ return numClients; }
+			bool										kickClient(uint32_t clientID);
+			ClientPtr									getClient(uint32_t clientID);
+			inline uint32_t								numOnlines(){ return numClients; }
+
+			//广播数据包，所有客户端引用同一块不可变的内存
+			void										broadcast(PacketPtr packet);
+			//广播给指定的客户端
+			void										broadcast(PacketPtr packet, std::span<const uint32_t> clientIDs);
+			//广播给满足filter的客户端
+			void										broadcast(PacketPtr packet, const std::function<bool(const ClientPtr&)>& filter);
+			//复制一次packet后广播
+			template<class... Args>
+			inline void									broadcast(const ByteArray& packet, Args&&... args)
+			{
+				broadcast(std::make_shared<const ByteArray>(packet.data(), packet.size(), true), std::forward<Args>(args)...);
+			}
 			inline const ServerConfig&					getConfig(){ return config; }
+#ifdef __linux__
+			//停止accept并调用所有客户端的onDrain，待发送的数据发完或超过timeout毫秒后断开
+			void										drain(uint64_t timeout);
+			inline bool									isDraining() const { return drainDeadline != 0; }
+			//drain开始后所有连接都已断开
+			inline bool									isDrained() const { return isDraining() && allClients.empty() && !numAccepting; }
+			//旧进程：在unix socket path上等待新进程接管，由update检查
+			//接管时监听socket交给新进程，migrateClients为true时epoll后端未加密的连接也连同未处理的数据交出，其余连接drain
+			bool										listenHandoff(const std::string& path, bool migrateClients, uint64_t drainTimeout);
+			//新进程：代替startListen，从旧进程接管监听socket和连接，旧进程不存在时返回false
+			bool										takeOver(const std::string& path);
+#endif
+			//遍历所有客户端统计，不要每帧调用
+			MemoryStats									getMemoryStats() const;
+			//复制了三个直方图，不要每帧调用
+			NetStats									getNetStats() const;
 
 		protected:
-			std::unordered_map<uint16_t, ClientPtr>		allClients;
+			std::vector<ClientPtr>						allClients;		//连续存放，删除时与末尾交换
 
 		public:
 			inline const decltype(allClients)&			getAllClients() const { return allClients; }
 
 		private:
+			//id到allClients下标的映射
+			struct ClientSlot
+			{
+				uint32_t								generation = 0;
+				uint32_t								index = 0;		//在allClients中的下标
+			};
+			std::vector<ClientSlot>						clientSlots;
+			std::vector<uint32_t>						freeSlots;
+
 			ServerConfig								config;
-			uint16_t									numClients = 0;
-			Socket										listenSocket = 0;
-			std::mutex									addMtx;
-			std::list<ClientPtr>						addingClients;
+			std::atomic<uint32_t>						numClients = 0;
+			BufferPool									bufferPool;		//接收缓冲区
+			FrameDecoder								frameDecoder;
+			MpscQueue<ClientPtr>						addingClients;
+			MpscQueue<ClientPtr>						readyClients;	//有数据或状态变化，等待update处理的客户端
+			std::vector<ClientPtr>						dirtyClients;	//有待发送数据或需要关闭的客户端
+			std::vector<ClientPtr>						flushingClients;
+
+			//空闲踢出用的时间轮，活跃时只更新lastActiveTime，到期时再检查
+			static constexpr uint32_t					TIME_WHEEL_SIZE = 256;
+			std::vector<std::vector<Client*>>			timeWheel;
+			uint64_t									wheelTime = 0;	//下一个待处理槽的起始时间
+			uint64_t									wheelSlotTime = 1;	//每个槽的时长
 
-			int							processEventThread();
-			Client*						addClient(Socket sock, const sockaddr_in &addr);
+			//统计，字节数由I/O线程累加，其余只在update线程访问
+			std::atomic<uint64_t>						statBytesIn = 0;
+			std::atomic<uint64_t>						statBytesOut = 0;
+			NetStats									stats;
+
+			ClientPtr					addClient(Socket sock, const sockaddr* addr, socklen_t addrLength, uint16_t ioIndex = 0);
+			void						pushRecvData(Client& client, ByteArray&& data);
+			void						markReady(Client& client);
+			bool						receiveData(Client& client);
+			void						decodeFrames(Client& client);
+			void						markDirty(Client& client);
+			bool						checkSendLimit(Client& client, size_t length);
+			void						onSendQueued(Client& client);
+			void						onSendCompleted(Client& client, size_t length);
+			void						checkLowWatermark(Client& client);
+			void						addToTimeWheel(Client& client, uint64_t expireTime);
+			void						removeFromTimeWheel(Client& client);
+			void						kickIdleClients(uint64_t now);
 			void						destroyClient(ClientPtr client);
 			void						flushClient(ClientPtr client);
-			uint16_t					getNextClientID();
+			void						registerClient(const ClientPtr& client);
+			void						unregisterClient(Client& client);
 
 #ifdef _WIN32
 		public:
@@ -130,6 +329,7 @@ namespace ws
 				Socket acceptSocket;
 			};
 
+			Socket listenSocket = 0;
 			HANDLE completionPort = nullptr;
 			LPFN_ACCEPTEX lpfnAcceptEx = nullptr;
 
@@ -139,36 +339,164 @@ namespace ws
 			std::list<std::unique_ptr<OverlappedData>>	ioDataPosted;
 			std::list<std::thread>						eventThreads;
 
+			int processEventThread();
 			bool initWinsock();
 			int postAcceptEx();
 			int getAcceptedSocketAddress(char* buffer, sockaddr_in* addr);
 			void postCloseServer();
-			void writeClientBuffer(Client& client, char* data, size_t size);
 
 			OverlappedData& createOverlappedData(SocketOperation operation, size_t size = BUFFER_SIZE, Socket acceptedSock = NULL);
 			void releaseOverlappedData(OverlappedData* data);
 			void initOverlappedData(OverlappedData& data, SocketOperation operation, size_t size = BUFFER_SIZE, Socket acceptedSock = NULL);
 
 #elif defined(__linux__)
+		public:
+			//在第ioIndex个I/O线程中执行task，任意线程调用
+			void post(std::function<void()> task, uint16_t ioIndex = 0);
+			//立即把客户端的待发送数据交给I/O线程，不等到update末尾
+			void postFlush(uint32_t clientID);
+
 		private:
-			int				epfd = 0;
-			int				pipe_fd[2] = { 0, 0 };
+			//I/O线程持有的客户端状态，保证I/O线程使用期间客户端不被释放
+			struct IOClient
+			{
+				ClientPtr		client;
+				bool			isReleasing = false;	//update线程已销毁，等待未完成的操作结束
+				SendQueue		sending;				//update线程交来的待发送数据
+
+				//零拷贝发送，只用于epoll后端
+				bool			isZeroCopy = false;
+				uint32_t		zeroCopySeq = 0;		//已提交的零拷贝发送次数
+				std::deque<std::pair<uint32_t, std::vector<PacketPtr>>>	zeroCopyPinned;	//等待完成通知的数据块
+				uint64_t		lingerDeadline = 0;		//关闭时还有未完成的零拷贝发送，等待通知的截止时间
+
+				//TLS连接，用户态加密时按明文统计发送完成的字节数
+				std::unique_ptr<TlsConnection>	tls;
+				size_t			tlsSentBytes = 0;		//已发出的密文字节数
+				std::deque<std::pair<size_t, size_t>>	tlsPlainMarks;	//密文发送到该位置时完成的明文字节数
+
+				//以下仅用于io_uring后端，发送期间数据块必须保持不变
+				iovec			sendIov[MAX_SEND_IOV];
+				msghdr			sendMsg;
+				std::vector<uint8_t>	fileBuffer;				//队首是文件时读入的一块
+				bool			isRecvArmed = false;
+				bool			isSending = false;
+			};
+
+			//其他线程交给I/O线程执行的操作
+			struct IOCommand
+			{
+				ClientPtr				client;
+				SendQueue				data;			//待发送的数据
+				bool					isAttach = false;	//新创建的客户端，开始监听其socket
+				bool					isClose = false;
+				std::function<void()>	task;			//post的任务，不关联客户端
+			};
+
+			//按来源IP限制accept频率的令牌桶，令牌以千分之一为单位
+			struct AcceptBucket
+			{
+				uint64_t		tokens = 0;
+				uint64_t		lastTime = 0;
+			};
+
+			//I/O线程accept的socket，由update线程创建客户端
+			struct AcceptedSocket
+			{
+				Socket			socket = -1;
+				sockaddr_storage	addr;
+				uint16_t		ioIndex = 0;
+			};
+
+			//每个reactor拥有独立的监听socket、epoll和事件线程
+			struct Reactor
+			{
+				uint16_t		index = 0;
+				Socket			listenSocket = -1;
+				int				epfd = -1;
+				int				eventFd = -1;			//唤醒I/O线程
+				std::thread		eventThread;
+
+				std::unordered_map<Client*, IOClient>	ioClients;		//只在I/O线程访问
+				MpscQueue<IOCommand>					commands;
+				std::atomic_bool						hasCommand = false;
+				bool									hasPendingAccept = false;	//还有未accept的连接，不阻塞等待
+				std::unordered_map<uint64_t, AcceptBucket>	acceptBuckets;	//IPv6按/64前缀限制
+				uint64_t								bucketSweepTime = 0;
+				std::vector<Client*>					lingeringClients;	//已关闭但零拷贝数据还在被内核使用的连接
+
+				//统计，主要由I/O线程累加
+				std::atomic<uint64_t>					syscalls = 0;
+				std::atomic<uint64_t>					recvEagain = 0;
+				std::atomic<uint64_t>					sendEagain = 0;
+
+				//io_uring后端，成员顺序保证ring先于其引用的内存析构
+				std::vector<char>						recvBuffers;
+				std::unique_ptr<IoUring>				ring;
+				uint64_t								eventValue = 0;
+			};
+			std::vector<std::unique_ptr<Reactor>>	reactors;
 			bool			isRunning = false;
-			std::thread		eventThread;
+			MpscQueue<AcceptedSocket>				acceptedSockets;
+			std::atomic<uint32_t>					numAccepting = 0;	//已accept但还未创建客户端的连接数
+			uint64_t								drainDeadline = 0;	//开始drain后的截止时间
+			Socket									handoffSocket = -1;	//等待新进程连接的unix socket
+			std::string								handoffPath;
+			bool									isMigrateClients = false;
+			uint64_t								handoffDrainTimeout = 0;
+			std::unique_ptr<TlsContext>				tlsContext;		//所有reactor共享证书和会话缓存
+			sockaddr_storage						listenAddress;
+			socklen_t								listenAddressLength = 0;
+			bool									isUnixPathOwner = false;	//退出时删除unix socket文件，交给新进程后不再删除
+			uint16_t								nextIOIndex = 0;	//unix socket的连接下一个分给的I/O线程
 
-			void readIntoBuffer(Client& client);
-			void writeFromBuffer(Client& client);
-			void writeClientBuffer(Client& client, char* data, size_t size);
+			int processEventThread(Reactor& reactor);
+			int processUringThread(Reactor& reactor);
+			bool pollReactor(Reactor& reactor, int timeout);
+			void bindIOThread(Reactor& reactor);
+			bool initReactor(Reactor& reactor, bool isListening, bool reusePort, Socket inheritedSocket);
+			bool createListenSocket(Reactor& reactor, bool reusePort);
+			bool startReactors(const std::vector<Socket>& inheritedSockets);
+			void stopAccepting(Reactor& reactor);
+			void runOnReactor(Reactor& reactor, const std::function<void()>& task);
+			void updateDrain(uint64_t now);
+			void checkHandoff();
+			bool migrateClients(Socket conn);
+			void detachClients(Reactor& reactor, std::vector<std::pair<ClientPtr, SendQueue>>& detached);
+			bool acceptClients(Reactor& reactor);
+			void onAccepted(Reactor& reactor, Socket sock, const sockaddr_storage& addr);
+			bool checkAcceptRate(Reactor& reactor, const sockaddr_storage& addr, uint64_t now);
+			void attachClient(Reactor& reactor, ClientPtr client);
+			void postCommand(uint16_t ioIndex, IOCommand&& command);
+			void wakeup(Reactor& reactor);
+			void processCommands(Reactor& reactor);
+			void tryReleaseIOClient(Reactor& reactor, IOClient& ioClient);
+			void prepareUringAccept(Reactor& reactor);
+			void prepareUringRecv(Reactor& reactor, IOClient& ioClient);
+			void prepareUringSend(Reactor& reactor, IOClient& ioClient);
+			void prepareUringWakeup(Reactor& reactor);
+			void provideUringBuffer(Reactor& reactor, uint16_t bufferID, uint16_t count = 1);
+			void readIntoBuffer(Reactor& reactor, IOClient& ioClient);
+			void writeFromBuffer(IOClient& ioClient);
+			void sendPending(Reactor& reactor, IOClient& ioClient);
+			void completeSend(IOClient& ioClient, size_t length);
+			void onTlsData(Reactor& reactor, IOClient& ioClient, const void* data, size_t length);
+			void encryptAndSend(Reactor& reactor, IOClient& ioClient, SendQueue&& plain);
+			void tryEnableKtls(IOClient& ioClient);
+			bool readErrorQueue(IOClient& ioClient);
+			void releaseZeroCopyBuffers(IOClient& ioClient, uint32_t done);
 #elif defined(__APPLE__)
         private:
+			Socket			listenSocket = 0;
 			int				kqfd = 0;
 			int				pipe_fd[2] = { 0, 0 };
 			bool			isRunning = false;
 			std::thread		eventThread;
             
+            int processEventThread();
             bool setNonBlock(int sockfd);
             void readIntoBuffer(Client& client, uint32_t numBytes);
-            void writeFromBuffer(Client& client, uint32_t numBytes);
+            void writeFromBuffer(Client& client);
 #endif
 		};
 	}
@@ -0,0 +1,21 @@
+#ifndef __WS_SOCKET_ADDRESS_H__
+#define __WS_SOCKET_ADDRESS_H__
+
+#include <string>
+#include "ws/network/NetDef.h"
+
+namespace ws
+{
+	namespace network
+	{
+		//"unix:"开头为unix socket路径，路径以@开头时为linux的抽象地址，不在文件系统中创建文件
+		constexpr const char UNIX_ADDRESS_PREFIX[] = "unix:";
+
+		//解析IPv4、IPv6或unix socket地址，unix socket忽略port，为空时为IPv4的任意地址
+		bool			resolveAddress(const std::string& address, uint16_t port, sockaddr_storage& result, socklen_t& length);
+		//IPv4映射的IPv6地址按IPv4显示，unix socket的对端没有地址，返回"unix"
+		std::string		formatAddress(const sockaddr_storage& address);
+	}
+}
+
+#endif	//__WS_SOCKET_ADDRESS_H__
@@ -0,0 +1,98 @@
+#ifndef __WS_TLS_CONTEXT_H__
+#define __WS_TLS_CONTEXT_H__
+
+#include <string>
+#include <vector>
+#include "ws/network/NetDef.h"
+#include "ws/network/SendQueue.h"
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct bio_st BIO;
+
+namespace ws
+{
+	namespace network
+	{
+		struct TlsConfig
+		{
+			std::string				certFile;			//PEM证书链，为空时不启用TLS
+			std::string				keyFile;			//PEM私钥
+			//握手完成后尝试切换到内核TLS发送，sendfile可以继续使用，需要TLS1.3和AES-GCM
+			bool					enableKtls = true;
+			bool					sessionTickets = true;	//无状态的会话恢复票据
+			long					sessionCacheSize = 20480;	//服务端会话缓存的数量
+			long					sessionTimeout = 3600;		//会话可恢复的秒数
+		};
+
+		//所有连接共享的SSL_CTX，线程安全
+		class TlsContext
+		{
+		public:
+			TlsContext() = default;
+			TlsContext(const TlsContext&) = delete;
+			~TlsContext();
+
+			bool					init(const TlsConfig& cfg);
+			inline SSL_CTX*			get() const { return ctx; }
+			inline bool				isKtlsEnabled() const { return config.enableKtls; }
+
+		private:
+			TlsConfig				config;
+			SSL_CTX*				ctx = nullptr;
+		};
+
+		//一个连接的TLS状态，通过内存BIO在I/O线程中握手和加解密
+		class TlsConnection
+		{
+		public:
+			TlsConnection(TlsContext& context);
+			TlsConnection(const TlsConnection&) = delete;
+			~TlsConnection();
+
+			//输入收到的密文，需要发送的握手数据追加到output，返回false时应断开连接
+			bool					feed(const void* data, size_t length, SendQueue& output);
+			//读取解密后的明文，返回读取的字节数，没有数据时返回0，对方关闭或出错时返回-1
+			int						read(void* buffer, size_t length);
+			//加密明文追加到output，握手完成前先暂存
+			bool					encrypt(SendQueue& plain, SendQueue& output);
+			//取出待发送的密文
+			bool					flushOutput(SendQueue& output);
+
+			inline bool				isHandshakeDone() const { return handshakeDone; }
+			//握手完成前暂存的明文字节数
+			inline size_t			pendingBytes() const { return pending.size(); }
+			inline bool				isKtls() const { return ktlsState == KtlsState::ENABLED; }
+			//握手完成且条件满足，等待已生成的密文发送完后即可切换
+			inline bool				canEnableKtls() const { return ktlsState == KtlsState::PENDING; }
+			//把发送方向交给内核，调用时用户态生成的密文必须已全部发出
+			bool					enableKtls(Socket sock);
+
+			//keylog回调，保存服务端的流量密钥
+			void					onKeyLog(const char* line);
+
+		private:
+			enum class KtlsState
+			{
+				NONE,		//不使用或不支持
+				PENDING,	//可以切换
+				ENABLED,
+			};
+
+			SSL*					ssl = nullptr;
+			BIO*					rbio = nullptr;		//收到的密文
+			BIO*					wbio = nullptr;		//待发送的密文
+			SendQueue				pending;			//握手完成前的明文
+			bool					handshakeDone = false;
+			KtlsState				ktlsState = KtlsState::NONE;
+			bool					wantKtls = false;
+			uint64_t				sendSequence = 0;	//握手后用户态已发送的记录数
+			std::vector<uint8_t>	serverSecret;		//TLS1.3服务端应用流量密钥
+
+			void					onHandshakeDone();
+			bool					write(const void* data, size_t length);
+		};
+	}
+}
+
+#endif	//__WS_TLS_CONTEXT_H__
@@ -0,0 +1,140 @@
+#ifndef __WS_UDP_SERVER_H__
+#define __WS_UDP_SERVER_H__
+
+#include <functional>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ws/network/NetDef.h"
+#include "ws/network/SendQueue.h"
+#include "ws/core/ByteArray.h"
+
+namespace ws
+{
+	namespace network
+	{
+		class UdpServer;
+
+		//一个远端地址对应一个会话，收到新地址的数据报时创建
+		class UdpSession : public std::enable_shared_from_this<UdpSession>
+		{
+			friend class UdpServer;
+		public:
+			virtual ~UdpSession() = default;
+
+			uint32_t				id = 0;
+			uint64_t				lastActiveTime = 0;
+
+			std::string				getIP() const;
+			inline uint16_t			getPort() const { return ntohs(addr.sin_port); }
+			inline const sockaddr_in&	getAddr() const { return addr; }
+
+			//每次调用发送一个数据报，在update末尾批量发出
+			//派生类可以重写全部四个重载改变发送语义，派生类内部用UdpSession::send直接发出数据报
+			virtual void			send(const void* data, size_t length);
+			virtual void			send(const ws::core::ByteArray& packet);
+			virtual void			send(ws::core::ByteArray&& packet);
+			//引用共享的数据包，不复制，发送完成前不能修改其内容
+			virtual void			send(PacketPtr packet);
+			void					kick();
+
+		protected:
+			//收到一个数据报
+			virtual void			onPacket(std::span<const uint8_t> datagram) {}
+			virtual void			onDisconnected() {}
+			//每次update在发送前调用，用于驱动会话内的定时逻辑
+			virtual void			onUpdate(uint64_t now) {}
+
+			sockaddr_in				addr = {};
+			UdpServer*				server = nullptr;
+
+		private:
+			std::vector<PacketPtr>	sendQueue;
+			bool					isClosing = false;
+			bool					isDirty = false;
+
+			void					pushPacket(PacketPtr packet);
+		};
+		using UdpSessionPtr = std::shared_ptr<UdpSession>;
+
+		struct UdpConfig
+		{
+			std::string							listenAddr;
+			uint16_t							listenPort = 0;
+			uint32_t							maxSessions = 0;		//0为默认值5000
+			uint64_t							kickTime = 0;			//会话空闲多久后踢出，0为不踢出
+			uint32_t							batchSize = 0;			//每次recvmmsg/sendmmsg的数据报数，0为默认值64
+			uint32_t							maxDatagramSize = 0;	//0为默认值1472
+			uint32_t							maxRecvPerUpdate = 0;	//每次update最多接收的数据报数，0为默认值4096
+			int									socketBufferSize = 0;	//SO_RCVBUF和SO_SNDBUF，0为系统默认
+			double								lossRate = 0;			//测试用，按比例随机丢弃收发的数据报
+			//linux下用UDP_SEGMENT把发给同一地址的等长数据报合并为一次发送
+			bool								enableGso = false;
+			//linux下用UDP_GRO合并接收，回调时仍按原始数据报拆分
+			bool								enableGro = false;
+			std::function<UdpSessionPtr()>		createSession;
+			std::function<void(UdpSessionPtr)>	onSessionCreated;
+			std::function<void(UdpSessionPtr)>	onSessionDestroyed;
+		};
+
+		//UDP服务器，在update线程中批量收发，不使用I/O线程
+		class UdpServer
+		{
+			friend class UdpSession;
+		public:
+			UdpServer() = default;
+			UdpServer(const UdpServer&) = delete;
+			virtual ~UdpServer() { cleanup(); }
+
+			virtual bool					init(const UdpConfig& cfg);
+			virtual void					update();
+			virtual void					cleanup();
+			bool							startListen();
+			UdpSessionPtr					getSession(const sockaddr_in& addr);
+			//主动创建到远端地址的会话，已存在时直接返回
+			UdpSessionPtr					connect(const std::string& ip, uint16_t port);
+			inline uint32_t					numSessions() const { return (uint32_t)sessions.size(); }
+			inline const UdpConfig&			getConfig() const { return config; }
+
+		private:
+			UdpConfig										config;
+			Socket											sock = (Socket)-1;
+			uint32_t										nextSessionID = 0;
+			std::unordered_map<uint64_t, UdpSessionPtr>		sessions;		//按地址和端口索引
+			std::vector<UdpSessionPtr>						dirtySessions;	//有待发送数据或需要关闭的会话
+			uint64_t										nextKickTime = 0;
+			std::minstd_rand								lossRandom;
+
+			//批量接收用的缓冲区，每个数据报一段
+			std::vector<uint8_t>							recvBuffer;
+			size_t											recvSegmentSize = 0;
+#ifdef __linux__
+			std::vector<mmsghdr>							recvMsgs;
+			std::vector<iovec>								recvIovs;
+			std::vector<sockaddr_in>						recvAddrs;
+			std::vector<char>								recvControls;
+
+			//批量发送，每个mmsghdr对应一次发送，GSO时包含多个数据报
+			std::vector<mmsghdr>							sendMsgs;
+			std::vector<iovec>								sendIovs;
+			std::vector<char>								sendControls;
+#endif
+
+			static uint64_t					addressKey(const sockaddr_in& addr);
+			void							receiveDatagrams(uint64_t now);
+			UdpSessionPtr					createSession(const sockaddr_in& addr, uint64_t now);
+			bool							isLost();
+			void							dispatchDatagram(const sockaddr_in& from, std::span<const uint8_t> datagram, uint64_t now);
+			void							markDirty(UdpSession& session);
+			void							flushSessions();
+			void							kickIdleSessions(uint64_t now);
+			void							destroySession(UdpSessionPtr session);
+			void							closeSocket();
+		};
+	}
+}
+
+#endif	//__WS_UDP_SERVER_H__
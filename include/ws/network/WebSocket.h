@@ -0,0 +1,101 @@
+#ifndef __WS_WEB_SOCKET_H__
+#define __WS_WEB_SOCKET_H__
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ws/network/ServerSocket.h"
+
+struct z_stream_s;
+
+namespace ws
+{
+	namespace network
+	{
+		enum class WsOpcode : uint8_t
+		{
+			CONTINUATION = 0x0,
+			TEXT = 0x1,
+			BINARY = 0x2,
+			CLOSE = 0x8,
+			PING = 0x9,
+			PONG = 0xA,
+		};
+
+		struct WebSocketConfig
+		{
+			std::string				path;						//只接受该路径的握手，为空时不限制
+			size_t					maxMessageSize = 1024 * 1024;	//分片合并或解压后的上限，超过则以1009关闭
+			//客户端请求时启用permessage-deflate，双方每条消息独立压缩
+			bool					enableDeflate = false;
+			int						deflateLevel = 6;
+			size_t					deflateThreshold = 256;		//不小于该长度的消息才压缩
+		};
+
+		//把data按4字节掩码逐字节异或，mask为掩码在报文中的原始字节，x86下使用SSE2/AVX2
+		void applyWebSocketMask(uint8_t* data, size_t length, uint32_t mask);
+
+		//RFC 6455服务端，在onRecv中完成握手和拆帧，ServerConfig不能配置拆包
+		//未分片且未压缩的消息直接引用接收缓冲区交给onMessage，原地去掩码
+		class WebSocketClient : public Client
+		{
+		public:
+			WebSocketClient(const WebSocketConfig& cfg = WebSocketConfig());
+			~WebSocketClient() override;
+
+			void					sendText(std::string_view text);
+			void					sendBinary(const void* data, size_t length);
+			void					ping(std::string_view payload = {});
+			//发送关闭帧，收到对方的关闭帧后断开
+			void					close(uint16_t code = 1000, std::string_view reason = {});
+			inline bool				isOpen() const { return state == State::OPEN; }
+
+			//生成不压缩的完整帧，可以通过ServerSocket::broadcast发给多个已握手的客户端
+			static PacketPtr		makeFrame(WsOpcode opcode, const void* data, size_t length);
+
+		protected:
+			//握手请求，返回false时以403拒绝
+			virtual bool			onHandshake(std::string_view path) { return true; }
+			virtual void			onOpen() {}
+			//完整的消息，data只在调用期间有效
+			virtual void			onMessage(std::span<const uint8_t> data, bool isText) {}
+			virtual void			onClose(uint16_t code) {}
+
+			void					onRecv() override final;
+
+		private:
+			enum class State
+			{
+				HANDSHAKE,
+				OPEN,
+				CLOSING,	//已发送关闭帧，等待对方回复
+				CLOSED,
+			};
+
+			WebSocketConfig			config;
+			State					state = State::HANDSHAKE;
+			WsOpcode				messageOpcode = WsOpcode::CONTINUATION;	//分片中的消息类型
+			bool					isCompressed = false;	//分片中的消息是否压缩
+			std::vector<uint8_t>	messageBuffer;			//合并的分片
+			std::vector<uint8_t>	inflateBuffer;
+			std::vector<uint8_t>	deflateBuffer;
+
+			//permessage-deflate协商成功后创建
+			z_stream_s*				deflater = nullptr;
+			z_stream_s*				inflater = nullptr;
+			int						deflateWindowBits = 15;
+
+			bool					handshake();
+			bool					parseFrames();
+			bool					onControlFrame(WsOpcode opcode, std::span<const uint8_t> payload);
+			bool					onFrame(WsOpcode opcode, bool isFinal, bool isRsv1, std::span<const uint8_t> payload);
+			bool					deliver(WsOpcode opcode, std::span<const uint8_t> data, bool compressed);
+			void					sendFrame(WsOpcode opcode, const void* data, size_t length);
+			void					fail(uint16_t code);
+			bool					negotiateDeflate(std::string_view offer, std::string& response);
+		};
+	}
+}
+
+#endif	//__WS_WEB_SOCKET_H__
@@ -1,16 +1,1791 @@
+#include <iostream>
+#include <fstream>
+#include <set>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+#include <spdlog/spdlog.h>
 #include "ws/network/ServerSocket.h"
 #include "ws/network/ClientSocket.h"
+#include "ws/network/ClientSocketPool.h"
+#include "ws/network/UdpServer.h"
+#include "ws/network/KcpSession.h"
+#include "ws/network/WebSocket.h"
+#include "ws/network/HttpServer.h"
+#include "ws/core/TimeTool.h"
+#ifdef __linux__
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/pem.h>
+#include <zlib.h>
+#endif
 
 using namespace ws::network;
 
+namespace
+{
+	//原样回显收到的数据
+	class EchoClient : public Client
+	{
+	protected:
+		void onRecv() override
+		{
+			send(readerBuffer.readerPointer(), readerBuffer.readAvailable());
+			readerBuffer.truncate();
+		}
+	};
+
+	//收到任意数据后回复一个大数据包，不复制直接移交给发送队列
+	class BulkClient : public Client
+	{
+	public:
+		static constexpr size_t BULK_SIZE = 4 * 1024 * 1024;
+		static inline bool isKickAfterSend = false;	//发送后立即断开，零拷贝的数据块要等内核用完才能释放
+
+		static inline uint8_t byteAt(size_t i) { return (uint8_t)(i * 7 + i / 4096); }
+
+	protected:
+		void onRecv() override
+		{
+			readerBuffer.truncate();
+			ByteArray packet(BULK_SIZE);
+			packet.writeEmptyData(BULK_SIZE);
+			auto data = (uint8_t*)packet.data(0);
+			for (size_t i = 0; i < BULK_SIZE; ++i)
+			{
+				data[i] = byteAt(i);
+			}
+			send(std::move(packet));
+			if (isKickAfterSend)
+			{
+				kick();
+			}
+		}
+	};
+
+#ifdef __linux__
+	//收到任意数据后发送一个文件，再发送一个结束标记
+	class FileClient : public Client
+	{
+	public:
+		static inline int fileFd = -1;
+		static inline size_t fileSize = 0;
+
+	protected:
+		void onRecv() override
+		{
+			readerBuffer.truncate();
+			sendFile(fileFd, 0, fileSize);
+			send("end", 3);
+		}
+	};
+
+	//回显后立即把数据交给I/O线程
+	class FlushClient : public Client
+	{
+	protected:
+		void onRecv() override
+		{
+			send(readerBuffer.readerPointer(), readerBuffer.readAvailable());
+			readerBuffer.truncate();
+			server->postFlush(id);
+		}
+	};
+#endif
+
+	//原样回显收到的数据报
+	class UdpEchoSession : public UdpSession
+	{
+	protected:
+		void onPacket(std::span<const uint8_t> datagram) override
+		{
+			send(datagram.data(), datagram.size());
+		}
+	};
+
+	//记录收到的每个数据报
+	class UdpRecvSession : public UdpSession
+	{
+	public:
+		UdpRecvSession(std::vector<std::string>& datagrams) : datagrams(datagrams) {}
+
+	protected:
+		void onPacket(std::span<const uint8_t> datagram) override
+		{
+			datagrams.emplace_back((const char*)datagram.data(), datagram.size());
+		}
+
+	private:
+		std::vector<std::string>& datagrams;
+	};
+
+	//可靠UDP回显
+	class KcpEchoSession : public KcpSession
+	{
+	protected:
+		void onRecv() override
+		{
+			send(readerBuffer.readerPointer(), readerBuffer.readAvailable());
+			readerBuffer.truncate();
+		}
+	};
+
+	//记录收到的字节流
+	class KcpRecvSession : public KcpSession
+	{
+	public:
+		KcpRecvSession(std::string& received) : received(received) {}
+
+	protected:
+		void onRecv() override
+		{
+			received.append((const char*)readerBuffer.readerPointer(), readerBuffer.readAvailable());
+			readerBuffer.truncate();
+		}
+
+	private:
+		std::string& received;
+	};
+
+	class SilentClient : public Client
+	{
+	protected:
+		void onRecv() override { readerBuffer.truncate(); }
+	};
+
+	//收到任意数据后连续发送多个大数据包，记录水位回调
+	class BurstClient : public Client
+	{
+	public:
+		static constexpr size_t PACKET_SIZE = 256 * 1024;
+		static constexpr int NUM_PACKETS = 4;
+		static inline int numBackpressure = 0;
+		static inline int numWritable = 0;
+
+	protected:
+		void onRecv() override
+		{
+			readerBuffer.truncate();
+			for (int i = 0; i < NUM_PACKETS; ++i)
+			{
+				ByteArray packet(PACKET_SIZE);
+				packet.writeEmptyData(PACKET_SIZE);
+				send(std::move(packet));
+			}
+		}
+		void onBackpressure() override { ++numBackpressure; }
+		void onWritable() override { ++numWritable; }
+	};
+
+	//记录收到的所有帧
+	class FrameClient : public Client
+	{
+	public:
+		FrameClient(std::vector<std::string>& frames) : frames(frames) {}
+
+	protected:
+		void onPacket(std::span<const uint8_t> frame) override
+		{
+			frames.emplace_back((const char*)frame.data(), frame.size());
+		}
+
+	private:
+		std::vector<std::string>& frames;
+	};
+
+	//回显WebSocket消息，保持消息类型
+	class WsEchoClient : public WebSocketClient
+	{
+	public:
+		WsEchoClient(const WebSocketConfig& cfg, uint16_t& closeCode) : WebSocketClient(cfg), closeCode(closeCode) {}
+
+	protected:
+		void onMessage(std::span<const uint8_t> data, bool isText) override
+		{
+			if (isText)
+			{
+				sendText(std::string_view((const char*)data.data(), data.size()));
+			}
+			else
+			{
+				sendBinary(data.data(), data.size());
+			}
+		}
+		void onClose(uint16_t code) override
+		{
+			closeCode = code;
+		}
+
+	private:
+		uint16_t& closeCode;
+	};
+
+	constexpr uint16_t TEST_PORT = 20480;
+
+	//启动回显服务器，用numConnections个ClientSocket各发送一次数据，等待全部回显
+	bool runEchoTest(ServerConfig config, int numConnections)
+	{
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.createClient = []() { return std::make_shared<EchoClient>(); };
+
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		const std::string message = "hello libws";
+		std::vector<std::unique_ptr<ClientSocket>> clients;
+		std::vector<std::string> received(numConnections);
+		for (int i = 0; i < numConnections; ++i)
+		{
+			auto& socket = clients.emplace_back(std::make_unique<ClientSocket>());
+			socket->onConnected = [&socket = *socket, &message]() { socket.send(message.data(), message.size()); };
+			socket->onReceived = [&str = received[i]](ByteArray& bytes)
+				{
+					str += bytes.readString(bytes.readAvailable());
+				};
+			socket->connect(config.listenAddr, config.listenPort);
+		}
+
+		auto deadline = TimeTool::getTickCount() + 5000;
+		bool allReceived = false;
+		while (!allReceived && TimeTool::getTickCount() < deadline)
+		{
+			server.update();
+			allReceived = true;
+			for (int i = 0; i < numConnections; ++i)
+			{
+				clients[i]->update();
+				allReceived = allReceived && received[i] == message;
+			}
+			std::this_thread::sleep_for(1ms);
+		}
+		//回显客户端读完数据后不再占用接收缓冲区
+		auto stats = server.getMemoryStats();
+		std::cout << "echo " << numConnections << " connections, online=" << server.numOnlines()
+			<< ", result=" << allReceived << ", buffer bytes per client=" << stats.bytesPerClient
+			<< ", pooled bytes=" << stats.pooledBytes << std::endl;
+		return allReceived && stats.readerBytes == 0;
+	}
+
+	//在listenAddr上回显，依次从connectAddrs连接，服务器看到的地址应与连接的地址一致
+	bool runAddressTest(IOBackend backend, const std::string& listenAddr, const std::vector<std::string>& connectAddrs)
+	{
+		ServerConfig config;
+		config.listenAddr = listenAddr;
+		config.listenPort = TEST_PORT;
+		config.ioBackend = backend;
+		config.numIOThreads = 2;
+		config.createClient = []() { return std::make_shared<EchoClient>(); };
+
+		std::set<std::string> expectedIPs;
+		{
+			ServerSocket server;
+			if (!server.init(config) || !server.startListen())
+			{
+				return false;
+			}
+			const std::string message = "hello libws";
+			std::vector<std::unique_ptr<ClientSocket>> clients;
+			std::vector<std::string> received(connectAddrs.size());
+			for (size_t i = 0; i < connectAddrs.size(); ++i)
+			{
+				auto& socket = clients.emplace_back(std::make_unique<ClientSocket>());
+				socket->onConnected = [&socket = *socket, &message]() { socket.send(message.data(), message.size()); };
+				socket->onReceived = [&str = received[i]](ByteArray& bytes)
+					{
+						str += bytes.readString(bytes.readAvailable());
+					};
+				socket->connect(connectAddrs[i], TEST_PORT);
+				expectedIPs.insert(connectAddrs[i].starts_with(UNIX_ADDRESS_PREFIX) ? "unix" : connectAddrs[i]);
+			}
+
+			auto deadline = TimeTool::getTickCount() + 5000;
+			bool allReceived = false;
+			while (!allReceived && TimeTool::getTickCount() < deadline)
+			{
+				server.update();
+				allReceived = true;
+				for (size_t i = 0; i < clients.size(); ++i)
+				{
+					clients[i]->update();
+					allReceived = allReceived && received[i] == message;
+				}
+				std::this_thread::sleep_for(1ms);
+			}
+			std::set<std::string> ips;
+			std::string peers;
+			for (auto& client : server.getAllClients())
+			{
+				ips.insert(client->getIP());
+				peers += client->getIP() + " ";
+			}
+			std::cout << "listen " << listenAddr << " backend=" << (int)backend << ", online=" << server.numOnlines()
+				<< ", result=" << allReceived << ", peers=" << peers << std::endl;
+			if (!allReceived || ips != expectedIPs)
+			{
+				return false;
+			}
+		}
+		//退出后删除unix socket文件
+		if (!listenAddr.starts_with(UNIX_ADDRESS_PREFIX))
+		{
+			return true;
+		}
+		std::string path = listenAddr.substr(sizeof(UNIX_ADDRESS_PREFIX) - 1);
+		return path[0] == '@' || access(path.c_str(), F_OK) != 0;
+	}
+
+	//回显后断开，检查收发计数和连接时长
+	bool runNetStatsTest(IOBackend backend)
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.ioBackend = backend;
+		config.createClient = []() { return std::make_shared<EchoClient>(); };
+
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		const int numConnections = 8;
+		const std::string message = "hello libws";
+		std::vector<std::unique_ptr<ClientSocket>> clients;
+		size_t receivedBytes = 0;
+		for (int i = 0; i < numConnections; ++i)
+		{
+			auto& socket = clients.emplace_back(std::make_unique<ClientSocket>());
+			socket->onConnected = [&socket = *socket, &message]() { socket.send(message.data(), message.size()); };
+			socket->onReceived = [&receivedBytes](ByteArray& bytes)
+				{
+					receivedBytes += bytes.readAvailable();
+					bytes.truncate();
+				};
+			socket->connect(config.listenAddr, config.listenPort);
+		}
+
+		auto deadline = TimeTool::getTickCount() + 5000;
+		while (receivedBytes < numConnections * message.size() && TimeTool::getTickCount() < deadline)
+		{
+			server.update();
+			for (auto& client : clients)
+			{
+				client->update();
+			}
+			std::this_thread::sleep_for(1ms);
+		}
+		bool isClientOk = true;
+		for (auto& client : server.getAllClients())
+		{
+			auto clientStats = client->getStats();
+			isClientOk = isClientOk && clientStats.bytesIn == message.size() && clientStats.packetsIn == 1
+				&& clientStats.packetsOut == 1 && clientStats.maxPendingBytes == message.size();
+		}
+		clients.clear();
+		while (server.numOnlines() && TimeTool::getTickCount() < deadline)
+		{
+			server.update();
+			std::this_thread::sleep_for(1ms);
+		}
+
+		auto stats = server.getNetStats();
+		std::cout << "net stats backend=" << (int)backend << ", bytes in/out=" << stats.bytesIn << "/" << stats.bytesOut
+			<< ", packets in/out=" << stats.packetsIn << "/" << stats.packetsOut << ", syscalls=" << stats.syscalls
+			<< ", recv eagain=" << stats.recvEagain << ", updates=" << stats.numUpdates
+			<< ", update p99=" << stats.updateTime.percentile(0.99) << "us, queue p99=" << stats.queueTime.percentile(0.99)
+			<< "us, lifetime count=" << stats.lifetime.count() << std::endl;
+		return isClientOk && stats.bytesIn == numConnections * message.size() && stats.bytesOut == stats.bytesIn
+			&& stats.packetsIn == numConnections && stats.packetsOut == numConnections && stats.syscalls > 0
+			&& stats.queueTime.count() == numConnections && stats.updateTime.count() == stats.numUpdates
+			&& stats.lifetime.count() == numConnections;
+	}
+
+	//慢速连接上的大数据包需要多次发送
+	bool runBulkTest(ServerConfig config)
+	{
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.createClient = []() { return std::make_shared<BulkClient>(); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		size_t received = 0;
+		bool isIntact = true;
+		bool isClosed = false;
+		ClientSocket socket;
+		socket.onConnected = [&socket]() { socket.send("?", 1); };
+		socket.onReceived = [&received, &isIntact](ByteArray& bytes)
+			{
+				auto data = (const uint8_t*)bytes.readerPointer();
+				for (size_t i = 0; i < bytes.readAvailable(); ++i)
+				{
+					isIntact = isIntact && data[i] == BulkClient::byteAt(received + i);
+				}
+				received += bytes.readAvailable();
+				bytes.seek((int)bytes.readAvailable());
+			};
+		socket.onClosed = [&isClosed]() { isClosed = true; };
+		socket.connect(config.listenAddr, config.listenPort);
+		auto deadline = TimeTool::getTickCount() + 5000;
+		while (received < BulkClient::BULK_SIZE && !isClosed && TimeTool::getTickCount() < deadline)
+		{
+			server.update();
+			socket.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		std::cout << "bulk send received " << received << " bytes, zero copy=" << (config.zeroCopyThreshold > 0)
+			<< ", kick=" << BulkClient::isKickAfterSend << ", intact=" << isIntact << std::endl;
+		// 断开时还没交给内核的数据会被丢弃，只要求收到的部分完整且连接关闭
+		if (BulkClient::isKickAfterSend)
+		{
+			return isIntact && received > 0 && isClosed;
+		}
+		return isIntact && received == BulkClient::BULK_SIZE;
+	}
+
+	//广播给所有连接，再广播给偶数id的连接
+	bool runBroadcastTest(int numConnections)
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.createClient = []() { return std::make_shared<SilentClient>(); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		std::vector<std::unique_ptr<ClientSocket>> clients;
+		std::vector<size_t> received(numConnections);
+		for (int i = 0; i < numConnections; ++i)
+		{
+			auto& socket = clients.emplace_back(std::make_unique<ClientSocket>());
+			socket->onReceived = [&count = received[i]](ByteArray& bytes)
+				{
+					count += bytes.readAvailable();
+					bytes.seek((int)bytes.readAvailable());
+				};
+			socket->connect(config.listenAddr, config.listenPort);
+		}
+		auto pump = [&](const std::function<bool()>& done)
+			{
+				auto deadline = TimeTool::getTickCount() + 5000;
+				while (!done() && TimeTool::getTickCount() < deadline)
+				{
+					server.update();
+					for (auto& socket : clients)
+					{
+						socket->update();
+					}
+					std::this_thread::sleep_for(1ms);
+				}
+				return done();
+			};
+		if (!pump([&]() { return server.numOnlines() == (uint32_t)numConnections; }))
+		{
+			return false;
+		}
+
+		ByteArray packet;
+		packet << std::string("broadcast to everyone");
+		server.broadcast(packet);
+		auto numEven = std::count_if(server.getAllClients().begin(), server.getAllClients().end(),
+			[](const ClientPtr& client) { return client->id % 2 == 0; });
+		server.broadcast(packet, [](const ClientPtr& client) { return client->id % 2 == 0; });
+		size_t expected = packet.size() * (numConnections + numEven);
+		bool result = pump([&]()
+			{
+				return std::accumulate(received.begin(), received.end(), (size_t)0) == expected;
+			});
+		std::cout << "broadcast to " << numConnections << " connections, result=" << result << std::endl;
+		return result;
+	}
+
+	//分两次发送，第二次补全第一次末尾不完整的帧
+	bool runFrameTest(const FrameConfig& frame, const std::string& part1, const std::string& part2,
+		const std::vector<std::string>& expected)
+	{
+		std::vector<std::string> frames;
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.frame = frame;
+		config.createClient = [&frames]() { return std::make_shared<FrameClient>(frames); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		ClientSocket socket;
+		socket.onReceived = [](ByteArray& bytes) { bytes.seek((int)bytes.readAvailable()); };
+		socket.onConnected = [&]() { socket.send(part1.data(), part1.size()); };
+		socket.connect(config.listenAddr, config.listenPort);
+		bool isPart2Sent = false;
+		auto deadline = TimeTool::getTickCount() + 5000;
+		while (frames.size() < expected.size() && TimeTool::getTickCount() < deadline)
+		{
+			server.update();
+			socket.update();
+			if (!isPart2Sent && frames.size() == expected.size() - 1)
+			{
+				socket.send(part2.data(), part2.size());
+				isPart2Sent = true;
+			}
+			std::this_thread::sleep_for(1ms);
+		}
+		std::cout << "decode " << frames.size() << " frames, result=" << (frames == expected) << std::endl;
+		return frames == expected;
+	}
+
+	bool runFrameTests()
+	{
+		//2字节小端长度 + 1字节消息号
+		FrameConfig lengthPrefix;
+		lengthPrefix.mode = FrameMode::LENGTH_PREFIX;
+		lengthPrefix.headerSize = 3;
+		auto makeFrame = [](uint8_t msgID, const std::string& body)
+			{
+				std::string frame(3, '\0');
+				frame[0] = (char)(body.size() & 0xff);
+				frame[1] = (char)(body.size() >> 8);
+				frame[2] = (char)msgID;
+				return frame + body;
+			};
+		std::vector<std::string> expected = { makeFrame(1, "a"), makeFrame(2, ""), makeFrame(3, std::string(3000, 'x')) };
+		std::string stream = expected[0] + expected[1] + expected[2];
+		if (!runFrameTest(lengthPrefix, stream.substr(0, 8), stream.substr(8), expected))
+		{
+			return false;
+		}
+
+		FrameConfig delimiter;
+		delimiter.mode = FrameMode::DELIMITER;
+		if (!runFrameTest(delimiter, "ping\r\npo", "ng\r\n", { "ping", "pong" }))
+		{
+			return false;
+		}
+
+		//高位字节的分隔符，且跨两次接收
+		delimiter.delimiter = "\xFF\xFE";
+		if (!runFrameTest(delimiter, "ping\xFF\xFEpong\xFF", "\xFE", { "ping", "pong" }))
+		{
+			return false;
+		}
+
+		//decode一直返回0时，缓存超过maxFrameSize即为非法
+		FrameConfig custom;
+		custom.mode = FrameMode::CUSTOM;
+		custom.maxFrameSize = 16;
+		custom.decode = [](std::span<const uint8_t> data) { return (int64_t)0; };
+		FrameDecoder decoder;
+		std::vector<uint8_t> data(custom.maxFrameSize + 1);
+		std::span<const uint8_t> frame;
+		size_t scanned = 0, consumed = 0;
+		bool result = decoder.init(custom)
+			&& decoder.next(std::span<const uint8_t>(data).first(custom.maxFrameSize), scanned, frame, consumed) == FrameResult::INCOMPLETE
+			&& decoder.next(data, scanned, frame, consumed) == FrameResult::INVALID;
+		std::cout << "custom decoder limit, result=" << result << std::endl;
+		return result;
+	}
+
+	//超过高水位后回落触发一次回调，超过上限则断开
+	bool runBackpressureTest(size_t maxSendBytes)
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.sendHighWatermark = BurstClient::PACKET_SIZE;
+		config.maxSendBytes = maxSendBytes;
+		config.createClient = []() { return std::make_shared<BurstClient>(); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+		BurstClient::numBackpressure = BurstClient::numWritable = 0;
+
+		size_t received = 0;
+		bool isClosed = false;
+		ClientSocket socket;
+		socket.onConnected = [&socket]() { socket.send("?", 1); };
+		socket.onReceived = [&received](ByteArray& bytes)
+			{
+				received += bytes.readAvailable();
+				bytes.seek((int)bytes.readAvailable());
+			};
+		socket.onClosed = [&isClosed]() { isClosed = true; };
+		socket.connect(config.listenAddr, config.listenPort);
+		const size_t total = BurstClient::PACKET_SIZE * BurstClient::NUM_PACKETS;
+		auto done = [&]() { return maxSendBytes ? isClosed : BurstClient::numWritable > 0 && received == total; };
+		auto deadline = TimeTool::getTickCount() + 5000;
+		while (!done() && TimeTool::getTickCount() < deadline)
+		{
+			server.update();
+			socket.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		std::cout << "backpressure max=" << maxSendBytes << ", received " << received << " bytes, onBackpressure="
+			<< BurstClient::numBackpressure << ", onWritable=" << BurstClient::numWritable << std::endl;
+		return done() && BurstClient::numBackpressure == 1;
+	}
+
+	//一个连接持续发送，另一个空闲，只有空闲的被踢出
+	bool runKickTest()
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.kickTime = 300;
+		config.createClient = []() { return std::make_shared<EchoClient>(); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		ClientSocket active, idle;
+		active.onReceived = idle.onReceived = [](ByteArray& bytes) { bytes.seek((int)bytes.readAvailable()); };
+		active.connect(config.listenAddr, config.listenPort);
+		idle.connect(config.listenAddr, config.listenPort);
+		auto start = TimeTool::getTickCount();
+		auto lastSend = start;
+		uint32_t maxOnlines = 0;
+		std::vector<uint32_t> clientIDs;
+		while (TimeTool::getTickCount() < start + 1000)
+		{
+			server.update();
+			active.update();
+			idle.update();
+			if (active.isConnected() && TimeTool::getTickCount() - lastSend > 50)
+			{
+				active.send("ping", 4);
+				lastSend = TimeTool::getTickCount();
+			}
+			maxOnlines = std::max(maxOnlines, server.numOnlines());
+			if (clientIDs.empty() && server.numOnlines() == 2)
+			{
+				for (auto& client : server.getAllClients())
+				{
+					clientIDs.push_back(client->id);
+				}
+			}
+			std::this_thread::sleep_for(1ms);
+		}
+		std::cout << "kick idle clients, online=" << server.numOnlines() << std::endl;
+		//被踢出的id失效，即使槽位被复用也不会查到新的客户端
+		auto numValid = std::count_if(clientIDs.begin(), clientIDs.end(),
+			[&server](uint32_t id) { return server.getClient(id) != nullptr; });
+		return maxOnlines == 2 && server.numOnlines() == 1 && numValid == 1;
+	}
+
+	//当前进程的线程数，没有/proc时返回0
+	int countThreads()
+	{
+		std::ifstream file("/proc/self/status");
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.starts_with("Threads:"))
+			{
+				return std::stoi(line.substr(8));
+			}
+		}
+		return 0;
+	}
+
+	//所有ClientSocket共用一个I/O线程，连接失败时回调onClosed
+	bool runClientReactorTest()
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.createClient = []() { return std::make_shared<EchoClient>(); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		int numThreads = countThreads();
+		constexpr int NUM_CONNECTIONS = 64;
+		const std::string message(100 * 1024, 'x');
+		std::vector<std::unique_ptr<ClientSocket>> clients;
+		std::vector<size_t> received(NUM_CONNECTIONS);
+		for (int i = 0; i < NUM_CONNECTIONS; ++i)
+		{
+			auto& socket = clients.emplace_back(std::make_unique<ClientSocket>());
+			socket->onConnected = [&socket = *socket, &message]() { socket.send(message.data(), message.size()); };
+			socket->onReceived = [&size = received[i]](ByteArray& bytes)
+				{
+					size += bytes.readAvailable();
+					bytes.seek((int)bytes.readAvailable());
+				};
+			socket->connect(config.listenAddr, config.listenPort);
+		}
+		bool isRefused = false;
+		ClientSocket refused;
+		refused.onReceived = [](ByteArray& bytes) {};
+		refused.onClosed = [&isRefused]() { isRefused = true; };
+		refused.connect(config.listenAddr, TEST_PORT + 1);
+
+		auto deadline = TimeTool::getTickCount() + 5000;
+		bool allReceived = false;
+		while ((!allReceived || !isRefused) && TimeTool::getTickCount() < deadline)
+		{
+			server.update();
+			refused.update();
+			allReceived = true;
+			for (int i = 0; i < NUM_CONNECTIONS; ++i)
+			{
+				clients[i]->update();
+				allReceived = allReceived && received[i] == message.size();
+			}
+			std::this_thread::sleep_for(1ms);
+		}
+		int addedThreads = countThreads() - numThreads;
+		std::cout << "client reactor, connections=" << NUM_CONNECTIONS << ", added threads=" << addedThreads
+			<< ", result=" << allReceived << ", refused=" << isRefused << std::endl;
+		return allReceived && isRefused && addedThreads <= 1;
+	}
+
+	//请求分散到多个连接上回显，不可用的上游按退避间隔重连
+	bool runClientPoolTest(BalancePolicy policy)
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.createClient = []() { return std::make_shared<EchoClient>(); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		ClientPoolConfig poolConfig;
+		poolConfig.policy = policy;
+		poolConfig.minReconnectDelay = 50;
+		poolConfig.maxReconnectDelay = 400;
+		ClientSocketPool pool(poolConfig);
+		size_t received = 0;
+		int numClosed = 0;
+		pool.onReceived = [&received](size_t upstream, ClientSocket& socket, ByteArray& bytes)
+			{
+				received += bytes.readAvailable();
+				bytes.seek((int)bytes.readAvailable());
+			};
+		pool.onClosed = [&numClosed](size_t upstream, ClientSocket& socket) { ++numClosed; };
+		size_t echo = pool.addUpstream(config.listenAddr, config.listenPort);
+		pool.addUpstream(config.listenAddr, TEST_PORT + 1);
+
+		constexpr int NUM_REQUESTS = 200;
+		const std::string request(1024, 'r');
+		std::set<ClientSocket*> usedSockets;
+		int numSent = 0;
+		auto start = TimeTool::getTickCount();
+		while (received < NUM_REQUESTS * request.size() && TimeTool::getTickCount() < start + 5000)
+		{
+			server.update();
+			pool.update();
+			if (pool.numConnected(echo) == poolConfig.connectionsPerUpstream)
+			{
+				for (; numSent < NUM_REQUESTS; ++numSent)
+				{
+					usedSockets.insert(pool.send(echo, request.data(), request.size()));
+				}
+			}
+			std::this_thread::sleep_for(1ms);
+		}
+		//不可用上游的4个连接各自等待约50、100、200、400毫秒，减半抖动
+		while (TimeTool::getTickCount() < start + 1000)
+		{
+			pool.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		std::cout << "client pool, policy=" << (int)policy << ", used connections=" << usedSockets.size()
+			<< ", received=" << received << ", reconnects=" << numClosed << std::endl;
+		bool isBalanced = policy == BalancePolicy::LEAST_PENDING || usedSockets.size() == poolConfig.connectionsPerUpstream;
+		return received == NUM_REQUESTS * request.size() && !usedSockets.count(nullptr) && isBalanced
+			&& numClosed >= 12 && numClosed <= 32 && pool.numConnected(1) == 0;
+	}
+
+	//一个UDP会话连续发送多个数据报，全部回显且不合并
+	bool runUdpTest(bool enableOffload)
+	{
+		UdpConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.batchSize = 16;
+		config.enableGso = config.enableGro = enableOffload;
+		config.createSession = []() { return std::make_shared<UdpEchoSession>(); };
+		UdpServer server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+		std::vector<std::string> received;
+		config.listenPort = TEST_PORT + 1;
+		config.enableGso = config.enableGro = false;
+		config.createSession = [&received]() { return std::make_shared<UdpRecvSession>(received); };
+		UdpServer peer;
+		if (!peer.init(config) || !peer.startListen())
+		{
+			return false;
+		}
+
+		auto session = peer.connect("127.0.0.1", TEST_PORT);
+		constexpr int NUM_DATAGRAMS = 100;
+		constexpr size_t DATAGRAM_SIZE = 200;
+		for (int i = 0; i < NUM_DATAGRAMS; ++i)
+		{
+			std::string datagram(DATAGRAM_SIZE, (char)i);
+			session->send(datagram.data(), datagram.size());
+		}
+		auto deadline = TimeTool::getTickCount() + 3000;
+		while (received.size() < NUM_DATAGRAMS && TimeTool::getTickCount() < deadline)
+		{
+			server.update();
+			peer.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		bool result = received.size() == NUM_DATAGRAMS;
+		for (size_t i = 0; i < received.size() && result; ++i)
+		{
+			result = received[i] == std::string(DATAGRAM_SIZE, (char)i);
+		}
+		std::cout << "udp echo " << received.size() << " datagrams, sessions=" << server.numSessions()
+			<< ", offload=" << enableOffload << ", result=" << result << std::endl;
+		return result && server.numSessions() == 1;
+	}
+
+	//两个UdpServer互为两端，双向各丢弃20%的数据报，回显的字节流必须完整有序
+	bool runKcpTest()
+	{
+		UdpConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.lossRate = 0.2;
+		config.createSession = []() { return std::make_shared<KcpEchoSession>(); };
+		UdpServer server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+		std::string received;
+		config.listenPort = TEST_PORT + 1;
+		config.createSession = [&received]() { return std::make_shared<KcpRecvSession>(received); };
+		UdpServer peer;
+		if (!peer.init(config) || !peer.startListen())
+		{
+			return false;
+		}
+
+		auto session = std::static_pointer_cast<KcpSession>(peer.connect("127.0.0.1", TEST_PORT));
+		std::string sent;
+		for (int i = 0; i < 64; ++i)
+		{
+			//包含超过mtu需要分片的消息
+			std::string message(1 + i * 97 % 3000, (char)('a' + i % 26));
+			session->send(message.data(), message.size());
+			sent += message;
+		}
+		auto start = TimeTool::getTickCount();
+		while (received.size() < sent.size() && TimeTool::getTickCount() < start + 10000)
+		{
+			server.update();
+			peer.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		bool result = received == sent;
+		std::cout << "kcp echo " << received.size() << "/" << sent.size() << " bytes with 20% loss in "
+			<< TimeTool::getTickCount() - start << "ms, rto=" << session->getRto() << ", result=" << result << std::endl;
+		if (!result)
+		{
+			return false;
+		}
+
+		//通过基类指针发送也走可靠发送，超过发送队列上限时断开
+		KcpConfig kcpConfig;
+		kcpConfig.maxSendQueue = 4;
+		config.listenPort = TEST_PORT + 2;
+		config.lossRate = 0;
+		config.createSession = [&kcpConfig]() { return std::make_shared<KcpSession>(kcpConfig); };
+		UdpServer limited;
+		if (!limited.init(config) || !limited.startListen())
+		{
+			return false;
+		}
+		UdpSessionPtr limitedSession = limited.connect("127.0.0.1", TEST_PORT);
+		std::string message(kcpConfig.mtu * 3, 'k');
+		limitedSession->send(message.data(), message.size());
+		limited.update();
+		bool queued = limited.numSessions() == 1;
+		limitedSession->send(message.data(), message.size());
+		limited.update();
+		result = queued && limited.numSessions() == 0;
+		std::cout << "kcp send queue limit, result=" << result << std::endl;
+		return result;
+	}
+
+	//向量化的去掩码与逐字节的结果一致，覆盖各种长度和起始地址
+	bool runWebSocketMaskTest()
+	{
+		std::vector<uint8_t> data(1024 + 64), expected;
+		const uint8_t mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+		uint32_t mask32;
+		memcpy(&mask32, mask, sizeof(mask32));
+		for (size_t offset = 0; offset < 32; offset += 3)
+		{
+			for (size_t length = 0; length <= 1024; length += length < 80 ? 1 : 37)
+			{
+				for (size_t i = 0; i < data.size(); ++i)
+				{
+					data[i] = (uint8_t)(i * 7 + length);
+				}
+				expected = data;
+				for (size_t i = 0; i < length; ++i)
+				{
+					expected[offset + i] ^= mask[i & 3];
+				}
+				applyWebSocketMask(data.data() + offset, length, mask32);
+				if (data != expected)
+				{
+					std::cout << "websocket mask error, offset=" << offset << ", length=" << length << std::endl;
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+#ifdef __linux__
+	//drain时先发出通知再断开
+	class DrainClient : public EchoClient
+	{
+	protected:
+		void onDrain() override
+		{
+			send("bye", 3);
+		}
+	};
+
+	//旧服务器把监听socket交给新服务器，migrate时连接也一起交出，否则通知后断开
+	bool runHandoffTest(IOBackend backend, bool migrate)
+	{
+		const std::string path = "/tmp/libws_test_handoff.sock";
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.ioBackend = backend;
+		config.createClient = []() { return std::make_shared<DrainClient>(); };
+		ServerSocket oldServer, newServer;
+		if (!oldServer.init(config) || !oldServer.startListen() || !oldServer.listenHandoff(path, migrate, 1000)
+			|| !newServer.init(config))
+		{
+			return false;
+		}
+
+		std::string received;
+		bool isClosed = false;
+		ClientSocket socket;
+		socket.onConnected = [&socket]() { socket.send("hello", 5); };
+		socket.onReceived = [&received](ByteArray& bytes) { received += bytes.readString(bytes.readAvailable()); };
+		socket.onClosed = [&isClosed]() { isClosed = true; };
+		socket.connect(config.listenAddr, config.listenPort);
+		auto deadline = TimeTool::getTickCount() + 3000;
+		while (received != "hello" && TimeTool::getTickCount() < deadline)
+		{
+			oldServer.update();
+			socket.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		socket.send("pending", 7);
+		socket.update();
+
+		//新服务器在另一个线程中接管，相当于另一个进程
+		std::atomic_bool isTakenOver = false, isDone = false;
+		std::thread newProcess([&]()
+			{
+				isTakenOver = newServer.takeOver(path);
+				isDone = true;
+			});
+		while (!isDone)
+		{
+			oldServer.update();
+			socket.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		newProcess.join();
+
+		//新连接由新服务器处理
+		std::string freshReceived;
+		ClientSocket fresh;
+		fresh.onConnected = [&fresh]() { fresh.send("fresh", 5); };
+		fresh.onReceived = [&freshReceived](ByteArray& bytes) { freshReceived += bytes.readString(bytes.readAvailable()); };
+		fresh.connect(config.listenAddr, config.listenPort);
+		const std::string expected = migrate ? "hellopendingagain" : "hellopendingbye";
+		bool isAgainSent = false;
+		while ((received != expected || freshReceived != "fresh" || !oldServer.isDrained() || isClosed == migrate)
+			&& TimeTool::getTickCount() < deadline)
+		{
+			oldServer.update();
+			newServer.update();
+			socket.update();
+			fresh.update();
+			if (migrate && !isAgainSent && received == "hellopending")
+			{
+				socket.send("again", 5);
+				isAgainSent = true;
+			}
+			std::this_thread::sleep_for(1ms);
+		}
+		std::cout << (backend == IOBackend::IO_URING ? "io_uring" : "epoll") << " handoff, migrate=" << migrate << ", taken over=" << isTakenOver << ", received=" << received
+			<< ", closed=" << isClosed << ", new server online=" << newServer.numOnlines()
+			<< ", old server drained=" << oldServer.isDrained() << std::endl;
+		return isTakenOver && received == expected && freshReceived == "fresh" && oldServer.isDrained()
+			&& isClosed != migrate && newServer.numOnlines() == (migrate ? 2u : 1u);
+	}
+
+	//同一IP短时间内的连接超过突发上限后被拒绝
+	bool runAcceptLimitTest(IOBackend backend)
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.ioBackend = backend;
+		config.maxAcceptsPerLoop = 1;
+		config.acceptRatePerIP = 1;
+		config.acceptBurstPerIP = 2;
+		config.createClient = []() { return std::make_shared<EchoClient>(); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		std::vector<std::unique_ptr<ClientSocket>> clients;
+		for (int i = 0; i < 5; ++i)
+		{
+			auto& socket = clients.emplace_back(std::make_unique<ClientSocket>());
+			socket->onReceived = [](ByteArray& bytes) { bytes.seek((int)bytes.readAvailable()); };
+			socket->connect(config.listenAddr, config.listenPort);
+		}
+		auto start = TimeTool::getTickCount();
+		uint32_t maxOnlines = 0;
+		while (TimeTool::getTickCount() < start + 300)
+		{
+			server.update();
+			for (auto& socket : clients)
+			{
+				socket->update();
+			}
+			maxOnlines = std::max(maxOnlines, server.numOnlines());
+			std::this_thread::sleep_for(1ms);
+		}
+		std::cout << "accept rate limit, online=" << server.numOnlines() << std::endl;
+		return maxOnlines == 2 && server.numOnlines() == 2;
+	}
+
+	//生成临时的自签名证书和EC私钥
+	bool createTestCertificate(const std::string& certFile, const std::string& keyFile)
+	{
+		EVP_PKEY* key = EVP_EC_gen("P-256");
+		X509* cert = X509_new();
+		bool result = key && cert;
+		if (result)
+		{
+			ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+			X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+			X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+			X509_set_pubkey(cert, key);
+			X509_NAME* name = X509_get_subject_name(cert);
+			X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+			X509_set_issuer_name(cert, name);
+			result = X509_sign(cert, key, EVP_sha256()) > 0;
+		}
+		if (FILE* fp = result ? fopen(certFile.c_str(), "w") : nullptr)
+		{
+			result = PEM_write_X509(fp, cert) == 1;
+			fclose(fp);
+		}
+		if (FILE* fp = result ? fopen(keyFile.c_str(), "w") : nullptr)
+		{
+			result = PEM_write_PrivateKey(fp, key, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+			fclose(fp);
+		}
+		X509_free(cert);
+		EVP_PKEY_free(key);
+		return result;
+	}
+
+	//客户端用阻塞socket握手后回显一段跨多个记录的数据，第二次连接恢复第一次的会话
+	bool runTlsTest(IOBackend backend)
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.ioBackend = backend;
+		config.tls.certFile = "/tmp/libws_test_cert.pem";
+		config.tls.keyFile = "/tmp/libws_test_key.pem";
+		config.createClient = []() { return std::make_shared<EchoClient>(); };
+		ServerSocket server;
+		if (!createTestCertificate(config.tls.certFile, config.tls.keyFile) || !server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		std::atomic_bool isDone = false;
+		bool result = true;
+		int numReused = 0;
+		std::thread clientThread([&]()
+			{
+				SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+				SSL_SESSION* session = nullptr;
+				for (int i = 0; i < 2 && result; ++i)
+				{
+					sockaddr_in addr;
+					memset(&addr, 0, sizeof(addr));
+					addr.sin_family = AF_INET;
+					addr.sin_port = htons(config.listenPort);
+					inet_pton(AF_INET, config.listenAddr.c_str(), &addr.sin_addr);
+					int sock = socket(AF_INET, SOCK_STREAM, 0);
+					timeval timeout{ 3, 0 };
+					setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+					SSL* ssl = SSL_new(ctx);
+					SSL_set_fd(ssl, sock);
+					if (session)
+					{
+						SSL_set_session(ssl, session);
+					}
+					std::string message(100000, (char)('a' + i));
+					result = ::connect(sock, (sockaddr*)&addr, sizeof(addr)) == 0 && SSL_connect(ssl) == 1
+						&& SSL_write(ssl, message.data(), (int)message.size()) == (int)message.size();
+					std::string echo;
+					char buffer[4096];
+					while (result && echo.size() < message.size())
+					{
+						int length = SSL_read(ssl, buffer, sizeof(buffer));
+						result = length > 0;
+						echo.append(buffer, std::max(length, 0));
+					}
+					result = result && echo == message;
+					numReused += SSL_session_reused(ssl);
+					SSL_SESSION_free(session);
+					session = SSL_get1_session(ssl);
+					SSL_shutdown(ssl);
+					SSL_free(ssl);
+					close(sock);
+				}
+				SSL_SESSION_free(session);
+				SSL_CTX_free(ctx);
+				isDone = true;
+			});
+		while (!isDone)
+		{
+			server.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		clientThread.join();
+		std::cout << (backend == IOBackend::IO_URING ? "io_uring" : "epoll") << " tls echo, reused="
+			<< numReused << ", result=" << result << std::endl;
+		return result && numReused == 1;
+	}
+
+	//客户端发出的帧必须带掩码
+	std::string makeClientFrame(uint8_t firstByte, std::string_view payload)
+	{
+		std::string frame(1, (char)firstByte);
+		size_t length = payload.size();
+		if (length < 126)
+		{
+			frame += (char)(0x80 | length);
+		}
+		else if (length <= 0xFFFF)
+		{
+			frame += (char)(0x80 | 126);
+			frame += (char)(length >> 8);
+			frame += (char)length;
+		}
+		else
+		{
+			frame += (char)(0x80 | 127);
+			for (int i = 0; i < 8; ++i)
+			{
+				frame += (char)((uint64_t)length >> (56 - i * 8));
+			}
+		}
+		const char mask[4] = { 0x37, (char)0xFA, 0x21, 0x3D };
+		frame.append(mask, sizeof(mask));
+		for (size_t i = 0; i < length; ++i)
+		{
+			frame += (char)(payload[i] ^ mask[i & 3]);
+		}
+		return frame;
+	}
+
+	//读取服务端的一个帧，服务端的帧不带掩码
+	bool readServerFrame(int sock, uint8_t& firstByte, std::string& payload)
+	{
+		uint8_t header[10];
+		if (recv(sock, header, 2, MSG_WAITALL) != 2)
+		{
+			return false;
+		}
+		firstByte = header[0];
+		uint64_t length = header[1] & 0x7F;
+		int extraBytes = length == 126 ? 2 : (length == 127 ? 8 : 0);
+		if (extraBytes)
+		{
+			if (recv(sock, header + 2, extraBytes, MSG_WAITALL) != extraBytes)
+			{
+				return false;
+			}
+			length = 0;
+			for (int i = 0; i < extraBytes; ++i)
+			{
+				length = (length << 8) | header[2 + i];
+			}
+		}
+		payload.resize(length);
+		return !length || recv(sock, payload.data(), length, MSG_WAITALL) == (ssize_t)length;
+	}
+
+	//permessage-deflate，压缩时去掉结尾的00 00 FF FF，解压时补上
+	std::string deflateMessage(std::string_view data, bool isCompress, int flush = Z_SYNC_FLUSH)
+	{
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+		std::string input(data);
+		if (isCompress)
+		{
+			deflateInit2(&stream, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+		}
+		else
+		{
+			inflateInit2(&stream, -15);
+			input.append("\x00\x00\xFF\xFF", 4);
+		}
+		std::string output(1024 * 1024, '\0');
+		stream.next_in = (Bytef*)input.data();
+		stream.avail_in = (uInt)input.size();
+		stream.next_out = (Bytef*)output.data();
+		stream.avail_out = (uInt)output.size();
+		if (isCompress)
+		{
+			//Z_FINISH以BFINAL块结尾，不带同步刷新的尾部
+			deflate(&stream, flush);
+			deflateEnd(&stream);
+			output.resize(stream.total_out - (flush == Z_SYNC_FLUSH ? 4 : 0));
+		}
+		else
+		{
+			inflate(&stream, Z_SYNC_FLUSH);
+			inflateEnd(&stream);
+			output.resize(stream.total_out);
+		}
+		return output;
+	}
+
+	//连接并完成握手，response为握手响应，失败时为空
+	int openWebSocket(const ServerConfig& config, bool enableDeflate, std::string& response)
+	{
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(config.listenPort);
+		inet_pton(AF_INET, config.listenAddr.c_str(), &addr.sin_addr);
+		int sock = socket(AF_INET, SOCK_STREAM, 0);
+		timeval timeout{ 3, 0 };
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		bool result = ::connect(sock, (sockaddr*)&addr, sizeof(addr)) == 0;
+
+		// RFC 6455中的示例key
+		std::string request = "GET /chat?room=1 HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\n"
+			"Connection: keep-alive, Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n";
+		if (enableDeflate)
+		{
+			request += "Sec-WebSocket-Extensions: x-unknown, permessage-deflate; client_max_window_bits\r\n";
+		}
+		request += "\r\n";
+		char c;
+		response.clear();
+		::send(sock, request.data(), request.size(), 0);
+		while (result && response.find("\r\n\r\n") == std::string::npos)
+		{
+			result = recv(sock, &c, 1, 0) == 1;
+			response += c;
+		}
+		if (!result)
+		{
+			response.clear();
+		}
+		return sock;
+	}
+
+	//握手、单帧文本、夹杂ping的分片二进制消息、可选的压缩消息和关闭握手
+	bool runWebSocketTest(bool enableDeflate)
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		WebSocketConfig wsConfig;
+		wsConfig.path = "/chat";
+		wsConfig.enableDeflate = enableDeflate;
+		uint16_t closeCode = 0;
+		config.createClient = [&wsConfig, &closeCode]() { return std::make_shared<WsEchoClient>(wsConfig, closeCode); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		std::atomic_bool isDone = false;
+		bool result = true;
+		std::thread clientThread([&]()
+			{
+				std::string response;
+				char c;
+				int sock = openWebSocket(config, enableDeflate, response);
+				result = response.starts_with("HTTP/1.1 101")
+					&& response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != std::string::npos
+					&& (response.find("permessage-deflate") != std::string::npos) == enableDeflate;
+
+				uint8_t firstByte = 0;
+				std::string payload;
+				auto frame = makeClientFrame(0x81, "hello");
+				::send(sock, frame.data(), frame.size(), 0);
+				result = result && readServerFrame(sock, firstByte, payload) && firstByte == 0x81 && payload == "hello";
+
+				// 三个分片中间插入ping
+				std::string message(100000, 0);
+				for (size_t i = 0; i < message.size(); ++i)
+				{
+					message[i] = (char)(i % 251);
+				}
+				frame = makeClientFrame(0x02, std::string_view(message).substr(0, 30000));
+				frame += makeClientFrame(0x89, "ping");
+				frame += makeClientFrame(0x00, std::string_view(message).substr(30000, 30000));
+				frame += makeClientFrame(0x80, std::string_view(message).substr(60000));
+				if (enableDeflate)
+				{
+					frame += makeClientFrame(0xC2, deflateMessage(message, true));
+					frame += makeClientFrame(0xC2, deflateMessage(message, true, Z_FINISH));
+				}
+				::send(sock, frame.data(), frame.size(), 0);
+				result = result && readServerFrame(sock, firstByte, payload) && firstByte == 0x8A && payload == "ping";
+				for (int i = 0; i < (enableDeflate ? 3 : 1) && result; ++i)
+				{
+					result = readServerFrame(sock, firstByte, payload) && firstByte == (enableDeflate ? 0xC2 : 0x82);
+					result = result && (enableDeflate ? deflateMessage(payload, false) : payload) == message;
+				}
+
+				frame = makeClientFrame(0x88, std::string("\x03\xE8", 2));
+				::send(sock, frame.data(), frame.size(), 0);
+				result = result && readServerFrame(sock, firstByte, payload) && firstByte == 0x88 && payload == std::string("\x03\xE8", 2);
+				result = result && recv(sock, &c, 1, 0) == 0;
+				close(sock);
+				isDone = true;
+			});
+		while (!isDone)
+		{
+			server.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		clientThread.join();
+		std::cout << "websocket echo, deflate=" << enableDeflate << ", close code=" << closeCode << ", result=" << result << std::endl;
+		return result && closeCode == 1000;
+	}
+
+	//多字节字符跨分片的合法文本正常回显，压缩后的非法UTF-8文本以1007关闭
+	bool runWebSocketUtf8Test()
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		WebSocketConfig wsConfig;
+		wsConfig.path = "/chat";
+		wsConfig.enableDeflate = true;
+		uint16_t closeCode = 0;
+		config.createClient = [&wsConfig, &closeCode]() { return std::make_shared<WsEchoClient>(wsConfig, closeCode); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		std::atomic_bool isDone = false;
+		bool result = true;
+		std::thread clientThread([&]()
+			{
+				std::string response;
+				char c;
+				int sock = openWebSocket(config, true, response);
+				result = response.starts_with("HTTP/1.1 101");
+
+				uint8_t firstByte = 0;
+				std::string payload;
+				//短于deflateThreshold，回显不压缩
+				std::string text = "h\xC3\xA9llo \xE2\x82\xAC \xF0\x9F\x98\x80";
+				auto frame = makeClientFrame(0x01, std::string_view(text).substr(0, 2));
+				frame += makeClientFrame(0x80, std::string_view(text).substr(2));
+				::send(sock, frame.data(), frame.size(), 0);
+				result = result && readServerFrame(sock, firstByte, payload) && firstByte == 0x81 && payload == text;
+
+				// U+D800代理区编码
+				frame = makeClientFrame(0xC1, deflateMessage("ok \xED\xA0\x80", true));
+				::send(sock, frame.data(), frame.size(), 0);
+				result = result && readServerFrame(sock, firstByte, payload) && firstByte == 0x88 && payload == std::string("\x03\xEF", 2);
+				result = result && recv(sock, &c, 1, 0) == 0;
+				close(sock);
+				isDone = true;
+			});
+		while (!isDone)
+		{
+			server.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		clientThread.join();
+		std::cout << "websocket utf8, close code=" << closeCode << ", result=" << result << std::endl;
+		return result && closeCode == 1007;
+	}
+
+	//阻塞读取直到收到expectedLength字节或连接关闭
+	std::string recvHttp(int sock, size_t expectedLength)
+	{
+		std::string data(expectedLength, '\0');
+		ssize_t length = recv(sock, data.data(), expectedLength, MSG_WAITALL);
+		data.resize(std::max<ssize_t>(length, 0));
+		return data;
+	}
+
+	//管线化、分段到达的请求、请求体、HEAD、404/405和Connection: close
+	bool runHttpTest(IOBackend backend)
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.ioBackend = backend;
+		HttpServer server;
+		auto healthBody = std::make_shared<const ByteArray>("ok", 2, true);
+		server.get("/health", [healthBody](const HttpServerRequest& request, HttpServerResponse& response)
+			{
+				response.setContentType("text/plain");
+				response.write(healthBody);
+			});
+		server.post("/echo", [](const HttpServerRequest& request, HttpServerResponse& response)
+			{
+				response.write(request.getQuery("tag"));
+				response.write(request.body);
+			});
+		server.get("/gm/*", [](const HttpServerRequest& request, HttpServerResponse& response)
+			{
+				response.setStatus(201);
+				response.write(request.path);
+			});
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+
+		std::atomic_bool isDone = false;
+		bool result = true;
+		std::thread clientThread([&]()
+			{
+				sockaddr_in addr;
+				memset(&addr, 0, sizeof(addr));
+				addr.sin_family = AF_INET;
+				addr.sin_port = htons(config.listenPort);
+				inet_pton(AF_INET, config.listenAddr.c_str(), &addr.sin_addr);
+				int sock = socket(AF_INET, SOCK_STREAM, 0);
+				timeval timeout{ 3, 0 };
+				setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+				result = ::connect(sock, (sockaddr*)&addr, sizeof(addr)) == 0;
+
+				const std::string healthRequest = "GET /health HTTP/1.1\r\nHost: localhost\r\n\r\n";
+				const std::string healthResponse = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 2\r\n\r\nok";
+				// 三个请求一次发出，第四个请求分两次到达
+				std::string requests = healthRequest + healthRequest + "POST /echo?tag=x HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 5\r\n\r\nhello"
+					+ healthRequest.substr(0, 10);
+				::send(sock, requests.data(), requests.size(), 0);
+				std::string echoResponse = "HTTP/1.1 200 OK\r\nContent-Length: 6\r\n\r\nxhello";
+				std::string expected = healthResponse + healthResponse + echoResponse;
+				result = result && recvHttp(sock, expected.size()) == expected;
+				requests = healthRequest.substr(10) + "HEAD /health HTTP/1.1\r\n\r\n" + "PUT /health HTTP/1.1\r\n\r\n"
+					+ "GET /none HTTP/1.1\r\n\r\n" + "GET /gm/reload HTTP/1.1\r\nConnection: close\r\n\r\n";
+				::send(sock, requests.data(), requests.size(), 0);
+				expected = healthResponse + healthResponse.substr(0, healthResponse.size() - 2)
+					+ "HTTP/1.1 405 Method Not Allowed\r\nAllow: GET, HEAD\r\nContent-Length: 0\r\n\r\n"
+					+ "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n"
+					+ "HTTP/1.1 201 Created\r\nContent-Length: 10\r\nConnection: close\r\n\r\n/gm/reload";
+				// 最后一个响应后服务器关闭连接
+				result = result && recvHttp(sock, expected.size() + 1) == expected;
+				close(sock);
+
+				//取值不同的多个Content-Length
+				sock = socket(AF_INET, SOCK_STREAM, 0);
+				setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+				result = result && ::connect(sock, (sockaddr*)&addr, sizeof(addr)) == 0;
+				requests = "POST /echo HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 6\r\n\r\nhello!";
+				::send(sock, requests.data(), requests.size(), 0);
+				expected = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+				result = result && recvHttp(sock, expected.size() + 1) == expected;
+				close(sock);
+				isDone = true;
+			});
+		while (!isDone)
+		{
+			server.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		clientThread.join();
+		std::cout << (backend == IOBackend::IO_URING ? "io_uring" : "epoll") << " http server, result=" << result << std::endl;
+		return result;
+	}
+
+	bool runSendFileTest(IOBackend backend)
+	{
+		char path[] = "/tmp/ws_send_file_XXXXXX";
+		FileClient::fileFd = mkstemp(path);
+		unlink(path);
+		std::string content(1024 * 1024 + 17, '\0');
+		for (size_t i = 0; i < content.size(); ++i)
+		{
+			content[i] = (char)(i * 31);
+		}
+		FileClient::fileSize = content.size();
+		if (write(FileClient::fileFd, content.data(), content.size()) != (ssize_t)content.size())
+		{
+			return false;
+		}
+
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.ioBackend = backend;
+		config.createClient = []() { return std::make_shared<FileClient>(); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+		std::string received;
+		ClientSocket socket;
+		socket.onConnected = [&socket]() { socket.send("?", 1); };
+		socket.onReceived = [&received](ByteArray& bytes) { received += bytes.readString(bytes.readAvailable()); };
+		socket.connect(config.listenAddr, config.listenPort);
+		auto deadline = TimeTool::getTickCount() + 5000;
+		while (received.size() < content.size() + 3 && TimeTool::getTickCount() < deadline)
+		{
+			server.update();
+			socket.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		close(FileClient::fileFd);
+		bool result = received == content + "end";
+		std::cout << "send file received " << received.size() << " bytes, result=" << result << std::endl;
+		return result;
+	}
+
+	//向每个I/O线程投递任务，并在update中途发送数据
+	bool runPostTest(IOBackend backend)
+	{
+		ServerConfig config;
+		config.listenAddr = "127.0.0.1";
+		config.listenPort = TEST_PORT;
+		config.ioBackend = backend;
+		config.numIOThreads = 2;
+		config.createClient = []() { return std::make_shared<FlushClient>(); };
+		ServerSocket server;
+		if (!server.init(config) || !server.startListen())
+		{
+			return false;
+		}
+		std::atomic_int numTasks = 0;
+		std::thread poster([&server, &numTasks]()
+			{
+				for (uint16_t i = 0; i < 2; ++i)
+				{
+					server.post([&numTasks]() { ++numTasks; }, i);
+				}
+			});
+		poster.join();
+
+		const std::string message = "post flush";
+		std::string received;
+		ClientSocket socket;
+		socket.onConnected = [&socket, &message]() { socket.send(message.data(), message.size()); };
+		socket.onReceived = [&received](ByteArray& bytes) { received += bytes.readString(bytes.readAvailable()); };
+		socket.connect(config.listenAddr, config.listenPort);
+		auto deadline = TimeTool::getTickCount() + 5000;
+		while ((numTasks < 2 || received != message) && TimeTool::getTickCount() < deadline)
+		{
+			server.update();
+			socket.update();
+			std::this_thread::sleep_for(1ms);
+		}
+		std::cout << "post tasks " << numTasks << ", received " << received.size() << " bytes" << std::endl;
+		return numTasks == 2 && received == message;
+	}
+#endif
+}
+
 bool testServerSocket()
 {
+	std::cout << "====================Test ServerSocket====================" << std::endl;
+	ServerConfig config;
+	if (!runEchoTest(config, 4))
+	{
+		return false;
+	}
+	//多个I/O线程
+	config.numIOThreads = 2;
+	if (!runEchoTest(config, 16))
+	{
+		return false;
+	}
+	if (!runBulkTest(config))
+	{
+		return false;
+	}
+	if (!runBroadcastTest(16))
+	{
+		return false;
+	}
+	if (!runKickTest())
+	{
+		return false;
+	}
+	if (!runFrameTests())
+	{
+		return false;
+	}
+	if (!runBackpressureTest(0) || !runBackpressureTest(BurstClient::PACKET_SIZE * 2))
+	{
+		return false;
+	}
+	if (!runUdpTest(false) || !runKcpTest())
+	{
+		return false;
+	}
+	if (!runWebSocketMaskTest())
+	{
+		return false;
+	}
+#ifdef __linux__
+	//GSO和GRO只在linux下生效
+	if (!runUdpTest(true))
+	{
+		return false;
+	}
+	config.zeroCopyThreshold = 64 * 1024;
+	if (!runBulkTest(config))
+	{
+		return false;
+	}
+	BulkClient::isKickAfterSend = true;
+	bool isKickOk = runBulkTest(config);
+	BulkClient::isKickAfterSend = false;
+	if (!isKickOk)
+	{
+		return false;
+	}
+	config.zeroCopyThreshold = 0;
+	for (auto backend : { IOBackend::EPOLL, IOBackend::IO_URING })
+	{
+		if (!runSendFileTest(backend))
+		{
+			return false;
+		}
+	}
+	for (auto backend : { IOBackend::EPOLL, IOBackend::IO_URING })
+	{
+		if (!runPostTest(backend) || !runAcceptLimitTest(backend) || !runTlsTest(backend) || !runHttpTest(backend))
+		{
+			return false;
+		}
+	}
+	//io_uring后端只交出监听socket
+	if (!runHandoffTest(IOBackend::EPOLL, false) || !runHandoffTest(IOBackend::EPOLL, true) || !runHandoffTest(IOBackend::IO_URING, false))
+	{
+		return false;
+	}
+	//双栈IPv6和unix socket
+	const std::string unixPath = "unix:/tmp/libws_test.sock";
+	if (!runAddressTest(IOBackend::EPOLL, "::", { "127.0.0.1", "::1" })
+		|| !runAddressTest(IOBackend::EPOLL, unixPath, { unixPath, unixPath, unixPath })
+		|| !runAddressTest(IOBackend::IO_URING, "unix:@libws_test", { "unix:@libws_test", "unix:@libws_test" }))
+	{
+		return false;
+	}
+	for (auto backend : { IOBackend::EPOLL, IOBackend::IO_URING })
+	{
+		if (!runNetStatsTest(backend))
+		{
+			return false;
+		}
+	}
+	if (!runWebSocketTest(false) || !runWebSocketTest(true) || !runWebSocketUtf8Test())
+	{
+		return false;
+	}
+	//每轮只accept一个连接
+	config.maxAcceptsPerLoop = 1;
+	if (!runEchoTest(config, 16))
+	{
+		return false;
+	}
+	config.maxAcceptsPerLoop = 0;
+	config.ioBackend = IOBackend::IO_URING;
+	if (!runEchoTest(config, 16))
+	{
+		return false;
+	}
+	//I/O线程轮询并绑定CPU
+	config.busyPoll = true;
+	config.ioThreadCpus = { 0 };
+	for (auto backend : { IOBackend::EPOLL, IOBackend::IO_URING })
+	{
+		config.ioBackend = backend;
+		if (!runEchoTest(config, 16))
+		{
+			return false;
+		}
+	}
+	config.busyPoll = false;
+	config.ioThreadCpus.clear();
+	//收发和逻辑都在update线程中
+	config.ioBackend = IOBackend::EPOLL;
+	config.numIOThreads = 1;
+	config.pollInUpdate = true;
+	if (!runEchoTest(config, 16))
+	{
+		return false;
+	}
+#endif
+	std::cout << std::endl;
 	return true;
 }
 
 bool testClientSocket()
 {
+	std::cout << "====================Test ClientSocket====================" << std::endl;
+	if (!runClientReactorTest())
+	{
+		return false;
+	}
+	if (!runClientPoolTest(BalancePolicy::ROUND_ROBIN) || !runClientPoolTest(BalancePolicy::LEAST_PENDING))
+	{
+		return false;
+	}
+	std::cout << std::endl;
 	return true;
 }
-
-
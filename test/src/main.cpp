@@ -19,6 +19,8 @@ extern bool testSonyflake();
 extern bool testPidfile();
 #endif
 extern bool testTimer();
+extern bool testServerSocket();
+extern bool testClientSocket();
 
 int main()
 {
@@ -41,6 +43,8 @@ int main()
 		//testAStar() &&
 		//testEnum() &&
 		//testTypeCheck() &&
+		testServerSocket() &&
+		testClientSocket() &&
 		testDatabase()
 		//testTimer() &&
 		//testCallstack() &&
@@ -1,5 +1,6 @@
 #include <openssl/evp.h>
 #include <ctype.h>
+#include <algorithm>
 #include <sstream>
 #include <chrono>
 #include "ws/core/String.h"
@@ -240,6 +241,12 @@ namespace ws::core::String
 		return result;
 	}
 
+	bool iequals(std::string_view a, std::string_view b)
+	{
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+			[](char x, char y) { return tolower((unsigned char)x) == tolower((unsigned char)y); });
+	}
+
 	std::string_view ltrim(std::string_view sv)
 	{
 		sv.remove_prefix(std::min(sv.find_first_not_of(" \n\r\t\f\v"), sv.size()));
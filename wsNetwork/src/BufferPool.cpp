@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <bit>
+#include "ws/network/BufferPool.h"
+
+using namespace ws::network;
+using ws::core::ByteArray;
+
+namespace
+{
+	// 每一位表示一个槽位是否被线程占用
+	std::atomic<uint64_t> usedSlots = 0;
+}
+
+size_t BufferPool::classIndex(size_t size)
+{
+	size_t index = 0;
+	size_t classSize = BUFFER_SIZE;
+	while (classSize < size && index < NUM_CLASSES)
+	{
+		classSize <<= 1;
+		++index;
+	}
+	return index;
+}
+
+uint32_t BufferPool::threadSlot()
+{
+	// 线程在所有池中使用同一个槽位，退出后槽位连同其中缓存的缓冲区留给新线程
+	struct Slot
+	{
+		uint32_t index = MAX_LOCAL_CACHES;
+		Slot()
+		{
+			uint64_t used = usedSlots.load(std::memory_order_relaxed);
+			while (~used)
+			{
+				uint32_t bit = (uint32_t)std::countr_zero(~used);
+				if (usedSlots.compare_exchange_weak(used, used | (1ull << bit), std::memory_order_acquire))
+				{
+					index = bit;
+					break;
+				}
+			}
+		}
+		~Slot()
+		{
+			if (index < MAX_LOCAL_CACHES)
+			{
+				usedSlots.fetch_and(~(1ull << index), std::memory_order_release);
+			}
+		}
+	};
+	static_assert(MAX_LOCAL_CACHES == 64);
+	thread_local Slot slot;
+	return slot.index;
+}
+
+BufferPool::LocalCache* BufferPool::localCache()
+{
+	uint32_t slot = threadSlot();
+	return slot < MAX_LOCAL_CACHES ? &localCaches[slot] : nullptr;
+}
+
+void BufferPool::takeShared(size_t index, std::vector<ByteArray>& buffers, size_t count)
+{
+	auto& sizeClass = classes[index];
+	std::lock_guard<std::mutex> lock(sizeClass.mtx);
+	count = std::min(count, sizeClass.buffers.size());
+	for (size_t i = 0; i < count; ++i)
+	{
+		buffers.push_back(std::move(sizeClass.buffers.back()));
+		sizeClass.buffers.pop_back();
+	}
+	numSharedBytes -= count * ((size_t)BUFFER_SIZE << index);
+}
+
+void BufferPool::putShared(size_t index, std::vector<ByteArray>& buffers, size_t count)
+{
+	size_t capacity = (size_t)BUFFER_SIZE << index;
+	auto& sizeClass = classes[index];
+	{
+		std::lock_guard<std::mutex> lock(sizeClass.mtx);
+		size_t room = MAX_CLASS_BYTES / capacity - std::min(MAX_CLASS_BYTES / capacity, sizeClass.buffers.size());
+		size_t moved = std::min(count, room);
+		for (size_t i = 0; i < moved; ++i)
+		{
+			sizeClass.buffers.push_back(std::move(buffers.back()));
+			buffers.pop_back();
+		}
+		numSharedBytes += moved * capacity;
+		count -= moved;
+	}
+	// 共享链表已满，在锁外释放
+	buffers.resize(buffers.size() - count);
+}
+
+ByteArray BufferPool::alloc(size_t size /*= BUFFER_SIZE*/)
+{
+	size_t index = classIndex(size);
+	if (index >= NUM_CLASSES)
+	{
+		return ByteArray(size);
+	}
+	size_t capacity = (size_t)BUFFER_SIZE << index;
+	LocalCache* local = localCache();
+	if (!local)
+	{
+		std::vector<ByteArray> buffers;
+		takeShared(index, buffers, 1);
+		return buffers.empty() ? ByteArray(capacity) : std::move(buffers.back());
+	}
+	auto& buffers = local->buffers[index];
+	if (buffers.empty())
+	{
+		// 一次取回半个缓存，摊薄加锁的开销
+		takeShared(index, buffers, std::max<size_t>(LOCAL_CLASS_BYTES / capacity / 2, 1));
+		if (buffers.empty())
+		{
+			return ByteArray(capacity);
+		}
+		local->numBytes.store(local->numBytes.load(std::memory_order_relaxed) + buffers.size() * capacity, std::memory_order_relaxed);
+	}
+	ByteArray bytes(std::move(buffers.back()));
+	buffers.pop_back();
+	local->numBytes.store(local->numBytes.load(std::memory_order_relaxed) - capacity, std::memory_order_relaxed);
+	return bytes;
+}
+
+void BufferPool::free(ByteArray&& bytes)
+{
+	// 附加的内存不归池管理
+	size_t capacity = bytes.capacity();
+	if (bytes.readOnly() || !capacity)
+	{
+		return;
+	}
+	size_t index = classIndex(capacity);
+	if (index >= NUM_CLASSES || ((size_t)BUFFER_SIZE << index) != capacity)
+	{
+		return;
+	}
+	bytes.truncate();
+	LocalCache* local = localCache();
+	if (!local)
+	{
+		std::vector<ByteArray> buffers;
+		buffers.push_back(std::move(bytes));
+		putShared(index, buffers, 1);
+		return;
+	}
+	auto& buffers = local->buffers[index];
+	size_t numBytes = local->numBytes.load(std::memory_order_relaxed);
+	if ((buffers.size() + 1) * capacity > LOCAL_CLASS_BYTES)
+	{
+		// 本线程的缓存满了，把一半移到共享链表，供分配的线程取用
+		size_t count = std::max<size_t>(buffers.size() / 2, 1);
+		putShared(index, buffers, count);
+		numBytes -= count * capacity;
+	}
+	buffers.push_back(std::move(bytes));
+	local->numBytes.store(numBytes + capacity, std::memory_order_relaxed);
+}
+
+size_t BufferPool::pooledBytes() const
+{
+	size_t total = numSharedBytes.load(std::memory_order_relaxed);
+	for (auto& local : localCaches)
+	{
+		total += local.numBytes.load(std::memory_order_relaxed);
+	}
+	return total;
+}
@@ -3,11 +3,422 @@
 #include <spdlog/spdlog.h>
 #include "ws/network/ClientSocket.h"
 #include "ws/core/TimeTool.h"
+#ifdef __linux__
+#include <atomic>
+#include <unordered_map>
+#include "ws/network/SendQueue.h"
+#include "ws/network/SocketAddress.h"
+#include "ws/core/LockFreeQueue.h"
+#endif
 
 using namespace ws::network;
 
-static constexpr uint64_t CONNECT_CD = 3000ULL;
+#ifdef __linux__
+namespace ws
+{
+	namespace network
+	{
+		enum class ChannelState
+		{
+			IDLE,			//还未发起连接
+			CONNECTING,
+			CONNECTED,
+			CLOSED,
+		};
+
+		struct ClientChannel
+		{
+			~ClientChannel()
+			{
+				if (fd != -1)
+				{
+					::close(fd);
+				}
+			}
+
+			Socket						fd = -1;
+			std::atomic<ChannelState>	state = ChannelState::IDLE;
+
+			std::mutex					readerMtx;
+			ByteArray					received;		//I/O线程收到的数据，update时整块取走
+
+			std::mutex					writerMtx;
+			SendQueue					sending;
+			bool						isBlocked = false;	//发送缓冲区已满，等待EPOLLOUT
+
+			//发送队列中的数据，直到发完或缓冲区已满，调用者持有writerMtx
+			void flush()
+			{
+				iovec iov[MAX_SEND_IOV];
+				while (!sending.empty() && state == ChannelState::CONNECTED)
+				{
+					msghdr msg;
+					memset(&msg, 0, sizeof(msg));
+					msg.msg_iov = iov;
+					msg.msg_iovlen = sending.gather(iov, MAX_SEND_IOV);
+					ssize_t sentLength = sendmsg(fd, &msg, MSG_NOSIGNAL);
+					if (sentLength == -1)
+					{
+						if (errno == EWOULDBLOCK || errno == EAGAIN)
+						{
+							isBlocked = true;
+						}
+						else if (errno != EINTR)
+						{
+							state = ChannelState::CLOSED;
+						}
+						return;
+					}
+					sending.consume(sentLength);
+				}
+			}
+		};
+	}
+}
+
+namespace
+{
+	//所有ClientSocket共享的epoll线程，第一次连接时启动
+	class ClientReactor
+	{
+	public:
+		static ClientReactor& instance()
+		{
+			static ClientReactor reactor;
+			return reactor;
+		}
+
+		// main thread
+		void add(std::shared_ptr<ClientChannel> channel)
+		{
+			post([this, channel = std::move(channel)]()
+				{
+					epoll_event ev;
+					ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+					ev.data.ptr = channel.get();
+					if (epoll_ctl(epfd, EPOLL_CTL_ADD, channel->fd, &ev) == -1)
+					{
+						spdlog::error("add client socket to epoll error: {}", strerror(errno));
+						channel->state = ChannelState::CLOSED;
+						return;
+					}
+					channels[channel.get()] = channel;
+				});
+		}
+
+		// main thread, I/O线程释放后关闭socket
+		void remove(std::shared_ptr<ClientChannel> channel)
+		{
+			post([this, channel = std::move(channel)]()
+				{
+					channels.erase(channel.get());
+				});
+		}
+
+	private:
+		int					epfd = -1;
+		int					eventFd = -1;
+		std::thread			eventThread;
+		std::atomic_bool	isRunning = true;
+		std::atomic_bool	hasCommand = false;
+		MpscQueue<std::function<void()>>	commands;
+		std::unordered_map<ClientChannel*, std::shared_ptr<ClientChannel>>	channels;	//只在I/O线程访问
+
+		ClientReactor()
+		{
+			epfd = epoll_create1(EPOLL_CLOEXEC);
+			eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.ptr = nullptr;
+			epoll_ctl(epfd, EPOLL_CTL_ADD, eventFd, &ev);
+			eventThread = std::thread(&ClientReactor::processEventThread, this);
+		}
+
+		~ClientReactor()
+		{
+			isRunning = false;
+			wakeup();
+			eventThread.join();
+			commands.consume([](std::function<void()>&&) {});
+			channels.clear();
+			::close(eventFd);
+			::close(epfd);
+		}
 
+		void post(std::function<void()> command)
+		{
+			commands.push(std::move(command));
+			if (!hasCommand.exchange(true))
+			{
+				wakeup();
+			}
+		}
+
+		void wakeup()
+		{
+			const uint64_t value = 1;
+			write(eventFd, &value, sizeof(value));
+		}
+
+		void processEventThread()
+		{
+			epoll_event events[EPOLL_SIZE];
+			while (isRunning)
+			{
+				int eventCount = epoll_wait(epfd, events, EPOLL_SIZE, -1);
+				if (eventCount == -1 && errno != EINTR)
+				{
+					spdlog::error("client epoll wait error={}", strerror(errno));
+					return;
+				}
+				for (int i = 0; i < eventCount; ++i)
+				{
+					if (events[i].data.ptr)
+					{
+						onEvent(*(ClientChannel*)events[i].data.ptr, events[i].events);
+					}
+					else
+					{
+						uint64_t value;
+						read(eventFd, &value, sizeof(value));
+					}
+				}
+				// 本轮事件处理完后才移除，保证事件中的指针有效
+				hasCommand = false;
+				commands.consume([](std::function<void()>&& command) { command(); });
+			}
+		}
+
+		void onEvent(ClientChannel& channel, uint32_t events)
+		{
+			if (channel.state == ChannelState::CONNECTING)
+			{
+				// 非阻塞连接完成时可写，失败时同时有EPOLLERR
+				int error = 0;
+				socklen_t length = sizeof(error);
+				getsockopt(channel.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+				if (error || (events & (EPOLLERR | EPOLLHUP)))
+				{
+					channel.state = ChannelState::CLOSED;
+					return;
+				}
+				if (!(events & EPOLLOUT))
+				{
+					return;
+				}
+				channel.state = ChannelState::CONNECTED;
+			}
+			if (channel.state != ChannelState::CONNECTED)
+			{
+				return;
+			}
+			if (events & EPOLLIN)
+			{
+				char buffer[BUFFER_SIZE * 4];
+				while (true)
+				{
+					ssize_t length = recv(channel.fd, buffer, sizeof(buffer), 0);
+					if (length > 0)
+					{
+						std::lock_guard<std::mutex> lock(channel.readerMtx);
+						channel.received.writeData(buffer, length);
+						continue;
+					}
+					if (length == 0 || (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR))
+					{
+						channel.state = ChannelState::CLOSED;
+					}
+					break;
+				}
+			}
+			if ((events & EPOLLOUT) && channel.state == ChannelState::CONNECTED)
+			{
+				std::lock_guard<std::mutex> lock(channel.writerMtx);
+				channel.isBlocked = false;
+				channel.flush();
+			}
+			if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+			{
+				channel.state = ChannelState::CLOSED;
+			}
+		}
+	};
+}
+
+ClientSocket::ClientSocket() : channel(std::make_shared<ClientChannel>())
+{
+}
+
+ClientSocket::~ClientSocket()
+{
+	reset();
+}
+
+// main thread
+void ClientSocket::connect(const std::string& ip, uint16_t port)
+{
+	if (!onReceived)
+	{
+		spdlog::error("must implements onReceived!");
+		return;
+	}
+	switch (status)
+	{
+	case SocketStatus::DISCONNECTED:
+		_remoteIP = ip;
+		_remotePort = port;
+		status = lastStatus = SocketStatus::CONNECTING;
+		if ((uint64_t)TimeTool::getSystemTime() >= lastConnectTime + connectCooldown)
+		{
+			startConnect();
+		}
+		break;
+	case SocketStatus::CONNECTING:
+		spdlog::debug("socket is connecting, please wait...");
+		break;
+	case SocketStatus::CONNECTED:
+		spdlog::debug("socket is connected. you must disconnect before connect again.");
+		break;
+	}
+}
+
+// main thread, 发起非阻塞连接，由I/O线程等待完成
+void ClientSocket::startConnect()
+{
+	lastConnectTime = TimeTool::getSystemTime();
+	isConnectStarted = true;
+	sockaddr_storage addr;
+	socklen_t addrLength = 0;
+	if (!resolveAddress(_remoteIP, _remotePort, addr, addrLength))
+	{
+		channel->state = ChannelState::CLOSED;
+		return;
+	}
+	channel->fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (::connect(channel->fd, (sockaddr*)&addr, addrLength) == 0)
+	{
+		channel->state = ChannelState::CONNECTED;
+	}
+	else if (errno == EINPROGRESS)
+	{
+		channel->state = ChannelState::CONNECTING;
+	}
+	else
+	{
+		channel->state = ChannelState::CLOSED;
+		return;
+	}
+	ClientReactor::instance().add(channel);
+}
+
+// main thread
+void ClientSocket::update()
+{
+	if (status == SocketStatus::CONNECTING && !isConnectStarted
+		&& (uint64_t)TimeTool::getSystemTime() >= lastConnectTime + connectCooldown)
+	{
+		startConnect();
+	}
+	ChannelState state = isConnectStarted ? channel->state.load() : ChannelState::IDLE;
+	if (status == SocketStatus::CONNECTING && state == ChannelState::CONNECTED)
+	{
+		status = SocketStatus::CONNECTED;
+	}
+	if (lastStatus != status && status == SocketStatus::CONNECTED)
+	{
+		lastStatus = status;
+		if (onConnected)
+		{
+			onConnected();
+		}
+	}
+	if (status == SocketStatus::CONNECTED)
+	{
+		// 断开前收到的数据也先交给onReceived
+		{
+			std::lock_guard<std::mutex> lock(channel->readerMtx);
+			if (!readerBuffer.readAvailable())
+			{
+				readerBuffer.swap(channel->received);
+			}
+			else
+			{
+				readerBuffer.writeData(channel->received.readerPointer(), channel->received.readAvailable());
+			}
+			channel->received.truncate();
+		}
+		if (readerBuffer.readAvailable())
+		{
+			onReceived(readerBuffer);
+		}
+		readerBuffer.cutHead(readerBuffer.readPosition());
+		flush();
+	}
+	if (state == ChannelState::CLOSED && status != SocketStatus::DISCONNECTED)
+	{
+		status = SocketStatus::DISCONNECTED;
+	}
+	if (lastStatus != status && status == SocketStatus::DISCONNECTED)
+	{
+		lastStatus = status;
+		reset();
+		if (onClosed)
+		{
+			onClosed();
+		}
+	}
+}
+
+// main thread, 合并本次update的所有数据一次发出
+void ClientSocket::flush()
+{
+	std::lock_guard<std::mutex> lock(channel->writerMtx);
+	if (!channel->isBlocked)
+	{
+		channel->flush();
+	}
+}
+
+// main thread
+void ClientSocket::send(const ByteArray& packet)
+{
+	send(packet.readerPointer(), packet.readAvailable());
+}
+
+// main thread
+void ClientSocket::send(const void* data, size_t length)
+{
+	std::lock_guard<std::mutex> lock(channel->writerMtx);
+	channel->sending.push(data, length);
+}
+
+size_t ClientSocket::pendingBytes()
+{
+	std::lock_guard<std::mutex> lock(channel->writerMtx);
+	return channel->sending.size();
+}
+
+void ClientSocket::close()
+{
+	if (isConnected())
+	{
+		status = SocketStatus::DISCONNECTED;
+	}
+}
+
+void ClientSocket::reset()
+{
+	if (isConnectStarted)
+	{
+		ClientReactor::instance().remove(std::move(channel));
+		isConnectStarted = false;
+	}
+	channel = std::make_shared<ClientChannel>();
+	readerBuffer.truncate();
+}
+
+#else
 #ifdef _WIN32
 
 bool ClientSocket::initWinsock()
@@ -32,6 +443,10 @@ bool ClientSocket::initWinsock()
 
 #endif // WIN32
 
+ClientSocket::ClientSocket()
+{
+}
+
 ClientSocket::~ClientSocket()
 {
 	isExit = true;
@@ -53,7 +468,7 @@ void ClientSocket::workerProc()
 		case SocketStatus::CONNECTING:
 		{
 			uint64_t now = TimeTool::getSystemTime();
-			if (now < lastConnectTime + CONNECT_CD)
+			if (now < lastConnectTime + connectCooldown)
 			{
 				break;
 			}
@@ -226,6 +641,12 @@ void ClientSocket::send(const void* data, size_t length)
 	writerBuffer.writeData(data, length);
 }
 
+size_t ClientSocket::pendingBytes()
+{
+	std::lock_guard<std::mutex> lock(writerMtx);
+	return writerBuffer.readAvailable();
+}
+
 void ClientSocket::close()
 {
 	if (isConnected())
@@ -252,3 +673,4 @@ void ClientSocket::reset()
 	writerBuffer.truncate();
 	writerMtx.unlock();
 }
+#endif
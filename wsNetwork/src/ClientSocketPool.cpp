@@ -0,0 +1,159 @@
+#include <spdlog/spdlog.h>
+#include "ws/network/ClientSocketPool.h"
+#include "ws/core/Math.h"
+#include "ws/core/TimeTool.h"
+
+using namespace ws::network;
+using namespace ws::core;
+
+ClientSocketPool::ClientSocketPool(const ClientPoolConfig& cfg) : config(cfg)
+{
+	config.connectionsPerUpstream = std::max<size_t>(config.connectionsPerUpstream, 1);
+	config.maxReconnectDelay = std::max(config.maxReconnectDelay, config.minReconnectDelay);
+}
+
+// main thread
+size_t ClientSocketPool::addUpstream(const std::string& ip, uint16_t port)
+{
+	size_t index = upstreams.size();
+	auto& upstream = upstreams.emplace_back();
+	upstream.ip = ip;
+	upstream.port = port;
+	upstream.connections.resize(config.connectionsPerUpstream);
+	for (size_t i = 0; i < upstream.connections.size(); ++i)
+	{
+		initConnection(index, i);
+	}
+	return index;
+}
+
+// main thread
+void ClientSocketPool::initConnection(size_t upstream, size_t index)
+{
+	auto& connection = upstreams[upstream].connections[index];
+	connection.socket = std::make_unique<ClientSocket>();
+	ClientSocket& socket = *connection.socket;
+	//重连间隔由连接池控制
+	socket.setConnectCooldown(0);
+	socket.onConnected = [this, upstream, index]()
+		{
+			auto& connection = upstreams[upstream].connections[index];
+			connection.failures = 0;
+			if (onConnected)
+			{
+				onConnected(upstream, *connection.socket);
+			}
+		};
+	socket.onClosed = [this, upstream, index]()
+		{
+			auto& connection = upstreams[upstream].connections[index];
+			uint64_t delay = getReconnectDelay(++connection.failures);
+			connection.nextConnectTime = (uint64_t)TimeTool::getSystemTime() + delay;
+			spdlog::debug("upstream {}:{} connection {} closed, reconnect after {}ms",
+				upstreams[upstream].ip, upstreams[upstream].port, index, delay);
+			if (onClosed)
+			{
+				onClosed(upstream, *connection.socket);
+			}
+		};
+	socket.onReceived = [this, upstream, &socket](ByteArray& bytes)
+		{
+			if (onReceived)
+			{
+				onReceived(upstream, socket, bytes);
+			}
+		};
+	socket.connect(upstreams[upstream].ip, upstreams[upstream].port);
+}
+
+// 第n次失败后等待minReconnectDelay * 2^(n-1)，加入随机抖动
+uint64_t ClientSocketPool::getReconnectDelay(uint32_t failures) const
+{
+	uint64_t delay = config.maxReconnectDelay;
+	if (failures <= 32 && (config.minReconnectDelay << (failures - 1)) < config.maxReconnectDelay)
+	{
+		delay = config.minReconnectDelay << (failures - 1);
+	}
+	return delay - Math::random((uint32_t)(delay / 2 + 1));
+}
+
+// main thread
+void ClientSocketPool::update()
+{
+	uint64_t now = TimeTool::getSystemTime();
+	for (auto& upstream : upstreams)
+	{
+		for (auto& connection : upstream.connections)
+		{
+			if (connection.nextConnectTime && now >= connection.nextConnectTime)
+			{
+				connection.nextConnectTime = 0;
+				connection.socket->connect(upstream.ip, upstream.port);
+			}
+			connection.socket->update();
+		}
+	}
+}
+
+// main thread
+ClientSocket* ClientSocketPool::select(size_t upstream)
+{
+	if (upstream >= upstreams.size())
+	{
+		return nullptr;
+	}
+	auto& connections = upstreams[upstream].connections;
+	if (config.policy == BalancePolicy::ROUND_ROBIN)
+	{
+		size_t& nextIndex = upstreams[upstream].nextIndex;
+		for (size_t i = 0; i < connections.size(); ++i)
+		{
+			ClientSocket* socket = connections[nextIndex].socket.get();
+			nextIndex = (nextIndex + 1) % connections.size();
+			if (socket->isConnected())
+			{
+				return socket;
+			}
+		}
+		return nullptr;
+	}
+
+	ClientSocket* selected = nullptr;
+	size_t minPending = SIZE_MAX;
+	for (auto& connection : connections)
+	{
+		if (!connection.socket->isConnected())
+		{
+			continue;
+		}
+		size_t pending = connection.socket->pendingBytes();
+		if (pending < minPending)
+		{
+			minPending = pending;
+			selected = connection.socket.get();
+		}
+	}
+	return selected;
+}
+
+// main thread
+ClientSocket* ClientSocketPool::send(size_t upstream, const void* data, size_t length)
+{
+	ClientSocket* socket = select(upstream);
+	if (socket)
+	{
+		socket->send(data, length);
+	}
+	return socket;
+}
+
+size_t ClientSocketPool::numConnected(size_t upstream) const
+{
+	if (upstream >= upstreams.size())
+	{
+		return 0;
+	}
+	auto& connections = upstreams[upstream].connections;
+	return std::count_if(connections.begin(), connections.end(),
+		[](const Connection& connection) { return connection.socket->isConnected(); });
+}
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include "ws/network/FrameDecoder.h"
+
+using namespace ws::network;
+
+bool FrameDecoder::init(const FrameConfig& cfg)
+{
+	switch (cfg.mode)
+	{
+	case FrameMode::LENGTH_PREFIX:
+		if ((cfg.lengthBytes != 1 && cfg.lengthBytes != 2 && cfg.lengthBytes != 4)
+			|| cfg.lengthOffset + cfg.lengthBytes > cfg.headerSize)
+		{
+			spdlog::error("invalid length prefix: offset={}, bytes={}, header={}", cfg.lengthOffset, cfg.lengthBytes, cfg.headerSize);
+			return false;
+		}
+		break;
+	case FrameMode::DELIMITER:
+		if (cfg.delimiter.empty())
+		{
+			spdlog::error("frame delimiter is empty");
+			return false;
+		}
+		break;
+	case FrameMode::CUSTOM:
+		if (!cfg.decode)
+		{
+			spdlog::error("custom frame decode function must be set");
+			return false;
+		}
+		break;
+	default:
+		break;
+	}
+	config = cfg;
+	return true;
+}
+
+FrameResult FrameDecoder::next(std::span<const uint8_t> data, size_t& scanned,
+	std::span<const uint8_t>& frame, size_t& consumed) const
+{
+	switch (config.mode)
+	{
+	case FrameMode::LENGTH_PREFIX:
+	{
+		if (data.size() < config.headerSize)
+		{
+			return FrameResult::INCOMPLETE;
+		}
+		uint64_t length = 0;
+		for (uint8_t i = 0; i < config.lengthBytes; ++i)
+		{
+			uint8_t byte = data[config.lengthOffset + (config.lengthBigEndian ? i : config.lengthBytes - 1 - i)];
+			length = (length << 8) | byte;
+		}
+		uint64_t frameSize = config.lengthIncludesHeader ? length : length + config.headerSize;
+		if (frameSize < config.headerSize || frameSize > config.maxFrameSize)
+		{
+			return FrameResult::INVALID;
+		}
+		if (data.size() < frameSize)
+		{
+			return FrameResult::INCOMPLETE;
+		}
+		frame = data.first(frameSize);
+		consumed = frameSize;
+		return FrameResult::COMPLETE;
+	}
+
+	case FrameMode::DELIMITER:
+	{
+		//按无符号字节比较，否则高位字节的分隔符永远匹配不到
+		std::span<const uint8_t> delimiter((const uint8_t*)config.delimiter.data(), config.delimiter.size());
+		// 分隔符可能跨越上次查找的末尾，回退delimiter.size() - 1
+		size_t start = scanned >= delimiter.size() ? scanned - delimiter.size() + 1 : 0;
+		auto iter = std::search(data.begin() + std::min(start, data.size()), data.end(), delimiter.begin(), delimiter.end());
+		if (iter == data.end())
+		{
+			if (data.size() > config.maxFrameSize)
+			{
+				return FrameResult::INVALID;
+			}
+			scanned = data.size();
+			return FrameResult::INCOMPLETE;
+		}
+		size_t frameSize = iter - data.begin();
+		if (frameSize > config.maxFrameSize)
+		{
+			return FrameResult::INVALID;
+		}
+		frame = data.first(frameSize);
+		consumed = frameSize + delimiter.size();
+		scanned = 0;
+		return FrameResult::COMPLETE;
+	}
+
+	case FrameMode::CUSTOM:
+	{
+		int64_t frameSize = config.decode(data);
+		if (frameSize < 0 || (uint64_t)frameSize > config.maxFrameSize || (uint64_t)frameSize > data.size())
+		{
+			return FrameResult::INVALID;
+		}
+		if (!frameSize)
+		{
+			// 和其他模式一样，已缓存超过maxFrameSize仍不完整视为非法
+			return data.size() > config.maxFrameSize ? FrameResult::INVALID : FrameResult::INCOMPLETE;
+		}
+		frame = data.first(frameSize);
+		consumed = frameSize;
+		return FrameResult::COMPLETE;
+	}
+
+	default:
+		return FrameResult::INVALID;
+	}
+}
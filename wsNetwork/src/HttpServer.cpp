@@ -0,0 +1,431 @@
+#include <string.h>
+#include <algorithm>
+#include <charconv>
+#include <spdlog/spdlog.h>
+#include "ws/core/String.h"
+#include "ws/network/HttpServer.h"
+
+using namespace ws::network;
+using namespace ws::core;
+using String::iequals;
+using String::trim;
+
+namespace
+{
+	// 取出到separator为止的一段，并从str中移除
+	std::string_view nextToken(std::string_view& str, std::string_view separator)
+	{
+		size_t pos = str.find(separator);
+		std::string_view token = str.substr(0, pos);
+		str.remove_prefix(pos == std::string_view::npos ? str.size() : pos + separator.size());
+		return token;
+	}
+
+	const char* reasonPhrase(int status)
+	{
+		switch (status)
+		{
+		case 200: return "OK";
+		case 201: return "Created";
+		case 204: return "No Content";
+		case 301: return "Moved Permanently";
+		case 302: return "Found";
+		case 304: return "Not Modified";
+		case 400: return "Bad Request";
+		case 401: return "Unauthorized";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 413: return "Payload Too Large";
+		case 431: return "Request Header Fields Too Large";
+		case 500: return "Internal Server Error";
+		case 501: return "Not Implemented";
+		case 503: return "Service Unavailable";
+		default: return "Unknown";
+		}
+	}
+}
+
+namespace ws
+{
+	namespace network
+	{
+		//每个连接的解析状态，请求在update线程中解析和处理
+		class HttpConnection : public Client
+		{
+		public:
+			HttpConnection(const HttpServer& server) : httpServer(server) {}
+
+		protected:
+			void					onRecv() override;
+
+		private:
+			const HttpServer&		httpServer;
+			HttpServerRequest		request;
+			HttpServerResponse		response;
+			std::string				head;			//复用的状态行和头部
+			size_t					scanned = 0;	//已查找过头部结尾的长度
+			bool					isClosed = false;
+
+			//解析一个完整的请求，数据不足返回0，出错时设置错误码并返回-1
+			int64_t					parseRequest(std::string_view data, int& errorStatus, bool& keepAlive);
+			void					sendResponse(bool keepAlive, bool hasBody);
+			void					sendError(int status);
+		};
+	}
+}
+
+//===================== HttpServerRequest Implements ========================
+std::string_view HttpServerRequest::getHeader(std::string_view name) const
+{
+	for (auto& [key, value] : headers)
+	{
+		if (iequals(key, name))
+		{
+			return value;
+		}
+	}
+	return {};
+}
+
+std::string_view HttpServerRequest::getQuery(std::string_view key) const
+{
+	std::string_view rest = query;
+	while (!rest.empty())
+	{
+		std::string_view value = nextToken(rest, "&");
+		std::string_view name = nextToken(value, "=");
+		if (name == key)
+		{
+			return value;
+		}
+	}
+	return {};
+}
+
+//===================== HttpServerResponse Implements ========================
+void HttpServerResponse::setStatus(int code)
+{
+	status = code;
+}
+
+void HttpServerResponse::setHeader(std::string_view name, std::string_view value)
+{
+	headers.append(name).append(": ").append(value).append("\r\n");
+}
+
+void HttpServerResponse::write(std::string_view data)
+{
+	if (data.empty())
+	{
+		return;
+	}
+	// 连续复制的数据合并为一块
+	if (!chunks.empty() && !chunks.back().packet && chunks.back().offset + chunks.back().length == copied.size())
+	{
+		chunks.back().length += data.size();
+	}
+	else
+	{
+		chunks.push_back({ nullptr, copied.size(), data.size() });
+	}
+	copied.append(data);
+	bodySize += data.size();
+}
+
+void HttpServerResponse::write(PacketPtr packet)
+{
+	if (packet && packet->size())
+	{
+		bodySize += packet->size();
+		chunks.push_back({ std::move(packet), 0, 0 });
+	}
+}
+
+void HttpServerResponse::reset()
+{
+	status = 200;
+	headers.clear();
+	copied.clear();
+	chunks.clear();
+	bodySize = 0;
+}
+
+//===================== HttpConnection Implements ========================
+// main thread
+void HttpConnection::onRecv()
+{
+	// 管线化的请求按顺序处理，响应按顺序进入发送队列
+	while (!isClosed && readerBuffer.readAvailable())
+	{
+		std::string_view data((const char*)readerBuffer.readerPointer(), readerBuffer.readAvailable());
+		int errorStatus = 0;
+		bool keepAlive = true;
+		int64_t length = parseRequest(data, errorStatus, keepAlive);
+		if (length < 0)
+		{
+			sendError(errorStatus);
+			break;
+		}
+		if (length == 0)
+		{
+			break;
+		}
+		response.reset();
+		bool isHead = request.method == "HEAD";
+		httpServer.dispatch(request, response);
+		sendResponse(keepAlive, !isHead);
+		readerBuffer.seek((int)length);
+		scanned = 0;
+		if (!keepAlive)
+		{
+			isClosed = true;
+			kick();
+		}
+	}
+	if (isClosed)
+	{
+		readerBuffer.truncate();
+	}
+	else if (readerBuffer.readPosition() && readerBuffer.readAvailable())
+	{
+		// 未完成的请求移到缓冲区头部
+		readerBuffer.cutHead(readerBuffer.readPosition());
+	}
+}
+
+// main thread
+int64_t HttpConnection::parseRequest(std::string_view data, int& errorStatus, bool& keepAlive)
+{
+	const auto& config = httpServer.getHttpConfig();
+	// 从上次查找的位置继续，避免头部分多次到达时重复扫描
+	size_t headerEnd = data.find("\r\n\r\n", scanned >= 3 ? scanned - 3 : 0);
+	if (headerEnd == std::string_view::npos)
+	{
+		scanned = data.size();
+		if (data.size() > config.maxHeaderSize)
+		{
+			errorStatus = 431;
+			return -1;
+		}
+		return 0;
+	}
+	if (headerEnd + 4 > config.maxHeaderSize)
+	{
+		errorStatus = 431;
+		return -1;
+	}
+	scanned = headerEnd;
+	std::string_view header = data.substr(0, headerEnd + 2);
+
+	std::string_view requestLine = nextToken(header, "\r\n");
+	request.method = nextToken(requestLine, " ");
+	std::string_view target = nextToken(requestLine, " ");
+	request.version = requestLine;
+	if (request.method.empty() || target.empty() || !request.version.starts_with("HTTP/1."))
+	{
+		errorStatus = 400;
+		return -1;
+	}
+	request.path = nextToken(target, "?");
+	request.query = target;
+
+	// HTTP/1.1默认保持连接，HTTP/1.0默认关闭
+	keepAlive = request.version != "HTTP/1.0";
+	size_t contentLength = 0;
+	bool hasContentLength = false;
+	request.headers.clear();
+	while (!header.empty())
+	{
+		std::string_view line = nextToken(header, "\r\n");
+		size_t colon = line.find(':');
+		if (colon == std::string_view::npos || colon == 0)
+		{
+			errorStatus = 400;
+			return -1;
+		}
+		std::string_view name = line.substr(0, colon);
+		std::string_view value = trim(line.substr(colon + 1));
+		request.headers.emplace_back(name, value);
+		if (iequals(name, "Content-Length"))
+		{
+			// RFC 9112 6.3，多个取值不同的Content-Length无法确定消息边界，拒绝以防请求走私
+			size_t length = 0;
+			auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+			if (ec != std::errc() || ptr != value.data() + value.size() || (hasContentLength && length != contentLength))
+			{
+				errorStatus = 400;
+				return -1;
+			}
+			contentLength = length;
+			hasContentLength = true;
+		}
+		else if (iequals(name, "Transfer-Encoding"))
+		{
+			errorStatus = 501;
+			return -1;
+		}
+		else if (iequals(name, "Connection"))
+		{
+			if (iequals(value, "close"))
+			{
+				keepAlive = false;
+			}
+			else if (iequals(value, "keep-alive"))
+			{
+				keepAlive = true;
+			}
+		}
+	}
+	if (contentLength > config.maxBodySize)
+	{
+		errorStatus = 413;
+		return -1;
+	}
+	size_t totalLength = headerEnd + 4 + contentLength;
+	if (data.size() < totalLength)
+	{
+		return 0;
+	}
+	request.body = data.substr(headerEnd + 4, contentLength);
+	request.client = this;
+	return (int64_t)totalLength;
+}
+
+// main thread
+void HttpConnection::sendResponse(bool keepAlive, bool hasBody)
+{
+	head.clear();
+	fmt::format_to(std::back_inserter(head), "HTTP/1.1 {} {}\r\n", response.status, reasonPhrase(response.status));
+	head.append(response.headers);
+	fmt::format_to(std::back_inserter(head), "Content-Length: {}\r\n", response.bodySize);
+	if (!keepAlive)
+	{
+		head.append("Connection: close\r\n");
+	}
+	head.append("\r\n");
+	// 头部和复制的小块数据合并到发送队列的同一块中，共享的数据包单独引用
+	send(head.data(), head.size());
+	if (!hasBody)
+	{
+		return;
+	}
+	for (auto& chunk : response.chunks)
+	{
+		if (chunk.packet)
+		{
+			send(chunk.packet);
+		}
+		else
+		{
+			send(response.copied.data() + chunk.offset, chunk.length);
+		}
+	}
+}
+
+// main thread
+void HttpConnection::sendError(int status)
+{
+	spdlog::debug("http client {} error {}", id, status);
+	response.reset();
+	response.setStatus(status);
+	sendResponse(false, true);
+	isClosed = true;
+	kick();
+}
+
+//===================== HttpServer Implements ========================
+bool HttpServer::init(const ServerConfig& cfg)
+{
+	return init(cfg, HttpConfig());
+}
+
+bool HttpServer::init(const ServerConfig& cfg, const HttpConfig& httpCfg)
+{
+	httpConfig = httpCfg;
+	ServerConfig config = cfg;
+	config.frame = FrameConfig();
+	// 管线化的响应分多次发出，不能被Nagle算法延迟
+	config.tcpNoDelay = true;
+	config.createClient = [this]() { return std::make_shared<HttpConnection>(*this); };
+	return ServerSocket::init(config);
+}
+
+void HttpServer::route(std::string_view method, std::string_view path, Handler handler)
+{
+	MethodHandlers* handlers = nullptr;
+	if (path.ends_with('*'))
+	{
+		path.remove_suffix(1);
+		auto iter = std::find_if(prefixRoutes.begin(), prefixRoutes.end(), [path](auto& item) { return item.first == path; });
+		if (iter == prefixRoutes.end())
+		{
+			// 保持从长到短，匹配时第一个即为最长前缀
+			iter = std::find_if(prefixRoutes.begin(), prefixRoutes.end(), [path](auto& item) { return item.first.size() < path.size(); });
+			iter = prefixRoutes.emplace(iter, std::string(path), MethodHandlers());
+		}
+		handlers = &iter->second;
+	}
+	else
+	{
+		handlers = &exactRoutes[std::string(path)];
+	}
+	auto iter = std::find_if(handlers->begin(), handlers->end(), [method](auto& item) { return item.first == method; });
+	if (iter != handlers->end())
+	{
+		iter->second = std::move(handler);
+	}
+	else
+	{
+		handlers->emplace_back(std::string(method), std::move(handler));
+	}
+}
+
+// main thread
+void HttpServer::dispatch(const HttpServerRequest& request, HttpServerResponse& response) const
+{
+	const MethodHandlers* handlers = nullptr;
+	auto iter = exactRoutes.find(request.path);
+	if (iter != exactRoutes.end())
+	{
+		handlers = &iter->second;
+	}
+	else
+	{
+		for (auto& [prefix, prefixHandlers] : prefixRoutes)
+		{
+			if (request.path.starts_with(prefix))
+			{
+				handlers = &prefixHandlers;
+				break;
+			}
+		}
+	}
+	if (!handlers)
+	{
+		response.setStatus(404);
+		return;
+	}
+	std::string_view method = request.method == "HEAD" ? std::string_view("GET") : request.method;
+	auto handler = std::find_if(handlers->begin(), handlers->end(),
+		[method, &request](auto& item) { return item.first == method || item.first == request.method; });
+	if (handler == handlers->end())
+	{
+		// RFC 9110 15.5.6，405必须带Allow列出该路径支持的方法，GET隐含支持HEAD
+		bool hasHead = std::any_of(handlers->begin(), handlers->end(), [](auto& item) { return item.first == "HEAD"; });
+		std::string allow;
+		for (auto& [name, _] : *handlers)
+		{
+			allow += allow.empty() ? "" : ", ";
+			allow += name;
+			if (name == "GET" && !hasHead)
+			{
+				allow += ", HEAD";
+			}
+		}
+		response.setStatus(405);
+		response.setHeader("Allow", allow);
+		return;
+	}
+	handler->second(request, response);
+}
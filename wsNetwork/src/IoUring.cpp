@@ -0,0 +1,305 @@
+#ifdef __linux__
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <vector>
+#include <spdlog/spdlog.h>
+#include "ws/network/IoUring.h"
+
+using namespace ws::network;
+
+static int sys_io_uring_setup(uint32_t entries, io_uring_params* params)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+IoUring::~IoUring()
+{
+	if (sqes)
+	{
+		munmap(sqes, sqesSize);
+	}
+	if (cqRing && cqRing != sqRing)
+	{
+		munmap(cqRing, cqRingSize);
+	}
+	if (sqRing)
+	{
+		munmap(sqRing, sqRingSize);
+	}
+	if (ringFd >= 0)
+	{
+		close(ringFd);
+	}
+}
+
+static int sys_io_uring_register(int fd, uint32_t opcode, void* arg, uint32_t nrArgs)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+namespace
+{
+	// 服务器依赖的操作，任何一个不支持都只能退回epoll
+	constexpr uint8_t REQUIRED_OPCODES[] = {
+		IORING_OP_ACCEPT,
+		IORING_OP_RECV,
+		IORING_OP_SENDMSG,
+		IORING_OP_READ,
+		IORING_OP_PROVIDE_BUFFERS,
+		IORING_OP_ASYNC_CANCEL,
+	};
+	constexpr uint64_t PROBE_ACCEPT = 1;
+	constexpr uint64_t PROBE_PROVIDE = 2;
+	constexpr uint64_t PROBE_RECV = 3;
+	constexpr uint16_t PROBE_BUFFER_GROUP = 0;
+	constexpr uint32_t PROBE_BUFFER_SIZE = 64;
+
+	struct ProbeSockets
+	{
+		int listenFd = -1;
+		int clientFd = -1;
+		int acceptedFd = -1;
+		~ProbeSockets()
+		{
+			for (int fd : { listenFd, clientFd, acceptedFd })
+			{
+				if (fd >= 0)
+				{
+					close(fd);
+				}
+			}
+		}
+	};
+}
+
+bool IoUring::isSupported()
+{
+	// 只检查io_uring_setup不够：多次触发的accept需要5.19，多次触发的recv需要6.0，
+	// 这里先用IORING_REGISTER_PROBE检查操作码，再在回环地址上实际执行一次
+	IoUring ring;
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	ring.ringFd = sys_io_uring_setup(8, &params);
+	if (ring.ringFd < 0 || !ring.mapRings(params))
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> probeData(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+	auto probe = (io_uring_probe*)probeData.data();
+	if (sys_io_uring_register(ring.ringFd, IORING_REGISTER_PROBE, probe, 256) < 0)
+	{
+		return false;
+	}
+	for (uint8_t opcode : REQUIRED_OPCODES)
+	{
+		if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED))
+		{
+			return false;
+		}
+	}
+
+	ProbeSockets sockets;
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addrlen = sizeof(addr);
+	sockets.listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sockets.listenFd < 0
+		|| bind(sockets.listenFd, (sockaddr*)&addr, sizeof(addr)) < 0
+		|| listen(sockets.listenFd, 1) < 0
+		|| getsockname(sockets.listenFd, (sockaddr*)&addr, &addrlen) < 0)
+	{
+		return false;
+	}
+	// 先连接并写入数据，保证后面的等待都能立即完成
+	sockets.clientFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (sockets.clientFd < 0
+		|| connect(sockets.clientFd, (sockaddr*)&addr, sizeof(addr)) < 0
+		|| write(sockets.clientFd, "p", 1) != 1)
+	{
+		return false;
+	}
+
+	// 收割直到拿到指定请求的完成事件
+	auto waitCqe = [&ring](uint64_t userData, io_uring_cqe& result)
+		{
+			bool found = false;
+			while (!found)
+			{
+				if (ring.submit(1) < 0 && errno != EINTR)
+				{
+					return false;
+				}
+				ring.forEachCqe([&](const io_uring_cqe& cqe)
+					{
+						if (!found && cqe.user_data == userData)
+						{
+							result = cqe;
+							found = true;
+						}
+					});
+			}
+			return true;
+		};
+
+	io_uring_cqe cqe;
+	io_uring_sqe* sqe = ring.getSqe();
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = sockets.listenFd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->user_data = PROBE_ACCEPT;
+	if (!waitCqe(PROBE_ACCEPT, cqe) || cqe.res < 0 || !(cqe.flags & IORING_CQE_F_MORE))
+	{
+		return false;
+	}
+	sockets.acceptedFd = cqe.res;
+
+	uint8_t buffer[PROBE_BUFFER_SIZE];
+	sqe = ring.getSqe();
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = 1;
+	sqe->addr = (uint64_t)(uintptr_t)buffer;
+	sqe->len = PROBE_BUFFER_SIZE;
+	sqe->buf_group = PROBE_BUFFER_GROUP;
+	sqe->user_data = PROBE_PROVIDE;
+	if (!waitCqe(PROBE_PROVIDE, cqe) || cqe.res < 0)
+	{
+		return false;
+	}
+
+	sqe = ring.getSqe();
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = sockets.acceptedFd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = PROBE_BUFFER_GROUP;
+	sqe->user_data = PROBE_RECV;
+	if (!waitCqe(PROBE_RECV, cqe) || cqe.res <= 0 || !(cqe.flags & IORING_CQE_F_BUFFER))
+	{
+		return false;
+	}
+	// 关闭队列时内核会取消仍在等待的多次触发请求
+	return true;
+}
+
+bool IoUring::init(uint32_t entries)
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	ringFd = sys_io_uring_setup(entries, &params);
+	if (ringFd < 0)
+	{
+		spdlog::error("io_uring_setup error: {}", strerror(errno));
+		return false;
+	}
+	return mapRings(params);
+}
+
+bool IoUring::mapRings(const io_uring_params& params)
+{
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+	if (singleMmap && cqRingSize > sqRingSize)
+	{
+		sqRingSize = cqRingSize;
+	}
+	sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	if (sqRing == MAP_FAILED)
+	{
+		sqRing = nullptr;
+		spdlog::error("io_uring mmap sq ring error: {}", strerror(errno));
+		return false;
+	}
+	if (singleMmap)
+	{
+		cqRing = sqRing;
+	}
+	else
+	{
+		cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+		if (cqRing == MAP_FAILED)
+		{
+			cqRing = nullptr;
+			spdlog::error("io_uring mmap cq ring error: {}", strerror(errno));
+			return false;
+		}
+	}
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	sqes = (io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+	{
+		sqes = nullptr;
+		spdlog::error("io_uring mmap sqes error: {}", strerror(errno));
+		return false;
+	}
+
+	auto sqBase = (uint8_t*)sqRing;
+	sqHead = (uint32_t*)(sqBase + params.sq_off.head);
+	sqTail = (uint32_t*)(sqBase + params.sq_off.tail);
+	sqMask = (uint32_t*)(sqBase + params.sq_off.ring_mask);
+	sqArray = (uint32_t*)(sqBase + params.sq_off.array);
+	sqEntries = params.sq_entries;
+	sqeTail = *sqTail;
+	// 提交项与数组下标一一对应
+	for (uint32_t i = 0; i < sqEntries; ++i)
+	{
+		sqArray[i] = i;
+	}
+
+	auto cqBase = (uint8_t*)cqRing;
+	cqHead = (uint32_t*)(cqBase + params.cq_off.head);
+	cqTail = (uint32_t*)(cqBase + params.cq_off.tail);
+	cqMask = (uint32_t*)(cqBase + params.cq_off.ring_mask);
+	cqes = (io_uring_cqe*)(cqBase + params.cq_off.cqes);
+	return true;
+}
+
+io_uring_sqe* IoUring::getSqe()
+{
+	uint32_t head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+	if (sqeTail - head >= sqEntries)
+	{
+		submit();
+		head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+		if (sqeTail - head >= sqEntries)
+		{
+			return nullptr;
+		}
+	}
+	io_uring_sqe* sqe = &sqes[sqeTail & *sqMask];
+	++sqeTail;
+	memset(sqe, 0, sizeof(io_uring_sqe));
+	return sqe;
+}
+
+int IoUring::submit(uint32_t waitNr /*= 0*/)
+{
+	uint32_t toSubmit = sqeTail - *sqTail;
+	__atomic_store_n(sqTail, sqeTail, __ATOMIC_RELEASE);
+	if (!toSubmit && !waitNr)
+	{
+		return 0;
+	}
+	int result = sys_io_uring_enter(ringFd, toSubmit, waitNr, waitNr ? IORING_ENTER_GETEVENTS : 0);
+	enterCount.fetch_add(1, std::memory_order_relaxed);
+	if (result < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+	{
+		spdlog::error("io_uring_enter error: {}", strerror(errno));
+	}
+	return result;
+}
+#endif
@@ -0,0 +1,485 @@
+#include <algorithm>
+#include <cstdlib>
+#include <spdlog/spdlog.h>
+#include "ws/network/KcpSession.h"
+
+using namespace ws::network;
+using namespace ws::core;
+
+namespace
+{
+	enum KcpCommand : uint8_t
+	{
+		KCP_PUSH = 81,		//数据
+		KCP_ACK = 82,		//确认
+		KCP_WASK = 83,		//询问窗口
+		KCP_WINS = 84,		//告知窗口
+	};
+
+	// cmd(1) frg(1) wnd(2) len(2) ts(4) sn(4) una(4)，小端
+	constexpr uint32_t HEADER_SIZE = 18;
+	constexpr uint32_t DEFAULT_RTO = 200;
+	constexpr uint32_t MAX_RTO = 60000;
+	constexpr uint32_t NODELAY_MIN_RTO = 30;
+	constexpr uint32_t NORMAL_MIN_RTO = 100;
+	constexpr uint32_t PROBE_INIT = 7000;
+	constexpr uint32_t PROBE_LIMIT = 120000;
+	constexpr uint32_t THRESH_MIN = 2;
+
+	// 序号和时间都会回绕，比较差值
+	inline int32_t timeDiff(uint32_t later, uint32_t earlier)
+	{
+		return (int32_t)(later - earlier);
+	}
+
+	inline void encode16(uint8_t*& p, uint16_t value)
+	{
+		p[0] = (uint8_t)value;
+		p[1] = (uint8_t)(value >> 8);
+		p += 2;
+	}
+
+	inline void encode32(uint8_t*& p, uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			p[i] = (uint8_t)(value >> (i * 8));
+		}
+		p += 4;
+	}
+
+	inline uint16_t decode16(const uint8_t*& p)
+	{
+		uint16_t value = (uint16_t)(p[0] | (p[1] << 8));
+		p += 2;
+		return value;
+	}
+
+	inline uint32_t decode32(const uint8_t*& p)
+	{
+		uint32_t value = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+		p += 4;
+		return value;
+	}
+}
+
+KcpSession::KcpSession(const KcpConfig& cfg /*= KcpConfig()*/) : config(cfg)
+{
+	if (config.mtu <= HEADER_SIZE * 2)
+	{
+		config.mtu = KcpConfig().mtu;
+	}
+	config.interval = std::clamp(config.interval, 1u, 5000u);
+	config.sendWindow = std::max(config.sendWindow, 1u);
+	config.recvWindow = std::max(config.recvWindow, 1u);
+	mss = config.mtu - HEADER_SIZE;
+	rto = DEFAULT_RTO;
+	minRto = config.nodelay ? NODELAY_MIN_RTO : NORMAL_MIN_RTO;
+	remoteWindow = config.recvWindow;
+	incr = mss;
+}
+
+// main thread
+void KcpSession::send(const void* data, size_t length)
+{
+	if (isKicked)
+	{
+		return;
+	}
+	// 对方长时间不确认时发送队列会无限增长，超过上限视为对方已失效
+	size_t numSegments = (length + mss - 1) / mss;
+	if (config.maxSendQueue && sendQueue.size() + numSegments > config.maxSendQueue)
+	{
+		spdlog::warn("kcp session {} send queue exceeds {} segments, kicked", id, config.maxSendQueue);
+		isKicked = true;
+		sendQueue.clear();
+		kick();
+		return;
+	}
+	// 按mss分片，接收方按序拼接为字节流
+	auto bytes = (const uint8_t*)data;
+	while (length)
+	{
+		size_t size = std::min(length, (size_t)mss);
+		auto& segment = sendQueue.emplace_back();
+		segment.data.assign(bytes, bytes + size);
+		bytes += size;
+		length -= size;
+	}
+}
+
+// main thread
+void KcpSession::send(const ByteArray& packet)
+{
+	send(packet.data(), packet.size());
+}
+
+// main thread
+void KcpSession::send(ByteArray&& packet)
+{
+	send(packet.data(), packet.size());
+}
+
+// main thread
+void KcpSession::send(PacketPtr packet)
+{
+	if (packet)
+	{
+		send(packet->data(), packet->size());
+	}
+}
+
+size_t KcpSession::pendingSendBytes() const
+{
+	size_t total = 0;
+	for (auto& segment : sendQueue)
+	{
+		total += segment.data.size();
+	}
+	for (auto& segment : sendBuffer)
+	{
+		total += segment.data.size();
+	}
+	return total;
+}
+
+// main thread
+void KcpSession::onPacket(std::span<const uint8_t> datagram)
+{
+	current = (uint32_t)lastActiveTime;
+	uint32_t prevUna = sendUna;
+	uint32_t maxAck = 0;
+	bool hasAck = false;
+	const uint8_t* p = datagram.data();
+	size_t remain = datagram.size();
+	// 一个数据报可能包含多个分片
+	while (remain >= HEADER_SIZE)
+	{
+		uint8_t command = p[0];
+		p += 2;
+		uint16_t window = decode16(p);
+		uint16_t length = decode16(p);
+		uint32_t ts = decode32(p);
+		uint32_t sn = decode32(p);
+		uint32_t una = decode32(p);
+		remain -= HEADER_SIZE;
+		if (length > remain || command < KCP_PUSH || command > KCP_WINS)
+		{
+			break;
+		}
+		remoteWindow = window;
+		parseUna(una);
+		switch (command)
+		{
+		case KCP_ACK:
+			if (timeDiff(current, ts) >= 0)
+			{
+				updateRtt(timeDiff(current, ts));
+			}
+			parseAck(sn);
+			if (!hasAck || timeDiff(sn, maxAck) > 0)
+			{
+				maxAck = sn;
+				hasAck = true;
+			}
+			break;
+
+		case KCP_PUSH:
+			// 窗口外的分片直接丢弃，等待对方重传
+			if (timeDiff(sn, recvNext + config.recvWindow) < 0)
+			{
+				ackList.emplace_back(sn, ts);
+				if (timeDiff(sn, recvNext) >= 0)
+				{
+					recvBuffer.try_emplace(sn, p, p + length);
+				}
+			}
+			break;
+
+		case KCP_WASK:
+			needTellWindow = true;
+			break;
+
+		default:
+			break;
+		}
+		p += length;
+		remain -= length;
+	}
+	if (hasAck)
+	{
+		parseFastAck(maxAck);
+	}
+
+	// 确认推进时增大拥塞窗口，慢启动阶段每个确认加1，之后按字节线性增长
+	if (timeDiff(sendUna, prevUna) > 0 && cwnd < remoteWindow)
+	{
+		if (cwnd < ssthresh)
+		{
+			++cwnd;
+			incr += mss;
+		}
+		else
+		{
+			incr = std::max(incr, mss);
+			incr += mss * mss / incr + mss / 16;
+			if ((cwnd + 1) * mss <= incr)
+			{
+				cwnd = (incr + mss - 1) / mss;
+			}
+		}
+		if (cwnd > remoteWindow)
+		{
+			cwnd = remoteWindow;
+			incr = remoteWindow * mss;
+		}
+	}
+
+	// 把连续的分片移到readerBuffer
+	bool hasData = false;
+	while (true)
+	{
+		auto iter = recvBuffer.find(recvNext);
+		if (iter == recvBuffer.end())
+		{
+			break;
+		}
+		readerBuffer.writeData(iter->second.data(), iter->second.size());
+		recvBuffer.erase(iter);
+		++recvNext;
+		hasData = true;
+	}
+	if (hasData)
+	{
+		onRecv();
+	}
+}
+
+// main thread
+void KcpSession::onUpdate(uint64_t now)
+{
+	current = (uint32_t)now;
+	if (!isUpdated)
+	{
+		isUpdated = true;
+		nextFlush = current;
+	}
+	if (timeDiff(current, nextFlush) < 0)
+	{
+		return;
+	}
+	nextFlush += config.interval;
+	if (timeDiff(current, nextFlush) >= 0)
+	{
+		nextFlush = current + config.interval;
+	}
+	flush();
+}
+
+void KcpSession::parseUna(uint32_t una)
+{
+	while (!sendBuffer.empty() && timeDiff(sendBuffer.front().sn, una) < 0)
+	{
+		sendBuffer.pop_front();
+	}
+	sendUna = sendBuffer.empty() ? sendNext : sendBuffer.front().sn;
+}
+
+void KcpSession::parseAck(uint32_t sn)
+{
+	if (timeDiff(sn, sendUna) < 0 || timeDiff(sn, sendNext) >= 0)
+	{
+		return;
+	}
+	for (auto iter = sendBuffer.begin(); iter != sendBuffer.end(); ++iter)
+	{
+		if (iter->sn == sn)
+		{
+			sendBuffer.erase(iter);
+			break;
+		}
+		if (timeDiff(sn, iter->sn) < 0)
+		{
+			break;
+		}
+	}
+	sendUna = sendBuffer.empty() ? sendNext : sendBuffer.front().sn;
+}
+
+void KcpSession::parseFastAck(uint32_t maxAck)
+{
+	// 比maxAck早但还没确认的分片可能已丢失
+	for (auto& segment : sendBuffer)
+	{
+		if (timeDiff(segment.sn, maxAck) >= 0)
+		{
+			break;
+		}
+		++segment.fastAck;
+	}
+}
+
+void KcpSession::updateRtt(int32_t rtt)
+{
+	if (!srtt)
+	{
+		srtt = rtt;
+		rttvar = rtt / 2;
+	}
+	else
+	{
+		int32_t delta = std::abs(rtt - (int32_t)srtt);
+		rttvar = (3 * rttvar + delta) / 4;
+		srtt = std::max((7 * srtt + rtt) / 8, 1u);
+	}
+	rto = std::clamp(srtt + std::max(config.interval, 4 * rttvar), minRto, MAX_RTO);
+}
+
+uint16_t KcpSession::unusedWindow() const
+{
+	size_t used = recvBuffer.size();
+	return (uint16_t)std::min<size_t>(config.recvWindow > used ? config.recvWindow - used : 0, UINT16_MAX);
+}
+
+void KcpSession::flush()
+{
+	// 多个分片合并到不超过mtu的数据报
+	std::vector<uint8_t> buffer;
+	buffer.reserve(config.mtu);
+	uint16_t window = unusedWindow();
+	auto output = [this, &buffer, window](uint8_t command, uint32_t sn, uint32_t ts, const std::vector<uint8_t>* data)
+		{
+			size_t length = data ? data->size() : 0;
+			if (buffer.size() + HEADER_SIZE + length > config.mtu)
+			{
+				UdpSession::send(buffer.data(), buffer.size());
+				buffer.clear();
+			}
+			size_t offset = buffer.size();
+			buffer.resize(offset + HEADER_SIZE);
+			uint8_t* p = &buffer[offset];
+			*p++ = command;
+			*p++ = 0;
+			encode16(p, window);
+			encode16(p, (uint16_t)length);
+			encode32(p, ts);
+			encode32(p, sn);
+			encode32(p, recvNext);
+			if (data)
+			{
+				buffer.insert(buffer.end(), data->begin(), data->end());
+			}
+		};
+
+	for (auto& [sn, ts] : ackList)
+	{
+		output(KCP_ACK, sn, ts, nullptr);
+	}
+	ackList.clear();
+
+	// 对方窗口为0时定期询问，避免窗口更新丢失后永久停止发送
+	if (remoteWindow == 0)
+	{
+		if (!probeWait)
+		{
+			probeWait = PROBE_INIT;
+			probeTime = current + probeWait;
+		}
+		else if (timeDiff(current, probeTime) >= 0)
+		{
+			probeWait = std::min(probeWait + probeWait / 2, PROBE_LIMIT);
+			probeTime = current + probeWait;
+			needProbe = true;
+		}
+	}
+	else
+	{
+		probeWait = 0;
+	}
+	if (needProbe)
+	{
+		output(KCP_WASK, 0, 0, nullptr);
+	}
+	if (needTellWindow)
+	{
+		output(KCP_WINS, 0, 0, nullptr);
+	}
+	needProbe = needTellWindow = false;
+
+	// 新分片进入发送窗口
+	uint32_t sendWindow = std::min(config.sendWindow, remoteWindow);
+	if (!config.noCongestion)
+	{
+		sendWindow = std::min(sendWindow, cwnd);
+	}
+	while (!sendQueue.empty() && timeDiff(sendNext, sendUna + sendWindow) < 0)
+	{
+		auto& segment = sendBuffer.emplace_back(std::move(sendQueue.front()));
+		sendQueue.pop_front();
+		segment.sn = sendNext++;
+	}
+
+	uint32_t resent = config.fastResend ? config.fastResend : UINT32_MAX;
+	uint32_t rtoDelay = config.nodelay ? 0 : rto >> 3;
+	bool isLost = false, isChanged = false;
+	for (auto& segment : sendBuffer)
+	{
+		bool needSend = false;
+		if (!segment.xmit)
+		{
+			needSend = true;
+			segment.rto = rto;
+			segment.resendTs = current + segment.rto + rtoDelay;
+		}
+		else if (timeDiff(current, segment.resendTs) >= 0)
+		{
+			// 超时重传，nodelay时RTO只增加一半
+			needSend = true;
+			segment.rto = std::min(segment.rto + (config.nodelay ? segment.rto / 2 : segment.rto), MAX_RTO);
+			segment.resendTs = current + segment.rto;
+			isLost = true;
+		}
+		else if (segment.fastAck >= resent)
+		{
+			needSend = true;
+			segment.fastAck = 0;
+			segment.resendTs = current + segment.rto;
+			isChanged = true;
+		}
+		if (!needSend)
+		{
+			continue;
+		}
+		segment.ts = current;
+		output(KCP_PUSH, segment.sn, segment.ts, &segment.data);
+		if (++segment.xmit >= config.deadLink)
+		{
+			spdlog::warn("kcp session {} segment {} resent {} times, kicked", id, segment.sn, segment.xmit);
+			isKicked = true;
+			kick();
+			return;
+		}
+	}
+	if (!buffer.empty())
+	{
+		UdpSession::send(buffer.data(), buffer.size());
+	}
+
+	if (config.noCongestion)
+	{
+		return;
+	}
+	// 快速重传时减半，超时重传时回到慢启动
+	if (isChanged)
+	{
+		ssthresh = std::max((sendNext - sendUna) / 2, THRESH_MIN);
+		cwnd = ssthresh + resent;
+		incr = cwnd * mss;
+	}
+	if (isLost)
+	{
+		ssthresh = std::max(cwnd / 2, THRESH_MIN);
+		cwnd = 1;
+		incr = mss;
+	}
+}
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include "ws/network/SendQueue.h"
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace ws::network;
+using ws::core::ByteArray;
+
+void SendQueue::push(const void* data, size_t length)
+{
+	if (!length)
+	{
+		return;
+	}
+	if (!tail || tail->size() + length > COALESCE_LIMIT)
+	{
+		auto bytes = std::make_shared<ByteArray>(std::max(length, (size_t)BUFFER_SIZE));
+		tail = bytes.get();
+		chunks.push_back({ std::move(bytes), 0 });
+	}
+	tail->writeData(data, length);
+	totalBytes += length;
+}
+
+void SendQueue::push(PacketPtr packet)
+{
+	if (!packet || !packet->size())
+	{
+		return;
+	}
+	totalBytes += packet->size();
+	chunks.push_back({ std::move(packet), 0 });
+	tail = nullptr;
+}
+
+void SendQueue::append(SendQueue&& other)
+{
+	if (other.chunks.empty())
+	{
+		return;
+	}
+	if (chunks.empty())
+	{
+		swap(other);
+		return;
+	}
+	for (auto& chunk : other.chunks)
+	{
+		chunks.push_back(std::move(chunk));
+	}
+	totalBytes += other.totalBytes;
+	tail = other.tail;
+	other.chunks.clear();
+	other.tail = nullptr;
+	other.totalBytes = 0;
+}
+
+#ifdef __linux__
+SendQueue::FileChunk::~FileChunk()
+{
+	close(fd);
+}
+
+void SendQueue::pushFile(int fd, off_t offset, size_t length)
+{
+	auto file = std::make_unique<FileChunk>();
+	file->fd = fd;
+	file->offset = offset;
+	file->length = length;
+	if (!length)
+	{
+		return;
+	}
+	totalBytes += length;
+	chunks.push_back({ nullptr, 0, std::move(file) });
+	tail = nullptr;
+}
+
+bool SendQueue::frontFile(int& fd, off_t& offset, size_t& length) const
+{
+	if (chunks.empty() || !chunks.front().file)
+	{
+		return false;
+	}
+	auto& chunk = chunks.front();
+	fd = chunk.file->fd;
+	offset = chunk.file->offset + (off_t)chunk.offset;
+	length = chunk.file->length - chunk.offset;
+	return true;
+}
+
+bool SendQueue::hasFile() const
+{
+	return std::any_of(chunks.begin(), chunks.end(), [](const Chunk& chunk) { return chunk.file != nullptr; });
+}
+#endif
+
+#ifndef _WIN32
+size_t SendQueue::gather(iovec* iov, size_t maxCount) const
+{
+	size_t count = 0;
+	for (auto iter = chunks.begin(); iter != chunks.end() && count < maxCount; ++iter, ++count)
+	{
+#ifdef __linux__
+		if (iter->file)
+		{
+			break;
+		}
+#endif
+		iov[count].iov_base = const_cast<void*>(iter->packet->data(iter->offset));
+		iov[count].iov_len = iter->packet->size() - iter->offset;
+	}
+	return count;
+}
+#endif
+
+size_t SendQueue::readData(void* outData, size_t length)
+{
+	size_t total = 0;
+	while (total < length && !chunks.empty())
+	{
+		auto& chunk = chunks.front();
+		size_t copyLength = std::min(length - total, chunk.size() - chunk.offset);
+		memcpy((uint8_t*)outData + total, chunk.packet->data(chunk.offset), copyLength);
+		total += copyLength;
+		consume(copyLength);
+	}
+	return total;
+}
+
+void SendQueue::consume(size_t length)
+{
+	while (length && !chunks.empty())
+	{
+		auto& chunk = chunks.front();
+		size_t remain = chunk.size() - chunk.offset;
+		if (length < remain)
+		{
+			chunk.offset += length;
+			totalBytes -= length;
+			return;
+		}
+		length -= remain;
+		totalBytes -= remain;
+		if (chunk.packet.get() == tail)
+		{
+			tail = nullptr;
+		}
+		chunks.pop_front();
+	}
+}
+
+void SendQueue::consume(size_t length, std::vector<PacketPtr>& pinned)
+{
+	size_t pinnedLength = 0;
+	for (auto iter = chunks.begin(); iter != chunks.end() && pinnedLength < length; ++iter)
+	{
+		pinned.push_back(iter->packet);
+		pinnedLength += iter->size() - iter->offset;
+	}
+	consume(length);
+}
+
+void SendQueue::clear()
+{
+	chunks.clear();
+	tail = nullptr;
+	totalBytes = 0;
+}
+
+void SendQueue::swap(SendQueue& other) noexcept
+{
+	chunks.swap(other.chunks);
+	std::swap(tail, other.tail);
+	std::swap(totalBytes, other.totalBytes);
+}
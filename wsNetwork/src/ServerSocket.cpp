@@ -1,16 +1,48 @@
 #include <errno.h>
 #include <string.h>
+#include <algorithm>
 #include <spdlog/spdlog.h>
 #include "ws/network/ServerSocket.h"
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#endif
+#ifdef __linux__
+#include <fcntl.h>
+#include <future>
+#include <pthread.h>
+#include <sys/un.h>
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+#endif
 #include "ws/core/TimeTool.h"
 
 using namespace ws::network;
 
+namespace
+{
+	constexpr uint32_t CLIENT_INDEX_MASK = (1u << CLIENT_INDEX_BITS) - 1;
+	constexpr uint32_t MAX_CLIENT_GENERATION = UINT32_MAX >> CLIENT_INDEX_BITS;
+	constexpr uint32_t INVALID_CLIENT_INDEX = UINT32_MAX;
+	constexpr size_t FILE_READ_SIZE = 64 * 1024;	//文件需要读入内存发送时每次读取的大小
+	constexpr uint64_t ZERO_COPY_LINGER_TIME = 5000;	//关闭后等待零拷贝完成通知的最长时间
+	constexpr int LINGER_POLL_INTERVAL = 100;		//有连接等待零拷贝完成通知时epoll_wait的超时
+
+	inline uint64_t getMicroTime()
+	{
+		return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	// 计数器只用于统计，不与其他数据同步
+	inline void addCount(std::atomic<uint64_t>& counter, uint64_t value = 1)
+	{
+		counter.fetch_add(value, std::memory_order_relaxed);
+	}
+}
+
 //===================== Client Implements ========================
 // socket threads
 Client::Client() : id(0), lastActiveTime(0), socket(0), server(nullptr),
-	readerBuffer(BUFFER_SIZE), writerBuffer(BUFFER_SIZE),
-	isClosing(false), hasNewData(false)
+	readerBuffer(nullptr, 0), isClosing(false), isReady(false)
 {
 	memset(&addr, 0, sizeof(addr));
 }
@@ -23,15 +55,114 @@ Client::~Client()
 // main thread
 void Client::send(const void* data, size_t length)
 {
-	std::lock_guard<std::mutex> lock(writerMtx);
-	writerBuffer.writeData(data, length);
+	if (server && !server->checkSendLimit(*this, length))
+	{
+		return;
+	}
+	writerQueue.push(data, length);
+	if (server)
+	{
+		server->onSendQueued(*this);
+	}
 }
 
 // main thread
 void Client::send(const ByteArray& packet)
 {
-	std::lock_guard<std::mutex> lock(writerMtx);
-	writerBuffer << packet;
+	send(packet.data(), packet.size());
+}
+
+// main thread
+void Client::send(ByteArray&& packet)
+{
+	// 小包直接合并到队尾，省去一次分配
+	if (packet.size() < BUFFER_SIZE)
+	{
+		send(packet.data(), packet.size());
+		return;
+	}
+	send(std::make_shared<const ByteArray>(std::move(packet)));
+}
+
+// main thread
+void Client::send(PacketPtr packet)
+{
+	if (server && packet && !server->checkSendLimit(*this, packet->size()))
+	{
+		return;
+	}
+	writerQueue.push(std::move(packet));
+	if (server)
+	{
+		server->onSendQueued(*this);
+	}
+}
+
+#ifdef __linux__
+// main thread
+bool Client::sendFile(int fd, off_t offset, size_t length)
+{
+	if (!server || !length || !server->checkSendLimit(*this, length))
+	{
+		return false;
+	}
+	if (server->tlsContext)
+	{
+		// 用户态TLS需要明文，分块读入内存，全部读取成功才放入发送队列
+		SendQueue pieces;
+		for (size_t readBytes = 0; readBytes < length;)
+		{
+			size_t pieceLength = std::min(length - readBytes, FILE_READ_SIZE);
+			ByteArray packet(pieceLength);
+			if (pread(fd, packet.data(), pieceLength, offset + (off_t)readBytes) != (ssize_t)pieceLength)
+			{
+				spdlog::error("read file error: {}", strerror(errno));
+				return false;
+			}
+			packet.writePosition(pieceLength);
+			pieces.push(std::make_shared<const ByteArray>(std::move(packet)));
+			readBytes += pieceLength;
+		}
+		writerQueue.append(std::move(pieces));
+		server->onSendQueued(*this);
+		return true;
+	}
+	int fileFd = dup(fd);
+	if (fileFd < 0)
+	{
+		spdlog::error("dup file error: {}", strerror(errno));
+		return false;
+	}
+	writerQueue.pushFile(fileFd, offset, length);
+	server->onSendQueued(*this);
+	return true;
+}
+#endif
+
+// main thread
+ClientStats Client::getStats() const
+{
+	ClientStats stats;
+	stats.bytesIn = statBytesIn.load(std::memory_order_relaxed);
+	stats.bytesOut = statBytesOut.load(std::memory_order_relaxed);
+	stats.packetsIn = statPacketsIn;
+	stats.packetsOut = statPacketsOut;
+	stats.maxPendingBytes = statMaxPending;
+	if (connectTime)
+	{
+		stats.lifetime = TimeTool::getTickCount() - connectTime;
+	}
+	return stats;
+}
+
+// main thread
+void Client::kick()
+{
+	isClosing = true;
+	if (server)
+	{
+		server->markDirty(*this);
+	}
 }
 
 //-----------------------windows implements start-------------------------------
@@ -57,6 +188,7 @@ int ServerSocket::processEventThread()
 				if (ERROR_CONNECTION_ABORTED != error)
 				{
 					client->isClosing = true;
+					markReady(*client);
 					if (error != ERROR_NETNAME_DELETED)
 						spdlog::error("GetQueuedCompletionStatus Error: {}", error);
 				}
@@ -72,7 +204,7 @@ int ServerSocket::processEventThread()
 			{
 				sockaddr_in localAddr;
 				getAcceptedSocketAddress(ioData->buffer, &localAddr);
-				client = addClient(ioData->acceptSocket, localAddr);
+				client = addClient(ioData->acceptSocket, (sockaddr*)&localAddr, sizeof(localAddr)).get();
 				CreateIoCompletionPort((HANDLE)client->socket, completionPort, (ULONG_PTR)client, 0);
 
 				initOverlappedData(*ioData, SocketOperation::RECEIVE);
@@ -93,6 +225,7 @@ int ServerSocket::processEventThread()
 			if (BytesTransferred == 0)
 			{
 				client->isClosing = true;
+				markReady(*client);
 				releaseOverlappedData(ioData);
 			}
 			else
@@ -102,8 +235,9 @@ int ServerSocket::processEventThread()
 					releaseOverlappedData(ioData);
 					continue;
 				}
-				writeClientBuffer(*client, ioData->buffer, BytesTransferred);
-				client->hasNewData = true;
+				ByteArray data = bufferPool.alloc(BytesTransferred);
+				data.writeData(ioData->buffer, BytesTransferred);
+				pushRecvData(*client, std::move(data));
 				initOverlappedData(*ioData, SocketOperation::RECEIVE);
 				WSARecv(client->socket, &(ioData->wsabuff), 1, &numBytes, &flags, &(ioData->overlapped), NULL);
 			}
@@ -112,9 +246,11 @@ int ServerSocket::processEventThread()
 
 		case SocketOperation::SEND:
 		{
+			onSendCompleted(*client, ioData->wsabuff.len);
 			if (BytesTransferred == 0)
 			{
 				client->isClosing = true;
+				markReady(*client);
 				releaseOverlappedData(ioData);
 				spdlog::error("send error! {}", WSAGetLastError());
 			}
@@ -211,7 +347,7 @@ bool ServerSocket::startListen()
 	}
 
 	// create threads to process i/o completion port events
-	auto numThreads = std::thread::hardware_concurrency();
+	uint32_t numThreads = config.numIOThreads ? config.numIOThreads : std::thread::hardware_concurrency();
 	if (!numThreads)
 	{
 		numThreads = 1;
@@ -243,13 +379,19 @@ void ServerSocket::cleanup()
 		spdlog::debug("server socket event thread joined");
 	}
 	eventThreads.clear();
+	addingClients.consume([](ClientPtr&& client) { closesocket(client->socket); });
 	// disconnect all clients
 	for (auto &client : allClients)
 	{
-		client.second->isClosing = true;
-		destroyClient(client.second);
+		client->isClosing = true;
+		destroyClient(client);
 	}
 	allClients.clear();
+	clientSlots.clear();
+	freeSlots.clear();
+	readyClients.consume([](ClientPtr&&) {});
+	dirtyClients.clear();
+	timeWheel.clear();
 	numClients = 0;
 
 	//shutdown(listenSocket, SD_BOTH);
@@ -261,27 +403,15 @@ void ServerSocket::cleanup()
 // main thread
 void ServerSocket::flushClient(ClientPtr client)
 {
-	std::lock_guard<std::mutex> writeLock(client->writerMtx);
-	client->writerBuffer.readPosition(0);
-	size_t remain = client->writerBuffer.size();
-	if (!remain)
-	{
-		return;
-	}
-
-	while (remain > 0)
+	auto& queue = client->writerQueue;
+	while (!queue.empty())
 	{
 		auto &sendData = createOverlappedData(SocketOperation::SEND);
-		size_t length = client->writerBuffer.readData(sendData.buffer, BUFFER_SIZE);
+		size_t length = queue.readData(sendData.buffer, BUFFER_SIZE);
 		sendData.wsabuff.len = (ULONG)length;
+		client->sendingBytes += length;
 		WSASend(client->socket, &(sendData.wsabuff), 1, NULL, 0, &(sendData.overlapped), NULL);
-		if (length >= remain)
-		{
-			break;
-		}
-		remain = client->writerBuffer.readAvailable();
 	}
-	client->writerBuffer.truncate();
 }
 
 // main thread and socket threads
@@ -385,275 +515,1721 @@ void ServerSocket::destroyClient(ClientPtr client)
 	client->server = nullptr;
 }
 
-// socket thread
-void ServerSocket::writeClientBuffer(Client& client, char* data, size_t size)
-{
-	std::lock_guard<std::mutex> lock(client.readerMtx);
-	client.readerBuffer.writeData(data, size);
-}
-
 //-----------------------linux implements start-------------------------------
 #elif defined(__linux__)
-int ServerSocket::processEventThread()
+int ServerSocket::processEventThread(Reactor& reactor)
 {
-	epoll_event ev;
-	ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
-	epoll_event events[EPOLL_SIZE];
-	sockaddr clientAddr;
-	socklen_t addrlen = sizeof(sockaddr);
+	bindIOThread(reactor);
 	while (isRunning)
 	{
-		int eventCount = epoll_wait(epfd, events, EPOLL_SIZE, -1);
-		if (eventCount == -1)
+		// 还有未accept的连接时不阻塞
+		int timeout = reactor.lingeringClients.empty() ? -1 : LINGER_POLL_INTERVAL;
+		if (!pollReactor(reactor, config.busyPoll || reactor.hasPendingAccept ? 0 : timeout))
 		{
-			if (errno == EINTR)
-			{
-				continue;
-			}
-			spdlog::error("epoll wait error={}", strerror(errno));
 			return -1;
 		}
-		for (int i = 0; i < eventCount; ++i)
+	}
+	return 0;
+}	//end of processEvent
+
+// socket thread, pollInUpdate时为main thread
+bool ServerSocket::pollReactor(Reactor& reactor, int timeout)
+{
+	epoll_event events[EPOLL_SIZE];
+	int eventCount = epoll_wait(reactor.epfd, events, EPOLL_SIZE, timeout);
+	addCount(reactor.syscalls);
+	if (eventCount == -1)
+	{
+		if (errno == EINTR)
+		{
+			return true;
+		}
+		spdlog::error("epoll wait error={}", strerror(errno));
+		return false;
+	}
+	for (int i = 0; i < eventCount; ++i)
+	{
+		epoll_event& evt(events[i]);
+		// 监听socket和eventfd用reactor内的地址区分，其余为IOClient
+		if (evt.data.ptr == &reactor.listenSocket)
+		{
+			// 先处理已连接的socket，本轮末尾再accept
+			reactor.hasPendingAccept = true;
+		}
+		else if (evt.data.ptr == &reactor.eventFd)
+		{
+			read(reactor.eventFd, &reactor.eventValue, sizeof(reactor.eventValue));
+			addCount(reactor.syscalls);
+		}
+		else
 		{
-			epoll_event& evt(events[i]);
-			if (evt.events & EPOLLERR || evt.events & EPOLLHUP)
+			auto& ioClient = *(IOClient*)evt.data.ptr;
+			Client& client = *ioClient.client;
+			// 已关闭的连接只等待零拷贝的完成通知
+			if (ioClient.isReleasing)
 			{
-				// handle errors
+				if (evt.events & EPOLLERR)
+				{
+					readErrorQueue(ioClient);
+				}
+				continue;
 			}
 			if (evt.events & EPOLLIN)
 			{
-				if (evt.data.fd == listenSocket)
-				{
-					while (true)
-					{
-						Socket acceptedSocket = accept4(listenSocket, &clientAddr, &addrlen, SOCK_NONBLOCK);
-						if (acceptedSocket == -1)
-						{
-							if (errno != EAGAIN && errno != EWOULDBLOCK)
-							{
-								spdlog::error("accept error: {}", strerror(errno));
-							}
-							break;
-						}
-						if (numClients < config.maxConnection)
-						{
-							ev.data.ptr = addClient(acceptedSocket, (sockaddr_in&)clientAddr);
-							epoll_ctl(epfd, EPOLL_CTL_ADD, acceptedSocket, &ev);
-						}
-						else
-						{
-							close(acceptedSocket);
-						}
-					}
-				}
-				else if (evt.data.fd != pipe_fd[0])
-				{
-					readIntoBuffer(*(Client*)evt.data.ptr);
-				}
+				readIntoBuffer(reactor, ioClient);
 			}
-			if (evt.events & EPOLLOUT)
+			if (evt.events & (EPOLLRDHUP | EPOLLHUP))
 			{
-				writeFromBuffer(*(Client*)evt.data.ptr);
+				client.isClosing = true;
 			}
-			if (evt.events & EPOLLRDHUP)
+			// 零拷贝的完成通知也通过错误队列触发EPOLLERR
+			if ((evt.events & EPOLLERR) && !readErrorQueue(ioClient))
 			{
-				Client* client = (Client*)evt.data.ptr;
-				client->isClosing = true;
+				client.isClosing = true;
+			}
+			if ((evt.events & EPOLLOUT) && !ioClient.isReleasing)
+			{
+				writeFromBuffer(ioClient);
+			}
+			// 需要关闭，交给update线程处理
+			if (client.isClosing)
+			{
+				markReady(client);
 			}
 		}
 	}
-	return 0;
-}	//end of processEvent
-
-bool ServerSocket::startListen()
-{
-	listenSocket = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
-	if (listenSocket < 0)
+	processCommands(reactor);
+	if (!reactor.lingeringClients.empty())
 	{
-		spdlog::error("create listen socket error.");
-		return false;
+		std::erase_if(reactor.lingeringClients, [this, &reactor](Client* client)
+			{
+				auto iter = reactor.ioClients.find(client);
+				if (iter != reactor.ioClients.end())
+				{
+					tryReleaseIOClient(reactor, iter->second);
+				}
+				return !reactor.ioClients.contains(client);
+			});
 	}
-
-	sockaddr_in srvAddr;
-	//srvAddr.sin_addr.s_addr = htonl(INADDR_ANY);
-	inet_pton(AF_INET, config.listenAddr.c_str(), &srvAddr.sin_addr);
-	srvAddr.sin_family = AF_INET;
-	srvAddr.sin_port = htons(config.listenPort);
-
-	int optval = 1;
-	if (setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(int)) != 0)
+	if (reactor.hasPendingAccept)
 	{
-		spdlog::error("setsockopt error. errno={}", errno);
-		return false;
+		reactor.hasPendingAccept = acceptClients(reactor);
 	}
+	return true;
+}
 
-	int result = bind(listenSocket, (sockaddr*)&srvAddr, sizeof(srvAddr));
-	if (result < 0)
-	{
-		spdlog::error("bind port {} error. errno={}", config.listenPort, errno);
-		return false;
-	}
-	result = listen(listenSocket, 100);
-	if (result < 0)
+// socket thread, 按配置把当前I/O线程绑定到CPU上
+void ServerSocket::bindIOThread(Reactor& reactor)
+{
+	if (reactor.index >= config.ioThreadCpus.size())
 	{
-		spdlog::error("listen port {} error.", config.listenPort);
-		return false;
+		return;
 	}
-	spdlog::info("server is listening port {}, waiting for clients...", config.listenPort);
-
-	epfd = epoll_create(EPOLL_SIZE);
-	if (epfd < 0)
+	int cpu = config.ioThreadCpus[reactor.index];
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(cpu, &cpuSet);
+	int result = pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
+	if (result != 0)
 	{
-		return false;
+		spdlog::warn("bind io thread {} to cpu {} error: {}", reactor.index, cpu, strerror(result));
 	}
-	epoll_event ev;
-	ev.events = EPOLLIN | EPOLLET;
-	ev.data.fd = listenSocket;
-	epoll_ctl(epfd, EPOLL_CTL_ADD, listenSocket, &ev);
+}
 
-	if (-1 == pipe(pipe_fd))
+// socket thread, 每次最多accept maxAcceptsPerLoop个连接，返回true表示可能还有未accept的连接
+bool ServerSocket::acceptClients(Reactor& reactor)
+{
+	for (uint32_t i = 0; i < config.maxAcceptsPerLoop; ++i)
 	{
-		spdlog::error("create pipe error: {}", strerror(errno));
-		return false;
+		sockaddr_storage clientAddr;
+		socklen_t addrlen = sizeof(clientAddr);
+		Socket acceptedSocket = accept4(reactor.listenSocket, (sockaddr*)&clientAddr, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		addCount(reactor.syscalls);
+		if (acceptedSocket == -1)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+			{
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				spdlog::error("accept error: {}", strerror(errno));
+			}
+			return false;
+		}
+		onAccepted(reactor, acceptedSocket, clientAddr);
 	}
-	ev.data.fd = pipe_fd[0];
-	epoll_ctl(epfd, EPOLL_CTL_ADD, pipe_fd[0], &ev);
-
-	isRunning = true;
-	// create threads to process epoll events
-	eventThread = std::thread(&ServerSocket::processEventThread, this);
 	return true;
-}	//end of startListen
+}
 
-// main thread
-void ServerSocket::cleanup()
+// socket threads
+void ServerSocket::onAccepted(Reactor& reactor, Socket sock, const sockaddr_storage& addr)
 {
-	// stop event threads
-	if (isRunning)
+	if (numClients + numAccepting >= config.maxConnection
+		|| !checkAcceptRate(reactor, addr, TimeTool::getTickCount()))
 	{
-		isRunning = false;
-		const char exitCode[] = "0";
-		write(pipe_fd[1], exitCode, sizeof(exitCode));
-		eventThread.join();
-		spdlog::debug("server socket event thread joined");
+		close(sock);
+		return;
 	}
-	
-	close(pipe_fd[0]);
-	close(pipe_fd[1]);
-	// disconnect all clients
-	for (auto &client : allClients)
+	// unix socket只有第一个reactor在监听，连接轮流分给各个I/O线程
+	uint16_t ioIndex = reactor.index;
+	if (addr.ss_family == AF_UNIX)
 	{
-		client.second->isClosing = true;
-		destroyClient(client.second);
+		ioIndex = nextIOIndex++ % reactors.size();
 	}
-	allClients.clear();
-	numClients = 0;
-	// close listen port
-	//shutdown(listenSocket, SHUT_RDWR);
-	close(listenSocket);
-}
-
-// main thread
-void ServerSocket::flushClient(ClientPtr client)
-{
-	writeFromBuffer(*client);
+	// 客户端对象由update线程创建，I/O线程只做accept
+	++numAccepting;
+	acceptedSockets.push({ sock, addr, ioIndex });
 }
 
-// socket thread
-void ServerSocket::readIntoBuffer(Client& client)
+// socket threads
+bool ServerSocket::checkAcceptRate(Reactor& reactor, const sockaddr_storage& addr, uint64_t now)
 {
-	if (client.isClosing)
+	// 本机的unix socket连接不限制
+	if (!config.acceptRatePerIP || addr.ss_family == AF_UNIX)
 	{
-		return;
+		return true;
 	}
-	char buffer[BUFFER_SIZE];
-	bzero(buffer, BUFFER_SIZE);
-	int length = recv(client.socket, buffer, BUFFER_SIZE, 0);
-	if (length == 0 || (length == -1 && errno != EWOULDBLOCK && errno != EAGAIN))
+	// IPv4映射的地址按IPv4限制，IPv6一个用户通常拥有整个/64，按前缀限制
+	uint64_t key = 0;
+	if (addr.ss_family == AF_INET)
 	{
-		client.isClosing = true;
-		return;
+		key = ((const sockaddr_in&)addr).sin_addr.s_addr;
 	}
-	while (length > 0)
+	else
 	{
-		writeClientBuffer(client, buffer, length);
-		if (length < BUFFER_SIZE)
+		auto& addr6 = ((const sockaddr_in6&)addr).sin6_addr;
+		if (IN6_IS_ADDR_V4MAPPED(&addr6))
 		{
-			break;
+			uint32_t ip;
+			memcpy(&ip, &addr6.s6_addr[12], sizeof(ip));
+			key = ip;
 		}
-		length = recv(client.socket, buffer, BUFFER_SIZE, 0);
-		if (length == 0 || (length == -1 && errno != EWOULDBLOCK && errno != EAGAIN))
+		else
 		{
-			client.isClosing = true;
+			memcpy(&key, addr6.s6_addr, sizeof(key));
+		}
+	}
+	// 每毫秒补充acceptRatePerIP个千分之一令牌
+	const uint64_t capacity = (uint64_t)config.acceptBurstPerIP * 1000;
+	auto refill = [this, now, capacity](AcceptBucket& bucket)
+		{
+			bucket.tokens = std::min(capacity, bucket.tokens + (now - bucket.lastTime) * config.acceptRatePerIP);
+			bucket.lastTime = now;
+		};
+	// 定期清理已回满的令牌桶，避免大量来源IP占用内存
+	if (now >= reactor.bucketSweepTime)
+	{
+		for (auto iter = reactor.acceptBuckets.begin(); iter != reactor.acceptBuckets.end();)
+		{
+			refill(iter->second);
+			iter = iter->second.tokens >= capacity ? reactor.acceptBuckets.erase(iter) : std::next(iter);
 		}
+		reactor.bucketSweepTime = now + 1000;
+	}
+	auto [iter, isNew] = reactor.acceptBuckets.try_emplace(key, AcceptBucket{ capacity, now });
+	auto& bucket = iter->second;
+	refill(bucket);
+	if (bucket.tokens < 1000)
+	{
+		spdlog::debug("accept rate of {} exceeds {}/s", formatAddress(addr), config.acceptRatePerIP);
+		return false;
 	}
-	client.hasNewData = true;
+	bucket.tokens -= 1000;
+	return true;
 }
 
-// main thread and socket thread
-void ServerSocket::writeFromBuffer(Client& client)
+// socket thread
+void ServerSocket::attachClient(Reactor& reactor, ClientPtr client)
 {
-	std::lock_guard<std::mutex> lock(client.writerMtx);
-	auto& bytes = client.writerBuffer;
-	uint32_t available = bytes.readAvailable();
-	if (!available)
+	auto& ioClient = reactor.ioClients[client.get()];
+	ioClient.client = std::move(client);
+	Socket sock = ioClient.client->socket;
+	if (tlsContext)
 	{
+		ioClient.tls = std::make_unique<TlsConnection>(*tlsContext);
+	}
+	if (reactor.ring)
+	{
+		prepareUringRecv(reactor, ioClient);
 		return;
 	}
-	while (available)	//循环每次发1k直到发完或缓冲区满
+	// 用户态加密的密文是临时数据，不需要零拷贝
+	if (config.zeroCopyThreshold && !ioClient.tls)
 	{
-		int length = available > BUFFER_SIZE ? BUFFER_SIZE : available;
-		int sentLength = send(client.socket, bytes.readerPointer(), length, 0);
-		if (sentLength == -1)
-		{
-			if (errno != EWOULDBLOCK && errno != EAGAIN)
-			{
-				client.isClosing = true;	//some error
-			}
-			break;
-		}
-		bytes.seek(sentLength);
-		if (sentLength < length)
-		{
-			break;
-		}
-		available = bytes.readAvailable();
+		int optval = 1;
+		ioClient.isZeroCopy = setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval)) == 0;
 	}
-	bytes.cutHead(bytes.readPosition());
+	// 加入前已到达的数据在EPOLL_CTL_ADD时立即触发
+	epoll_event ev;
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+	ev.data.ptr = &ioClient;
+	epoll_ctl(reactor.epfd, EPOLL_CTL_ADD, sock, &ev);
 }
 
-// main thread
-void ServerSocket::destroyClient(ClientPtr client)
+bool ServerSocket::createListenSocket(Reactor& reactor, bool reusePort)
 {
-	//shutdown(client->socket, SHUT_RDWR);
-	close(client->socket);
-	if (config.onClientDestroyed)
+	int family = listenAddress.ss_family;
+	reactor.listenSocket = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (reactor.listenSocket < 0)
 	{
-		config.onClientDestroyed(client);
+		spdlog::error("create listen socket error.");
+		return false;
 	}
-	client->onDisconnected();
-	client->server = nullptr;
-}
 
-// socket thread
-void ServerSocket::writeClientBuffer(Client& client, char* data, size_t size)
-{
-	std::lock_guard<std::mutex> lock(client.readerMtx);
-	client.readerBuffer.writeData(data, size);
-}
+	int optval = 1;
+	int ipv6Only = config.ipv6Only;
+	if (family == AF_INET6 && setsockopt(reactor.listenSocket, IPPROTO_IPV6, IPV6_V6ONLY, &ipv6Only, sizeof(ipv6Only)) != 0)
+	{
+		spdlog::error("setsockopt IPV6_V6ONLY error. errno={}", errno);
+		return false;
+	}
+	if (setsockopt(reactor.listenSocket, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(int)) != 0)
+	{
+		spdlog::error("setsockopt error. errno={}", errno);
+		return false;
+	}
+	// 多个reactor监听同一端口，由内核分发连接
+	if (reusePort && setsockopt(reactor.listenSocket, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(int)) != 0)
+	{
+		spdlog::error("setsockopt SO_REUSEPORT error. errno={}", errno);
+		return false;
+	}
 
-#elif defined(__APPLE__)
-int ServerSocket::processEventThread()
-{
-    struct kevent ev_set[3];
-    struct kevent events[KEVENT_SIZE];
-    sockaddr clientAddr;
-    socklen_t addrlen = sizeof(sockaddr);
-    while (isRunning)
-    {
-        int eventCount = kevent(kqfd, nullptr, 0, events, KEVENT_SIZE, nullptr);
-        if (eventCount == -1)
-        {
+	// 上次退出残留的socket文件，抽象地址不需要删除
+	auto& unixAddr = (sockaddr_un&)listenAddress;
+	bool isUnixPath = family == AF_UNIX && unixAddr.sun_path[0];
+	if (isUnixPath)
+	{
+		unlink(unixAddr.sun_path);
+	}
+	int result = bind(reactor.listenSocket, (sockaddr*)&listenAddress, listenAddressLength);
+	if (result < 0)
+	{
+		spdlog::error("bind {} port {} error. errno={}", config.listenAddr, config.listenPort, errno);
+		return false;
+	}
+	isUnixPathOwner = isUnixPath;
+	result = listen(reactor.listenSocket, config.listenBacklog);
+	if (result < 0)
+	{
+		spdlog::error("listen {} port {} error.", config.listenAddr, config.listenPort);
+		return false;
+	}
+	if (family == AF_UNIX)
+	{
+		return true;
+	}
+	if (config.deferAcceptTime && setsockopt(reactor.listenSocket, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+		&config.deferAcceptTime, sizeof(config.deferAcceptTime)) != 0)
+	{
+		spdlog::warn("setsockopt TCP_DEFER_ACCEPT error. errno={}", errno);
+	}
+	// accept的socket继承监听socket的设置，超过net.core.busy_poll时需要CAP_NET_ADMIN
+	if (config.socketBusyPollUs && setsockopt(reactor.listenSocket, SOL_SOCKET, SO_BUSY_POLL,
+		&config.socketBusyPollUs, sizeof(config.socketBusyPollUs)) != 0)
+	{
+		spdlog::warn("setsockopt SO_BUSY_POLL error: {}", strerror(errno));
+	}
+	return true;
+}
+
+// inheritedSocket为旧进程交来的监听socket，为-1时新建
+bool ServerSocket::initReactor(Reactor& reactor, bool isListening, bool reusePort, Socket inheritedSocket)
+{
+	if (!isListening)
+	{
+		reactor.listenSocket = -1;
+	}
+	else if (inheritedSocket == -1)
+	{
+		if (!createListenSocket(reactor, reusePort))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		reactor.listenSocket = inheritedSocket;
+		fcntl(inheritedSocket, F_SETFL, fcntl(inheritedSocket, F_GETFL) | O_NONBLOCK);
+		fcntl(inheritedSocket, F_SETFD, FD_CLOEXEC);
+	}
+
+	if (config.ioBackend == IOBackend::IO_URING)
+	{
+		reactor.ring = std::make_unique<IoUring>();
+		if (!reactor.ring->init(URING_ENTRIES))
+		{
+			return false;
+		}
+		reactor.eventFd = eventfd(0, EFD_CLOEXEC);
+		if (reactor.eventFd < 0)
+		{
+			spdlog::error("create eventfd error: {}", strerror(errno));
+			return false;
+		}
+		reactor.recvBuffers.resize((size_t)URING_BUFFER_COUNT * BUFFER_SIZE);
+		return true;
+	}
+
+	reactor.eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (reactor.eventFd < 0)
+	{
+		spdlog::error("create eventfd error: {}", strerror(errno));
+		return false;
+	}
+
+	reactor.epfd = epoll_create(EPOLL_SIZE);
+	if (reactor.epfd < 0)
+	{
+		return false;
+	}
+	epoll_event ev;
+	ev.events = EPOLLIN | EPOLLET;
+	if (reactor.listenSocket != -1)
+	{
+		ev.data.ptr = &reactor.listenSocket;
+		epoll_ctl(reactor.epfd, EPOLL_CTL_ADD, reactor.listenSocket, &ev);
+	}
+	ev.data.ptr = &reactor.eventFd;
+	epoll_ctl(reactor.epfd, EPOLL_CTL_ADD, reactor.eventFd, &ev);
+	return true;
+}
+
+bool ServerSocket::startListen()
+{
+	return startReactors({});
+}
+
+// TCP每个监听socket对应一个reactor，为空时按numIOThreads新建，unix socket只有第一个reactor监听
+bool ServerSocket::startReactors(const std::vector<Socket>& inheritedSockets)
+{
+	bool isUnix = listenAddress.ss_family == AF_UNIX;
+	size_t numReactors = inheritedSockets.size();
+	if (!numReactors || isUnix)
+	{
+		numReactors = config.numIOThreads ? config.numIOThreads : 1;
+	}
+	if (config.pollInUpdate && numReactors > 1)
+	{
+		spdlog::error("pollInUpdate only supports one io thread, got {} listen sockets", numReactors);
+		return false;
+	}
+	for (size_t i = 0; i < numReactors; ++i)
+	{
+		reactors.push_back(std::make_unique<Reactor>());
+		reactors.back()->index = (uint16_t)i;
+		if (!initReactor(*reactors.back(), !isUnix || i == 0, !isUnix && numReactors > 1, i < inheritedSockets.size() ? inheritedSockets[i] : -1))
+		{
+			for (size_t j = i + 1; j < inheritedSockets.size(); ++j)
+			{
+				close(inheritedSockets[j]);
+			}
+			return false;
+		}
+	}
+	spdlog::info("server is listening {} port {} with {} {} threads, waiting for clients...", config.listenAddr, config.listenPort,
+		numReactors, config.ioBackend == IOBackend::IO_URING ? "io_uring" : "epoll");
+
+	isRunning = true;
+	// 在update中轮询，不创建I/O线程
+	if (config.pollInUpdate)
+	{
+		return true;
+	}
+	// create threads to process epoll events
+	auto threadProc = config.ioBackend == IOBackend::IO_URING ? &ServerSocket::processUringThread : &ServerSocket::processEventThread;
+	for (auto& reactor : reactors)
+	{
+		reactor->eventThread = std::thread(threadProc, this, std::ref(*reactor));
+	}
+	return true;
+}	//end of startListen
+
+// main thread
+void ServerSocket::cleanup()
+{
+	// stop event threads
+	if (isRunning)
+	{
+		isRunning = false;
+		for (auto& reactor : reactors)
+		{
+			wakeup(*reactor);
+		}
+		for (auto& reactor : reactors)
+		{
+			if (reactor->eventThread.joinable())
+			{
+				reactor->eventThread.join();
+			}
+		}
+		spdlog::debug("server socket event thread joined");
+	}
+	// I/O线程已停止，关闭所有客户端socket
+	for (auto& reactor : reactors)
+	{
+		for (auto& [ptr, ioClient] : reactor->ioClients)
+		{
+			close(ioClient.client->socket);
+		}
+		reactor->ioClients.clear();
+		reactor->lingeringClients.clear();
+		// 还未交给I/O线程的客户端
+		reactor->commands.consume([](IOCommand&& command)
+			{
+				if (command.isAttach)
+				{
+					close(command.client->socket);
+				}
+			});
+	}
+	acceptedSockets.consume([](AcceptedSocket&& accepted) { close(accepted.socket); });
+	numAccepting = 0;
+	addingClients.consume([](ClientPtr&&) {});
+	// disconnect all clients
+	for (auto &client : allClients)
+	{
+		client->isClosing = true;
+		destroyClient(client);
+	}
+	allClients.clear();
+	clientSlots.clear();
+	freeSlots.clear();
+	readyClients.consume([](ClientPtr&&) {});
+	dirtyClients.clear();
+	timeWheel.clear();
+	numClients = 0;
+	// close listen port，已停止accept的监听socket可能还在新进程中使用，不能shutdown
+	for (auto& reactor : reactors)
+	{
+		if (reactor->listenSocket != -1)
+		{
+			if (reactor->ring)
+			{
+				// io_uring未完成的accept持有监听socket的引用，需要shutdown才能立即释放端口
+				shutdown(reactor->listenSocket, SHUT_RDWR);
+			}
+			close(reactor->listenSocket);
+		}
+		close(reactor->epfd);
+		close(reactor->eventFd);
+	}
+	reactors.clear();
+	if (isUnixPathOwner)
+	{
+		unlink(((sockaddr_un&)listenAddress).sun_path);
+		isUnixPathOwner = false;
+	}
+	if (handoffSocket != -1)
+	{
+		close(handoffSocket);
+		handoffSocket = -1;
+		unlink(handoffPath.c_str());
+	}
+	drainDeadline = 0;
+}
+
+// main thread
+void ServerSocket::flushClient(ClientPtr client)
+{
+	if (client->writerQueue.empty())
+	{
+		return;
+	}
+	// 整个发送队列移交给I/O线程
+	IOCommand command;
+	command.client = client;
+	command.data.swap(client->writerQueue);
+	client->sendingBytes += command.data.size();
+	postCommand(client->ioIndex, std::move(command));
+}
+
+// socket thread
+void ServerSocket::readIntoBuffer(Reactor& reactor, IOClient& ioClient)
+{
+	Client& client = *ioClient.client;
+	if (client.isClosing)
+	{
+		return;
+	}
+	while (true)
+	{
+		// 直接收到独立的数据块，交给update线程时不再复制
+		ByteArray data = bufferPool.alloc(BUFFER_SIZE);
+		ssize_t length = recv(client.socket, data.writerPointer(), BUFFER_SIZE, 0);
+		addCount(reactor.syscalls);
+		if (length > 0)
+		{
+			if (ioClient.tls)
+			{
+				// 密文解密后再交给update线程
+				onTlsData(reactor, ioClient, data.data(), length);
+				bufferPool.free(std::move(data));
+				if (client.isClosing)
+				{
+					break;
+				}
+			}
+			else
+			{
+				data.writePosition(length);
+				pushRecvData(client, std::move(data));
+			}
+			if (length < BUFFER_SIZE)
+			{
+				break;
+			}
+			continue;
+		}
+		if (length == 0 || (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR))
+		{
+			client.isClosing = true;
+			markReady(client);
+		}
+		else if (errno != EINTR)
+		{
+			addCount(reactor.recvEagain);
+		}
+		break;
+	}
+}
+
+// socket thread
+void ServerSocket::writeFromBuffer(IOClient& ioClient)
+{
+	auto& client = *ioClient.client;
+	auto& queue = ioClient.sending;
+	Reactor& reactor = *reactors[client.ioIndex];
+	iovec iov[MAX_SEND_IOV];
+	bool isError = false;
+	while (!queue.empty())
+	{
+		int fileFd = -1;
+		off_t fileOffset = 0;
+		size_t fileLength = 0;
+		if (queue.frontFile(fileFd, fileOffset, fileLength))
+		{
+			ssize_t sentLength = sendfile(client.socket, fileFd, &fileOffset, fileLength);
+			addCount(reactor.syscalls);
+			if (sentLength <= 0)
+			{
+				// 返回0说明文件比指定的长度短
+				if (sentLength == 0 || (errno != EWOULDBLOCK && errno != EAGAIN))
+				{
+					spdlog::error("sendfile error: {}", sentLength ? strerror(errno) : "unexpected end of file");
+					isError = true;
+				}
+				else
+				{
+					addCount(reactor.sendEagain);
+				}
+				break;
+			}
+			queue.consume(sentLength);
+			completeSend(ioClient, sentLength);
+			if ((size_t)sentLength < fileLength)
+			{
+				break;
+			}
+			continue;
+		}
+
+		// 一次系统调用发送多个数据块
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = queue.gather(iov, MAX_SEND_IOV);
+		size_t length = 0;
+		for (size_t i = 0; i < msg.msg_iovlen; ++i)
+		{
+			length += iov[i].iov_len;
+		}
+		bool isZeroCopy = ioClient.isZeroCopy && length >= config.zeroCopyThreshold;
+		ssize_t sentLength = sendmsg(client.socket, &msg, MSG_NOSIGNAL | (isZeroCopy ? MSG_ZEROCOPY : 0));
+		addCount(reactor.syscalls);
+		if (sentLength == -1 && isZeroCopy && errno == ENOBUFS)
+		{
+			// 超过了锁定内存的限制，改为复制发送
+			isZeroCopy = false;
+			sentLength = sendmsg(client.socket, &msg, MSG_NOSIGNAL);
+			addCount(reactor.syscalls);
+		}
+		if (sentLength == -1)
+		{
+			if (errno != EWOULDBLOCK && errno != EAGAIN)
+			{
+				isError = true;	//some error
+			}
+			else
+			{
+				addCount(reactor.sendEagain);
+			}
+			break;
+		}
+		if (isZeroCopy)
+		{
+			// 内核通知完成前数据块不能释放或修改
+			auto& pinned = ioClient.zeroCopyPinned.emplace_back();
+			pinned.first = ioClient.zeroCopySeq++;
+			queue.consume(sentLength, pinned.second);
+			queue.seal();
+		}
+		else
+		{
+			queue.consume(sentLength);
+		}
+		completeSend(ioClient, sentLength);
+		if ((size_t)sentLength < length)
+		{
+			break;
+		}
+	}
+	if (isError)
+	{
+		// 出错后丢弃剩余数据，由update线程关闭
+		completeSend(ioClient, queue.size());
+		queue.clear();
+		client.isClosing = true;
+		markReady(client);
+		return;
+	}
+	tryEnableKtls(ioClient);
+}
+
+// socket thread
+void ServerSocket::sendPending(Reactor& reactor, IOClient& ioClient)
+{
+	if (reactor.ring)
+	{
+		prepareUringSend(reactor, ioClient);
+	}
+	else
+	{
+		writeFromBuffer(ioClient);
+	}
+}
+
+// socket thread, 用户态TLS发出的是密文，对应的明文全部发出后才算完成
+void ServerSocket::completeSend(IOClient& ioClient, size_t length)
+{
+	Client& client = *ioClient.client;
+	// 切换到内核TLS时已发送的密文都已完成，之后交给内核的都是明文
+	if (!ioClient.tls || ioClient.tls->isKtls())
+	{
+		onSendCompleted(client, length);
+		return;
+	}
+	ioClient.tlsSentBytes += length;
+	auto& marks = ioClient.tlsPlainMarks;
+	while (!marks.empty() && marks.front().first <= ioClient.tlsSentBytes)
+	{
+		onSendCompleted(client, marks.front().second);
+		marks.pop_front();
+	}
+}
+
+// socket thread, 收到密文，握手数据交给I/O线程发送，解密后的明文交给update线程
+void ServerSocket::onTlsData(Reactor& reactor, IOClient& ioClient, const void* data, size_t length)
+{
+	auto& tls = *ioClient.tls;
+	Client& client = *ioClient.client;
+	size_t pendingBytes = tls.pendingBytes();
+	bool isOk = tls.feed(data, length, ioClient.sending);
+	if (pendingBytes && !tls.pendingBytes())
+	{
+		// 握手完成，之前暂存的明文已经加密
+		ioClient.tlsPlainMarks.emplace_back(ioClient.tlsSentBytes + ioClient.sending.size(), pendingBytes);
+	}
+	while (isOk)
+	{
+		ByteArray plain = bufferPool.alloc(BUFFER_SIZE);
+		int readLength = tls.read(plain.writerPointer(), BUFFER_SIZE);
+		if (readLength <= 0)
+		{
+			bufferPool.free(std::move(plain));
+			// 读取时可能产生会话票据等数据
+			isOk = readLength == 0 && tls.flushOutput(ioClient.sending);
+			break;
+		}
+		plain.writePosition(readLength);
+		pushRecvData(client, std::move(plain));
+	}
+	if (!ioClient.isReleasing)
+	{
+		sendPending(reactor, ioClient);
+		tryEnableKtls(ioClient);
+	}
+	if (!isOk)
+	{
+		client.isClosing = true;
+		markReady(client);
+	}
+}
+
+// socket thread
+void ServerSocket::encryptAndSend(Reactor& reactor, IOClient& ioClient, SendQueue&& plain)
+{
+	size_t plainBytes = plain.size();
+	if (!ioClient.tls->encrypt(plain, ioClient.sending))
+	{
+		onSendCompleted(*ioClient.client, plainBytes);
+		ioClient.client->isClosing = true;
+		markReady(*ioClient.client);
+		return;
+	}
+	if (ioClient.tls->isHandshakeDone())
+	{
+		ioClient.tlsPlainMarks.emplace_back(ioClient.tlsSentBytes + ioClient.sending.size(), plainBytes);
+	}
+	sendPending(reactor, ioClient);
+}
+
+// socket thread, 用户态生成的密文全部发出后把发送方向交给内核
+void ServerSocket::tryEnableKtls(IOClient& ioClient)
+{
+	if (ioClient.tls && ioClient.tls->canEnableKtls() && ioClient.sending.empty() && !ioClient.isSending)
+	{
+		ioClient.tls->enableKtls(ioClient.client->socket);
+	}
+}
+
+
+// socket thread
+bool ServerSocket::readErrorQueue(IOClient& ioClient)
+{
+	auto& client = *ioClient.client;
+	char control[128];
+	// 只有零拷贝需要读取错误队列，unix socket忽略MSG_ERRQUEUE，会一直读到普通数据或EOF
+	while (ioClient.isZeroCopy)
+	{
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(client.socket, &msg, MSG_ERRQUEUE) == -1)
+		{
+			break;
+		}
+		for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+				&& !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+			{
+				continue;
+			}
+			auto error = (sock_extended_err*)CMSG_DATA(cmsg);
+			if (error->ee_origin == SO_EE_ORIGIN_ZEROCOPY && error->ee_errno == 0)
+			{
+				// ee_data为本次通知覆盖的最后一次发送的序号
+				releaseZeroCopyBuffers(ioClient, error->ee_data + 1);
+			}
+		}
+	}
+	int error = 0;
+	socklen_t length = sizeof(error);
+	getsockopt(client.socket, SOL_SOCKET, SO_ERROR, &error, &length);
+	return error == 0;
+}
+
+// socket thread
+void ServerSocket::releaseZeroCopyBuffers(IOClient& ioClient, uint32_t done)
+{
+	auto& pinned = ioClient.zeroCopyPinned;
+	while (!pinned.empty() && (int32_t)(pinned.front().first - done) < 0)
+	{
+		pinned.pop_front();
+	}
+}
+
+// main thread
+void ServerSocket::destroyClient(ClientPtr client)
+{
+	if (isRunning)
+	{
+		// socket由I/O线程关闭，保证I/O线程不会访问已关闭的socket
+		IOCommand command;
+		command.client = client;
+		command.isClose = true;
+		postCommand(client->ioIndex, std::move(command));
+	}
+	if (config.onClientDestroyed)
+	{
+		config.onClientDestroyed(client);
+	}
+	client->onDisconnected();
+	client->server = nullptr;
+}
+
+// any thread
+void ServerSocket::post(std::function<void()> task, uint16_t ioIndex /*= 0*/)
+{
+	if (!isRunning || ioIndex >= reactors.size())
+	{
+		spdlog::error("post task to invalid io thread {}", ioIndex);
+		return;
+	}
+	IOCommand command;
+	command.task = std::move(task);
+	postCommand(ioIndex, std::move(command));
+}
+
+// main thread
+void ServerSocket::postFlush(uint32_t clientID)
+{
+	if (auto client = getClient(clientID))
+	{
+		flushClient(client);
+	}
+}
+
+// any thread
+void ServerSocket::postCommand(uint16_t ioIndex, IOCommand&& command)
+{
+	auto& reactor = *reactors[ioIndex];
+	reactor.commands.push(std::move(command));
+	// 只在I/O线程处理完上一批命令后唤醒一次
+	if (!reactor.hasCommand.exchange(true))
+	{
+		wakeup(reactor);
+	}
+}
+
+// any thread
+void ServerSocket::wakeup(Reactor& reactor)
+{
+	// 轮询的线程每轮都会处理命令
+	if (config.busyPoll || config.pollInUpdate)
+	{
+		return;
+	}
+	const uint64_t value = 1;
+	write(reactor.eventFd, &value, sizeof(value));
+	addCount(reactor.syscalls);
+}
+
+// socket thread
+void ServerSocket::processCommands(Reactor& reactor)
+{
+	reactor.hasCommand = false;
+	reactor.commands.consume([this, &reactor](IOCommand&& command)
+		{
+			if (command.task)
+			{
+				command.task();
+				return;
+			}
+			if (command.isAttach)
+			{
+				attachClient(reactor, std::move(command.client));
+				return;
+			}
+			auto iter = reactor.ioClients.find(command.client.get());
+			if (iter == reactor.ioClients.end())
+			{
+				return;
+			}
+			auto& ioClient = iter->second;
+			if (command.isClose)
+			{
+				ioClient.isReleasing = true;
+				if (reactor.ring && !ioClient.isSending)
+				{
+					// 唤醒未完成的接收，正在进行的发送完成后再关闭，与epoll后端一样尽量发出已提交的数据
+					shutdown(ioClient.client->socket, SHUT_RDWR);
+				}
+				tryReleaseIOClient(reactor, ioClient);
+			}
+			else if (ioClient.tls && !ioClient.tls->isKtls())
+			{
+				encryptAndSend(reactor, ioClient, std::move(command.data));
+			}
+			else
+			{
+				ioClient.sending.append(std::move(command.data));
+				sendPending(reactor, ioClient);
+			}
+		});
+}
+
+// socket thread
+void ServerSocket::tryReleaseIOClient(Reactor& reactor, IOClient& ioClient)
+{
+	if (!ioClient.isReleasing || ioClient.isRecvArmed || ioClient.isSending)
+	{
+		return;
+	}
+	Socket sock = ioClient.client->socket;
+	// 零拷贝发送的数据块在完成通知前仍被内核引用，先只关闭发送方向，通知全部到达后再释放
+	if (!ioClient.zeroCopyPinned.empty())
+	{
+		uint64_t now = TimeTool::getTickCount();
+		if (!ioClient.lingerDeadline)
+		{
+			shutdown(sock, SHUT_WR);
+			ioClient.lingerDeadline = now + ZERO_COPY_LINGER_TIME;
+			reactor.lingeringClients.push_back(ioClient.client.get());
+			return;
+		}
+		if (now < ioClient.lingerDeadline)
+		{
+			return;
+		}
+		// 对端一直不确认，复位连接，close时内核丢弃未发出的数据，不再读取这些内存
+		spdlog::warn("client {} zero copy send not completed in {}ms, reset", ioClient.client->id, ZERO_COPY_LINGER_TIME);
+		linger option{ 1, 0 };
+		setsockopt(sock, SOL_SOCKET, SO_LINGER, &option, sizeof(option));
+	}
+	close(sock);
+	reactor.ioClients.erase(ioClient.client.get());
+}
+
+//-----------------------io_uring backend-------------------------------
+namespace
+{
+	// user_data低3位保存操作类型，其余为指针
+	enum UringOperation : uint64_t
+	{
+		URING_ACCEPT = 1,
+		URING_RECV,
+		URING_SEND,
+		URING_WAKEUP,
+		URING_PROVIDE,
+		URING_CANCEL,
+	};
+	constexpr uint64_t URING_OPERATION_MASK = 7;
+	constexpr uint16_t URING_BUFFER_GROUP = 0;
+
+	inline uint64_t makeUserData(UringOperation operation, void* ptr = nullptr)
+	{
+		return (uint64_t)(uintptr_t)ptr | operation;
+	}
+}
+
+int ServerSocket::processUringThread(Reactor& reactor)
+{
+	bindIOThread(reactor);
+	IoUring& ring = *reactor.ring;
+	std::vector<IOClient*> starvedClients;
+	provideUringBuffer(reactor, 0, URING_BUFFER_COUNT);
+	if (reactor.listenSocket != -1)
+	{
+		prepareUringAccept(reactor);
+	}
+	prepareUringWakeup(reactor);
+	while (isRunning)
+	{
+		// 一次系统调用提交本轮所有的接收、发送请求并等待完成事件，轮询时不等待且没有新请求时不进入内核
+		if (ring.submit(config.busyPoll ? 0 : 1) < 0 && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+		{
+			return -1;
+		}
+		ring.forEachCqe([&](const io_uring_cqe& cqe)
+			{
+				auto operation = (UringOperation)(cqe.user_data & URING_OPERATION_MASK);
+				void* ptr = (void*)(uintptr_t)(cqe.user_data & ~URING_OPERATION_MASK);
+				bool hasMore = cqe.flags & IORING_CQE_F_MORE;
+				switch (operation)
+				{
+				case URING_ACCEPT:
+				{
+					if (cqe.res >= 0)
+					{
+						Socket acceptedSocket = cqe.res;
+						sockaddr_storage clientAddr;
+						socklen_t addrlen = sizeof(clientAddr);
+						memset(&clientAddr, 0, sizeof(clientAddr));
+						getpeername(acceptedSocket, (sockaddr*)&clientAddr, &addrlen);
+						onAccepted(reactor, acceptedSocket, clientAddr);
+					}
+					else if (cqe.res != -ECANCELED)
+					{
+						spdlog::error("io_uring accept error: {}", strerror(-cqe.res));
+					}
+					// 内核拒绝这个请求时重新投递只会立即再次失败，停止接受连接而不是空转
+					bool rejected = cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP;
+					if (!hasMore && !rejected && isRunning && reactor.listenSocket != -1)
+					{
+						prepareUringAccept(reactor);
+					}
+					break;
+				}
+
+				case URING_RECV:
+				{
+					auto& ioClient = *(IOClient*)ptr;
+					Client& client = *ioClient.client;
+					if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER))
+					{
+						auto bufferID = (uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+						if (ioClient.tls && !client.isClosing && !ioClient.isReleasing)
+						{
+							onTlsData(reactor, ioClient, reactor.recvBuffers.data() + (size_t)bufferID * BUFFER_SIZE, cqe.res);
+						}
+						else if (!client.isClosing && !ioClient.isReleasing)
+						{
+							ByteArray data = bufferPool.alloc(cqe.res);
+							data.writeData(reactor.recvBuffers.data() + (size_t)bufferID * BUFFER_SIZE, cqe.res);
+							pushRecvData(client, std::move(data));
+						}
+						provideUringBuffer(reactor, bufferID);
+					}
+					else if (cqe.res == -ENOBUFS && !ioClient.isReleasing)
+					{
+						// 缓冲区耗尽，等本轮归还缓冲区后再重新投递
+						starvedClients.push_back(&ioClient);
+					}
+					else if (cqe.res != -ECANCELED && !ioClient.isReleasing)
+					{
+						client.isClosing = true;
+						markReady(client);
+					}
+					if (!hasMore)
+					{
+						ioClient.isRecvArmed = false;
+						if (cqe.res > 0 && !ioClient.isReleasing)
+						{
+							prepareUringRecv(reactor, ioClient);
+						}
+						tryReleaseIOClient(reactor, ioClient);
+					}
+					break;
+				}
+
+				case URING_SEND:
+				{
+					auto& ioClient = *(IOClient*)ptr;
+					ioClient.isSending = false;
+					if (cqe.res < 0)
+					{
+						completeSend(ioClient, ioClient.sending.size());
+						ioClient.sending.clear();
+						if (!ioClient.isReleasing)
+						{
+							ioClient.client->isClosing = true;
+							markReady(*ioClient.client);
+						}
+					}
+					else
+					{
+						ioClient.sending.consume(cqe.res);
+						completeSend(ioClient, cqe.res);
+					}
+					if (ioClient.isReleasing)
+					{
+						shutdown(ioClient.client->socket, SHUT_RDWR);
+					}
+					else
+					{
+						prepareUringSend(reactor, ioClient);
+						tryEnableKtls(ioClient);
+					}
+					tryReleaseIOClient(reactor, ioClient);
+					break;
+				}
+
+				case URING_WAKEUP:
+				{
+					if (isRunning)
+					{
+						prepareUringWakeup(reactor);
+					}
+					break;
+				}
+
+				case URING_PROVIDE:
+				{
+					if (cqe.res < 0)
+					{
+						spdlog::error("io_uring provide buffers error: {}", strerror(-cqe.res));
+					}
+					break;
+				}
+
+				case URING_CANCEL:
+					break;
+				}
+			});
+		for (auto ioClient : starvedClients)
+		{
+			if (!ioClient->isReleasing && !ioClient->isRecvArmed)
+			{
+				prepareUringRecv(reactor, *ioClient);
+			}
+		}
+		starvedClients.clear();
+		processCommands(reactor);
+	}
+	return 0;
+}
+
+// socket thread
+void ServerSocket::prepareUringAccept(Reactor& reactor)
+{
+	io_uring_sqe* sqe = reactor.ring->getSqe();
+	if (!sqe)
+	{
+		spdlog::error("io_uring submission queue is full");
+		return;
+	}
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = reactor.listenSocket;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->user_data = makeUserData(URING_ACCEPT);
+}
+
+// socket thread
+void ServerSocket::prepareUringRecv(Reactor& reactor, IOClient& ioClient)
+{
+	io_uring_sqe* sqe = reactor.ring->getSqe();
+	if (!sqe)
+	{
+		spdlog::error("io_uring submission queue is full");
+		ioClient.client->isClosing = true;
+		markReady(*ioClient.client);
+		return;
+	}
+	// 多次触发的接收，数据直接写入内核挑选的缓冲区
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = ioClient.client->socket;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUFFER_GROUP;
+	sqe->user_data = makeUserData(URING_RECV, &ioClient);
+	ioClient.isRecvArmed = true;
+}
+
+// socket thread
+void ServerSocket::prepareUringSend(Reactor& reactor, IOClient& ioClient)
+{
+	if (ioClient.isSending || ioClient.isReleasing || ioClient.sending.empty())
+	{
+		return;
+	}
+	io_uring_sqe* sqe = reactor.ring->getSqe();
+	if (!sqe)
+	{
+		spdlog::error("io_uring submission queue is full");
+		return;
+	}
+	memset(&ioClient.sendMsg, 0, sizeof(ioClient.sendMsg));
+	ioClient.sendMsg.msg_iov = ioClient.sendIov;
+	int fileFd = -1;
+	off_t fileOffset = 0;
+	size_t fileLength = 0;
+	if (ioClient.sending.frontFile(fileFd, fileOffset, fileLength))
+	{
+		// 队首是文件时每次读入一块再发送，发送完成后按实际发出的长度推进
+		ioClient.fileBuffer.resize(std::min(fileLength, FILE_READ_SIZE));
+		ssize_t readLength = pread(fileFd, ioClient.fileBuffer.data(), ioClient.fileBuffer.size(), fileOffset);
+		addCount(reactor.syscalls);
+		if (readLength <= 0)
+		{
+			spdlog::error("read file error: {}", readLength ? strerror(errno) : "unexpected end of file");
+			completeSend(ioClient, ioClient.sending.size());
+			ioClient.sending.clear();
+			ioClient.client->isClosing = true;
+			markReady(*ioClient.client);
+			return;
+		}
+		ioClient.sendIov[0].iov_base = ioClient.fileBuffer.data();
+		ioClient.sendIov[0].iov_len = (size_t)readLength;
+		ioClient.sendMsg.msg_iovlen = 1;
+	}
+	else
+	{
+		ioClient.sendMsg.msg_iovlen = ioClient.sending.gather(ioClient.sendIov, MAX_SEND_IOV);
+	}
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = ioClient.client->socket;
+	sqe->addr = (uint64_t)(uintptr_t)&ioClient.sendMsg;
+	sqe->len = 1;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = makeUserData(URING_SEND, &ioClient);
+	ioClient.isSending = true;
+}
+
+// socket thread
+void ServerSocket::prepareUringWakeup(Reactor& reactor)
+{
+	io_uring_sqe* sqe = reactor.ring->getSqe();
+	if (!sqe)
+	{
+		spdlog::error("io_uring submission queue is full");
+		return;
+	}
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = reactor.eventFd;
+	sqe->addr = (uint64_t)(uintptr_t)&reactor.eventValue;
+	sqe->len = sizeof(reactor.eventValue);
+	sqe->user_data = makeUserData(URING_WAKEUP);
+}
+
+// socket thread
+void ServerSocket::provideUringBuffer(Reactor& reactor, uint16_t bufferID, uint16_t count /*= 1*/)
+{
+	io_uring_sqe* sqe = reactor.ring->getSqe();
+	if (!sqe)
+	{
+		spdlog::error("io_uring submission queue is full");
+		return;
+	}
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = count;
+	sqe->addr = (uint64_t)(uintptr_t)(reactor.recvBuffers.data() + (size_t)bufferID * BUFFER_SIZE);
+	sqe->len = BUFFER_SIZE;
+	sqe->off = bufferID;
+	sqe->buf_group = URING_BUFFER_GROUP;
+	sqe->user_data = makeUserData(URING_PROVIDE);
+}
+
+//-----------------------drain and handoff-------------------------------
+namespace
+{
+	// 热重启时旧进程发给新进程的消息，数据紧随其后按HANDOFF_CHUNK分段发送
+	enum HandoffType : uint32_t
+	{
+		HANDOFF_LISTEN = 1,		//附带所有监听socket
+		HANDOFF_CLIENT,			//附带一个连接的socket
+		HANDOFF_END,
+	};
+
+	struct HandoffHeader
+	{
+		uint32_t		type = 0;
+		uint32_t		recvLength = 0;		//旧进程已收到但还未处理的字节数
+		uint32_t		sendLength = 0;		//旧进程还未发出的字节数
+		sockaddr_storage	addr;
+	};
+
+	constexpr size_t HANDOFF_CHUNK = 16 * 1024;
+	constexpr size_t MAX_HANDOFF_FDS = 64;
+	constexpr int HANDOFF_TIMEOUT = 5;		//秒
+
+	bool sendHandoff(Socket conn, const HandoffHeader& header, const int* fds = nullptr, size_t numFds = 0)
+	{
+		iovec iov = { (void*)&header, sizeof(header) };
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		char control[CMSG_SPACE(sizeof(int) * MAX_HANDOFF_FDS)];
+		if (numFds)
+		{
+			msg.msg_control = control;
+			msg.msg_controllen = CMSG_SPACE(sizeof(int) * numFds);
+			cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(int) * numFds);
+			memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * numFds);
+		}
+		if (sendmsg(conn, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(header))
+		{
+			spdlog::error("send handoff message error: {}", strerror(errno));
+			return false;
+		}
+		return true;
+	}
+
+	bool recvHandoff(Socket conn, HandoffHeader& header, std::vector<int>& fds)
+	{
+		fds.clear();
+		iovec iov = { &header, sizeof(header) };
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		char control[CMSG_SPACE(sizeof(int) * MAX_HANDOFF_FDS)];
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		ssize_t length = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+		for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); length > 0 && cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+			{
+				size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+				fds.resize(count);
+				memcpy(fds.data(), CMSG_DATA(cmsg), sizeof(int) * count);
+			}
+		}
+		if (length != (ssize_t)sizeof(header))
+		{
+			spdlog::error("receive handoff message error: {}", length < 0 ? strerror(errno) : "truncated");
+			for (int fd : fds)
+			{
+				close(fd);
+			}
+			fds.clear();
+			return false;
+		}
+		return true;
+	}
+
+	// 按HANDOFF_CHUNK分段接收length字节，每段交给callback
+	template<class Callback>
+	bool recvHandoffData(Socket conn, size_t length, Callback&& callback)
+	{
+		char buffer[HANDOFF_CHUNK];
+		while (length)
+		{
+			ssize_t received = recv(conn, buffer, sizeof(buffer), 0);
+			if (received <= 0 || (size_t)received > length)
+			{
+				spdlog::error("receive handoff data error: {}", received < 0 ? strerror(errno) : "unexpected length");
+				return false;
+			}
+			callback(buffer, (size_t)received);
+			length -= received;
+		}
+		return true;
+	}
+
+	bool sendHandoffData(Socket conn, const void* data, size_t length)
+	{
+		for (size_t offset = 0; offset < length; offset += HANDOFF_CHUNK)
+		{
+			size_t chunk = std::min(HANDOFF_CHUNK, length - offset);
+			if (send(conn, (const char*)data + offset, chunk, MSG_NOSIGNAL) != (ssize_t)chunk)
+			{
+				spdlog::error("send handoff data error: {}", strerror(errno));
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void setHandoffTimeout(Socket conn)
+	{
+		timeval timeout = { HANDOFF_TIMEOUT, 0 };
+		setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+		setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	}
+
+	bool makeUnixAddr(const std::string& path, sockaddr_un& addr)
+	{
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(addr.sun_path))
+		{
+			spdlog::error("unix socket path is too long: {}", path);
+			return false;
+		}
+		memcpy(addr.sun_path, path.c_str(), path.size());
+		return true;
+	}
+}
+
+// socket thread, 停止accept并关闭本进程的监听socket，已交给新进程的副本不受影响
+void ServerSocket::stopAccepting(Reactor& reactor)
+{
+	if (reactor.listenSocket == -1)
+	{
+		return;
+	}
+	if (reactor.ring)
+	{
+		// 取消持续的accept，正在进行的accept持有socket的引用，取消完成后才真正释放
+		io_uring_sqe* sqe = reactor.ring->getSqe();
+		if (sqe)
+		{
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->fd = -1;
+			sqe->addr = makeUserData(URING_ACCEPT);
+			sqe->user_data = makeUserData(URING_CANCEL);
+		}
+	}
+	else
+	{
+		epoll_ctl(reactor.epfd, EPOLL_CTL_DEL, reactor.listenSocket, nullptr);
+		reactor.hasPendingAccept = false;
+	}
+	close(reactor.listenSocket);
+	reactor.listenSocket = -1;
+}
+
+// main thread, 在I/O线程中执行task并等待完成
+void ServerSocket::runOnReactor(Reactor& reactor, const std::function<void()>& task)
+{
+	if (config.pollInUpdate)
+	{
+		task();
+		return;
+	}
+	std::promise<void> done;
+	IOCommand command;
+	command.task = [&task, &done]()
+		{
+			task();
+			done.set_value();
+		};
+	postCommand(reactor.index, std::move(command));
+	done.get_future().wait();
+}
+
+// main thread
+void ServerSocket::drain(uint64_t timeout)
+{
+	if (isDraining() || !isRunning)
+	{
+		return;
+	}
+	spdlog::info("server on port {} is draining {} clients", config.listenPort, allClients.size());
+	drainDeadline = TimeTool::getTickCount() + std::max<uint64_t>(timeout, 1);
+	for (auto& reactor : reactors)
+	{
+		Reactor* ptr = reactor.get();
+		post([this, ptr]() { stopAccepting(*ptr); }, ptr->index);
+	}
+	// 回调中可能断开连接
+	auto clients = allClients;
+	for (auto& client : clients)
+	{
+		if (client->server && !client->isClosing)
+		{
+			client->onDrain();
+		}
+	}
+}
+
+// main thread, 待发送的数据全部发出后断开，超时则全部断开
+void ServerSocket::updateDrain(uint64_t now)
+{
+	bool isTimeout = now >= drainDeadline;
+	for (auto& client : allClients)
+	{
+		if (!client->isClosing && (isTimeout || (!client->pendingSendBytes() && !client->isDirty)))
+		{
+			client->kick();
+		}
+	}
+}
+
+// main thread
+bool ServerSocket::listenHandoff(const std::string& path, bool migrateClients, uint64_t drainTimeout)
+{
+	sockaddr_un addr;
+	if (!isRunning || handoffSocket != -1 || !makeUnixAddr(path, addr))
+	{
+		return false;
+	}
+	// 上次异常退出残留的文件
+	unlink(path.c_str());
+	handoffSocket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (handoffSocket == -1 || bind(handoffSocket, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(handoffSocket, 1) != 0)
+	{
+		spdlog::error("listen handoff socket {} error: {}", path, strerror(errno));
+		if (handoffSocket != -1)
+		{
+			close(handoffSocket);
+			handoffSocket = -1;
+		}
+		return false;
+	}
+	handoffPath = path;
+	isMigrateClients = migrateClients;
+	handoffDrainTimeout = drainTimeout;
+	return true;
+}
+
+// main thread, 新进程连接后交出监听socket和连接，之后开始drain
+void ServerSocket::checkHandoff()
+{
+	Socket conn = accept4(handoffSocket, nullptr, nullptr, SOCK_CLOEXEC);
+	if (conn == -1)
+	{
+		return;
+	}
+	setHandoffTimeout(conn);
+	std::vector<int> listenSockets;
+	for (auto& reactor : reactors)
+	{
+		if (reactor->listenSocket != -1)
+		{
+			listenSockets.push_back(reactor->listenSocket);
+		}
+	}
+	HandoffHeader header;
+	header.type = HANDOFF_LISTEN;
+	bool result = !listenSockets.empty() && sendHandoff(conn, header, listenSockets.data(), listenSockets.size());
+	// unix socket文件由新进程继续使用
+	if (result)
+	{
+		isUnixPathOwner = false;
+	}
+	// 只有epoll后端且未加密的连接可以在收发途中交出
+	if (result && isMigrateClients && config.ioBackend == IOBackend::EPOLL && !tlsContext)
+	{
+		result = migrateClients(conn);
+	}
+	header.type = HANDOFF_END;
+	result = result && sendHandoff(conn, header);
+	spdlog::info("handoff port {} to new process, result={}", config.listenPort, result);
+	close(conn);
+	close(handoffSocket);
+	handoffSocket = -1;
+	unlink(handoffPath.c_str());
+	drain(handoffDrainTimeout);
+}
+
+// socket thread, 把可以交出的连接移出reactor，socket保持打开
+void ServerSocket::detachClients(Reactor& reactor, std::vector<std::pair<ClientPtr, SendQueue>>& detached)
+{
+	for (auto iter = reactor.ioClients.begin(); iter != reactor.ioClients.end();)
+	{
+		auto& ioClient = iter->second;
+		// 零拷贝发送中的数据还在被内核使用
+		if (ioClient.isReleasing || ioClient.client->isClosing || ioClient.tls
+			|| !ioClient.zeroCopyPinned.empty() || ioClient.sending.hasFile())
+		{
+			++iter;
+			continue;
+		}
+		epoll_ctl(reactor.epfd, EPOLL_CTL_DEL, ioClient.client->socket, nullptr);
+		detached.emplace_back(std::move(ioClient.client), std::move(ioClient.sending));
+		iter = reactor.ioClients.erase(iter);
+	}
+}
+
+// main thread, 交出连接的socket、未处理的接收数据和未发出的数据，本进程随后移除这些客户端
+bool ServerSocket::migrateClients(Socket conn)
+{
+	std::vector<std::pair<ClientPtr, SendQueue>> detached;
+	for (auto& reactor : reactors)
+	{
+		Reactor* ptr = reactor.get();
+		runOnReactor(*ptr, [this, ptr, &detached]() { detachClients(*ptr, detached); });
+	}
+	bool result = true;
+	char buffer[HANDOFF_CHUNK];
+	for (auto& [client, sending] : detached)
+	{
+		// I/O线程已不再访问，剩余的接收数据都在recvQueue中
+		receiveData(*client);
+		sending.append(std::move(client->writerQueue));
+		if (result && !sending.hasFile())
+		{
+			HandoffHeader header;
+			header.type = HANDOFF_CLIENT;
+			header.recvLength = (uint32_t)client->readerBuffer.readAvailable();
+			header.sendLength = (uint32_t)sending.size();
+			header.addr = client->addr;
+			result = sendHandoff(conn, header, &client->socket, 1)
+				&& sendHandoffData(conn, client->readerBuffer.readerPointer(), header.recvLength);
+			while (result && !sending.empty())
+			{
+				size_t length = sending.readData(buffer, sizeof(buffer));
+				result = sendHandoffData(conn, buffer, length);
+			}
+		}
+		// 新进程持有socket的副本，这里只关闭不shutdown
+		close(client->socket);
+		sending.clear();
+		client->isClosing = true;
+		if (client->server)
+		{
+			removeFromTimeWheel(*client);
+			unregisterClient(*client);
+			destroyClient(client);
+		}
+	}
+	spdlog::info("migrated {} clients to new process", detached.size());
+	return result;
+}
+
+// main thread
+bool ServerSocket::takeOver(const std::string& path)
+{
+	sockaddr_un addr;
+	if (isRunning || !makeUnixAddr(path, addr))
+	{
+		return false;
+	}
+	Socket conn = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (conn == -1 || ::connect(conn, (sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		spdlog::info("no process to take over at {}", path);
+		if (conn != -1)
+		{
+			close(conn);
+		}
+		return false;
+	}
+	setHandoffTimeout(conn);
+	HandoffHeader header;
+	std::vector<int> fds;
+	if (!recvHandoff(conn, header, fds) || header.type != HANDOFF_LISTEN || fds.empty())
+	{
+		for (int fd : fds)
+		{
+			close(fd);
+		}
+		close(conn);
+		return false;
+	}
+	if (listenAddress.ss_family != AF_UNIX && config.numIOThreads && config.numIOThreads != fds.size())
+	{
+		spdlog::warn("take over {} listen sockets, ignore numIOThreads {}", fds.size(), config.numIOThreads);
+	}
+	if (!startReactors(fds))
+	{
+		close(conn);
+		return false;
+	}
+	isUnixPathOwner = listenAddress.ss_family == AF_UNIX && ((sockaddr_un&)listenAddress).sun_path[0];
+
+	size_t numMigrated = 0;
+	while (recvHandoff(conn, header, fds) && header.type == HANDOFF_CLIENT && fds.size() == 1)
+	{
+		auto client = addClient(fds[0], (sockaddr*)&header.addr, sizeof(header.addr), (uint16_t)(numMigrated++ % reactors.size()));
+		ByteArray received = bufferPool.alloc(std::max<size_t>(header.recvLength, 1));
+		bool result = recvHandoffData(conn, header.recvLength, [&received](const char* data, size_t length)
+			{
+				received.writeData(data, length);
+			});
+		result = result && recvHandoffData(conn, header.sendLength, [&client](const char* data, size_t length)
+			{
+				client->writerQueue.push(data, length);
+			});
+		// 旧进程未处理的数据在新数据之前交给update线程，未发出的数据排在新的响应之前
+		if (received.readAvailable())
+		{
+			pushRecvData(*client, std::move(received));
+		}
+		else
+		{
+			bufferPool.free(std::move(received));
+		}
+		if (!result)
+		{
+			client->isClosing = true;
+		}
+		IOCommand command;
+		command.client = client;
+		command.isAttach = true;
+		postCommand(client->ioIndex, std::move(command));
+	}
+	for (int fd : fds)
+	{
+		close(fd);
+	}
+	close(conn);
+	spdlog::info("took over port {} with {} io threads and {} clients", config.listenPort, reactors.size(), numMigrated);
+	return true;
+}
+
+#elif defined(__APPLE__)
+int ServerSocket::processEventThread()
+{
+    struct kevent ev_set[3];
+    struct kevent events[KEVENT_SIZE];
+    sockaddr_storage clientAddr;
+    socklen_t addrlen = sizeof(clientAddr);
+    while (isRunning)
+    {
+        int eventCount = kevent(kqfd, nullptr, 0, events, KEVENT_SIZE, nullptr);
+        if (eventCount == -1)
+        {
             spdlog::error("kqueue wait error={}", strerror(errno));
             return -1;
         }
@@ -668,6 +2244,7 @@ int ServerSocket::processEventThread()
                 spdlog::error("socket exception");
                 Client* client = (Client*)evt.udata;
                 client->isClosing = true;
+                markReady(*client);
                 break;
             }
             case EVFILT_READ:
@@ -676,7 +2253,8 @@ int ServerSocket::processEventThread()
                     int numAccepted = (int)evt.data;
                     for (int j = 0; j < numAccepted; ++j)
                     {
-                        Socket acceptedSocket = accept(listenSocket, &clientAddr, &addrlen);
+                        addrlen = sizeof(clientAddr);
+                        Socket acceptedSocket = accept(listenSocket, (sockaddr*)&clientAddr, &addrlen);
                         if (acceptedSocket == -1)
                         {
                             if (errno != EAGAIN && errno != EWOULDBLOCK)
@@ -688,7 +2266,13 @@ int ServerSocket::processEventThread()
                         if (numClients < config.maxConnection)
                         {
                             //setNonBlock(acceptedSocket);
-                            Client* client = addClient(acceptedSocket, (sockaddr_in&)clientAddr);
+                            // 对方关闭后写入返回EPIPE，不产生SIGPIPE
+                            int noSigPipe = 1;
+                            if (setsockopt(acceptedSocket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe)) != 0)
+                            {
+                                spdlog::error("set SO_NOSIGPIPE error: {}", strerror(errno));
+                            }
+                            Client* client = addClient(acceptedSocket, (sockaddr*)&clientAddr, addrlen).get();
                             EV_SET(&ev_set[0], acceptedSocket, EVFILT_READ, EV_ADD|EV_ENABLE, 0, 0, client);
                             EV_SET(&ev_set[1], acceptedSocket, EVFILT_WRITE, EV_ADD|EV_DISABLE, 0, 0, client);
                             EV_SET(&ev_set[2], acceptedSocket, EVFILT_EXCEPT, EV_ADD|EV_ENABLE, 0, 0, client);
@@ -709,7 +2293,8 @@ int ServerSocket::processEventThread()
                 }
                 break;
             case EVFILT_WRITE:
-                writeFromBuffer(*(Client*)evt.udata, (uint32_t)evt.data);
+                // 与linux等待EPOLLOUT一样，可写后才由update重新发送
+                markReady(*(Client*)evt.udata);
                 break;
             }
         }
@@ -750,7 +2335,7 @@ bool ServerSocket::startListen()
         spdlog::error("bind port {} error. errno={}", config.listenPort, errno);
         return false;
     }
-    result = listen(listenSocket, 100);
+    result = listen(listenSocket, config.listenBacklog);
     if (result < 0)
     {
         spdlog::error("listen port {} error.", config.listenPort);
@@ -804,13 +2389,19 @@ void ServerSocket::cleanup()
 	}
     close(pipe_fd[0]);
     close(pipe_fd[1]);
+    addingClients.consume([](ClientPtr&& client) { close(client->socket); });
     // disconnect all clients
     for (auto client : allClients)
     {
-        client.second->isClosing = true;
-        destroyClient(client.second);
+        client->isClosing = true;
+        destroyClient(client);
     }
     allClients.clear();
+    clientSlots.clear();
+    freeSlots.clear();
+    readyClients.consume([](ClientPtr&&) {});
+    dirtyClients.clear();
+    timeWheel.clear();
     numClients = 0;
     // close listen port
     //shutdown(listenSocket, SHUT_RDWR);
@@ -824,59 +2415,60 @@ void ServerSocket::readIntoBuffer(Client& client, uint32_t numBytes)
     {
         return;
     }
-    ByteArray& bytes = client.readerBuffer;
-	client.readerMtx.lock();
-    size_t oldSize = bytes.size();
-    bytes.expand(oldSize + numBytes);
-    ssize_t length = recv(client.socket, bytes.readerPointer(), numBytes, 0);
-	bytes.writePosition(oldSize + length);
-	client.readerMtx.unlock();
+    ByteArray bytes = bufferPool.alloc(numBytes);
+    ssize_t length = recv(client.socket, bytes.writerPointer(), numBytes, 0);
     if (length != numBytes)
     {
         spdlog::error("recv data error!");
     }
-    client.hasNewData = true;
+    if (length > 0)
+    {
+        bytes.writePosition(length);
+        pushRecvData(client, std::move(bytes));
+    }
 }
 
 // main thread
 void ServerSocket::flushClient(ClientPtr client)
 {
-	std::lock_guard<std::mutex> lock(client->writerMtx);
-    if (client->writerBuffer.size())
-    {
-        struct kevent evt;
-        EV_SET(&evt, client->socket, EVFILT_WRITE, EV_ENABLE, 0, 0, client.get());
-    }
+    writeFromBuffer(*client);
 }
 
-// socket thread
-void ServerSocket::writeFromBuffer(Client& client, uint32_t limitLength)
+// main thread
+void ServerSocket::writeFromBuffer(Client& client)
 {
     if (client.isClosing)
     {
         return;
     }
-    ByteArray& bytes = client.writerBuffer;
-	std::lock_guard<std::mutex> lock(client.writerMtx);
-    uint32_t available = bytes.readAvailable();
-    if (!available)
+    auto& queue = client.writerQueue;
+    if (queue.empty())
     {
         return;
     }
-    if (available > limitLength)
+    iovec iov[MAX_SEND_IOV];
+    int count = (int)queue.gather(iov, MAX_SEND_IOV);
+    ssize_t length = writev(client.socket, iov, count);
+    if (length < 0)
     {
-		available = limitLength;
+        // 发送缓冲区已满，等待EVFILT_WRITE，其他错误关闭连接
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            spdlog::error("send data error: {}", strerror(errno));
+            client.isClosing = true;
+            return;
+        }
     }
-    ssize_t length = send(client.socket, bytes.readerPointer(), available, 0);
-    if (length < 0 || length != limitLength)
+    else
     {
-        spdlog::error("send data error!");
+        queue.consume(length);
     }
-    bytes.cutHead(available);
-    if (!bytes.readAvailable())
+    if (!queue.empty())
     {
+        // 发送缓冲区已满，可写时通知一次
         struct kevent evt;
-        EV_SET(&evt, client.socket, EVFILT_WRITE, EV_DISABLE, 0, 0, client);
+        EV_SET(&evt, client.socket, EVFILT_WRITE, EV_ENABLE | EV_DISPATCH, 0, 0, &client);
+        kevent(kqfd, &evt, 1, nullptr, 0, nullptr);
     }
 }
 
@@ -926,101 +2518,542 @@ bool ServerSocket::init(const ServerConfig& cfg)
 	{
 		config.maxConnection = 5000;
 	}
+	if (config.sendHighWatermark && (!config.sendLowWatermark || config.sendLowWatermark > config.sendHighWatermark))
+	{
+		config.sendLowWatermark = config.sendHighWatermark / 2;
+	}
+	if (!frameDecoder.init(config.frame))
+	{
+		return false;
+	}
+	if (config.maxConnection > CLIENT_INDEX_MASK)
+	{
+		spdlog::warn("maxConnection {} exceeds the limit {}", config.maxConnection, CLIENT_INDEX_MASK);
+		config.maxConnection = CLIENT_INDEX_MASK;
+	}
+	if (config.listenBacklog <= 0)
+	{
+		config.listenBacklog = SOMAXCONN;
+	}
+	if (!config.maxAcceptsPerLoop)
+	{
+		config.maxAcceptsPerLoop = UINT32_MAX;
+	}
+	if (config.acceptRatePerIP && !config.acceptBurstPerIP)
+	{
+		config.acceptBurstPerIP = config.acceptRatePerIP;
+	}
+#ifdef __linux__
+	if (config.ioBackend == IOBackend::IO_URING && !IoUring::isSupported())
+	{
+		spdlog::warn("io_uring is not supported, fallback to epoll");
+		config.ioBackend = IOBackend::EPOLL;
+	}
+	if (config.pollInUpdate && (config.ioBackend != IOBackend::EPOLL || config.numIOThreads > 1))
+	{
+		spdlog::error("pollInUpdate only supports epoll backend with one io thread");
+		return false;
+	}
+	if (!resolveAddress(config.listenAddr, config.listenPort, listenAddress, listenAddressLength))
+	{
+		return false;
+	}
+	if (!config.tls.certFile.empty())
+	{
+		tlsContext = std::make_unique<TlsContext>();
+		if (!tlsContext->init(config.tls))
+		{
+			return false;
+		}
+	}
+#else
+	if (!config.tls.certFile.empty())
+	{
+		spdlog::error("tls is only supported on linux");
+		return false;
+	}
+	if (config.busyPoll || config.pollInUpdate)
+	{
+		spdlog::warn("busy poll is only supported on linux");
+	}
+#endif
 	return true;
 }
 
 // main thread
 void ServerSocket::update()
 {
-	if (!addingClients.empty())
+	uint64_t startTime = getMicroTime();
+#ifdef __linux__
+	// 在本线程收取I/O事件，accept的连接本帧即可创建
+	if (config.pollInUpdate && isRunning)
 	{
-		std::lock_guard<std::mutex> lock(addMtx);
-		for (auto &client : addingClients)
+		pollReactor(*reactors[0], 0);
+	}
+	// 在update线程创建客户端，再交给对应的I/O线程开始收发
+	uint32_t numAccepted = (uint32_t)acceptedSockets.consume([this](AcceptedSocket&& accepted)
+		{
+			IOCommand command;
+			command.client = addClient(accepted.socket, (sockaddr*)&accepted.addr, sizeof(accepted.addr), accepted.ioIndex);
+			command.isAttach = true;
+			postCommand(accepted.ioIndex, std::move(command));
+		});
+#endif
+	addingClients.consume([this](ClientPtr&& client)
 		{
-			client->id = getNextClientID();
+			registerClient(client);
+			client->server = this;
+			client->connectTime = TimeTool::getTickCount();
 			if (config.onClientConnected)
 			{
 				config.onClientConnected(client);
 			}
-			allClients.insert(std::make_pair(client->id, client));
-		}
-		addingClients.clear();
-	}
+			if (config.kickTime)
+			{
+				addToTimeWheel(*client, client->lastActiveTime + config.kickTime);
+			}
+			// 加入前收到的数据被跳过了，重新标记
+			markReady(*client);
+		});
 	uint64_t now = TimeTool::getTickCount();
-	auto iter = allClients.begin();
-	while (iter != allClients.end())
-	{
-		auto &client = iter->second;
-		if (client->hasNewData)
+	// 只处理I/O线程标记过的客户端
+	readyClients.consume([this, now](ClientPtr&& client)
 		{
-			client->hasNewData = false;
-			client->lastActiveTime = now;
-			client->onRecv();
-		}
-		else if (config.kickTime && now - client->lastActiveTime > config.kickTime)
+			client->isReady = false;
+			// 尚未加入或已销毁
+			if (!client->server)
+			{
+				return;
+			}
+			// 先取出时间再取数据，之后到达的数据重新计时
+			uint64_t queuedTime = client->recvQueuedTime.exchange(0);
+			if (receiveData(*client))
+			{
+				client->lastActiveTime = now;
+				if (queuedTime)
+				{
+					stats.queueTime.record(getMicroTime() - queuedTime);
+				}
+				if (frameDecoder.isEnabled())
+				{
+					decodeFrames(*client);
+				}
+				else
+				{
+					++client->statPacketsIn;
+					++stats.packetsIn;
+					client->onRecv();
+				}
+				// 已读完的接收缓冲区归还，空闲连接不占用缓冲区
+				if (!client->readerBuffer.readAvailable())
+				{
+					ByteArray empty(nullptr, 0);
+					empty.swap(client->readerBuffer);
+					bufferPool.free(std::move(empty));
+				}
+			}
+			// 可写或需要关闭
+			markDirty(*client);
+		});
+	kickIdleClients(now);
+#ifdef __linux__
+	if (handoffSocket != -1)
+	{
+		checkHandoff();
+	}
+	if (isDraining())
+	{
+		updateDrain(now);
+	}
+#endif
+	// 只处理有待发送数据或需要关闭的客户端，处理期间新标记的留到下一帧
+	flushingClients.swap(dirtyClients);
+	for (auto& client : flushingClients)
+	{
+		client->isDirty = false;
+		if (!client->server)
 		{
-			client->isClosing = true;
+			continue;
 		}
 		flushClient(client);
+		checkLowWatermark(*client);
 		if (client->isClosing)
 		{
+			removeFromTimeWheel(*client);
+			unregisterClient(*client);
 			destroyClient(client);
-			iter = allClients.erase(iter);
-		}
-		else
-		{
-			++iter;
+			stats.lifetime.record(now - client->connectTime);
 		}
 	}
-	numClients = (uint16_t)allClients.size();
+	flushingClients.clear();
+	numClients = (uint32_t)allClients.size();
+#ifdef __linux__
+	numAccepting -= numAccepted;
+	// 本帧交给I/O的数据立即发出，不等到下一帧
+	if (config.pollInUpdate && isRunning)
+	{
+		processCommands(*reactors[0]);
+	}
+#endif
+	++stats.numUpdates;
+	stats.updateTime.record(getMicroTime() - startTime);
 }
 
-// socket threads
-Client* ServerSocket::addClient(Socket sock, const sockaddr_in &addr)
+// socket threads, linux下为main thread
+ClientPtr ServerSocket::addClient(Socket sock, const sockaddr* addr, socklen_t addrLength, uint16_t ioIndex /*= 0*/)
 {
 	auto client = config.createClient();
-	client->server = this;
+	client->ioIndex = ioIndex;
 	client->lastActiveTime = TimeTool::getTickCount();
 	client->socket = sock;
-	client->addr = addr;
+	memcpy(&client->addr, addr, std::min<size_t>(addrLength, sizeof(client->addr)));
+	if (config.tcpNoDelay && addr->sa_family != AF_UNIX)
+	{
+		int optval = 1;
+		setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&optval, sizeof(optval));
+	}
+	addingClients.push(ClientPtr(client));
+	return client;
+}
+
+// socket threads
+void ServerSocket::pushRecvData(Client& client, ByteArray&& data)
+{
+	addCount(client.statBytesIn, data.size());
+	addCount(statBytesIn, data.size());
+	// 只记录队列中最早的数据到达的时间
+	uint64_t expected = 0;
+	client.recvQueuedTime.compare_exchange_strong(expected, getMicroTime());
+	client.recvQueue.push(std::move(data));
+	markReady(client);
+}
+
+// main thread and socket threads
+void ServerSocket::markReady(Client& client)
+{
+	// 已在就绪列表中则不重复加入
+	if (!client.isReady.exchange(true))
+	{
+		readyClients.push(client.shared_from_this());
+	}
+}
+
+// main thread
+void ServerSocket::markDirty(Client& client)
+{
+	if (!client.isDirty)
+	{
+		client.isDirty = true;
+		dirtyClients.push_back(client.shared_from_this());
+	}
+}
+
+// main thread
+bool ServerSocket::checkSendLimit(Client& client, size_t length)
+{
+	if (!config.maxSendBytes || client.pendingSendBytes() + length <= config.maxSendBytes)
+	{
+		return true;
+	}
+	if (config.sendOverflowPolicy == SendOverflowPolicy::KICK && !client.isClosing)
+	{
+		spdlog::warn("client {} exceeds max send bytes {}, kicked", client.id, config.maxSendBytes);
+		client.kick();
+	}
+	return false;
+}
+
+// main thread
+void ServerSocket::onSendQueued(Client& client)
+{
+	markDirty(client);
+	++client.statPacketsOut;
+	++stats.packetsOut;
+	size_t pendingBytes = client.pendingSendBytes();
+	client.statMaxPending = std::max(client.statMaxPending, pendingBytes);
+	stats.maxPendingBytes = std::max(stats.maxPendingBytes, pendingBytes);
+	if (config.sendHighWatermark && !client.isSendBlocked && client.pendingSendBytes() >= config.sendHighWatermark)
+	{
+		client.isSendBlocked = true;
+		client.onBackpressure();
+	}
+}
+
+// socket threads
+void ServerSocket::onSendCompleted(Client& client, size_t length)
+{
+	addCount(client.statBytesOut, length);
+	addCount(statBytesOut, length);
+	size_t sendingBytes = client.sendingBytes -= length;
+	// 回落到低水位以下时通知update线程检查
+	if (client.isSendBlocked && sendingBytes <= config.sendLowWatermark)
+	{
+		markReady(client);
+	}
+}
+
+// main thread
+void ServerSocket::checkLowWatermark(Client& client)
+{
+	if (client.isSendBlocked && client.pendingSendBytes() <= config.sendLowWatermark)
+	{
+		client.isSendBlocked = false;
+		client.onWritable();
+	}
+}
+
+// main thread
+void ServerSocket::addToTimeWheel(Client& client, uint64_t expireTime)
+{
+	if (timeWheel.empty())
+	{
+		timeWheel.resize(TIME_WHEEL_SIZE);
+		wheelSlotTime = config.kickTime / TIME_WHEEL_SIZE + 1;
+		wheelTime = TimeTool::getTickCount() / wheelSlotTime * wheelSlotTime;
+	}
+	// 已过期的放到下一个待处理的槽
+	expireTime = std::max(expireTime, wheelTime);
+	client.wheelSlot = (uint32_t)(expireTime / wheelSlotTime % TIME_WHEEL_SIZE);
+	auto& slot = timeWheel[client.wheelSlot];
+	client.wheelPos = (uint32_t)slot.size();
+	slot.push_back(&client);
+}
+
+// main thread
+void ServerSocket::removeFromTimeWheel(Client& client)
+{
+	if (client.wheelSlot == UINT32_MAX)
+	{
+		return;
+	}
+	// 与槽尾交换后删除
+	auto& slot = timeWheel[client.wheelSlot];
+	slot[client.wheelPos] = slot.back();
+	slot[client.wheelPos]->wheelPos = client.wheelPos;
+	slot.pop_back();
+	client.wheelSlot = UINT32_MAX;
+}
+
+// main thread
+void ServerSocket::kickIdleClients(uint64_t now)
+{
+	if (timeWheel.empty())
+	{
+		return;
+	}
+	// 落后超过一圈时每个槽只处理一次
+	uint64_t wheelSpan = wheelSlotTime * TIME_WHEEL_SIZE;
+	if (now >= wheelTime + wheelSpan)
+	{
+		wheelTime = (now - wheelSpan) / wheelSlotTime * wheelSlotTime + wheelSlotTime;
+	}
+	std::vector<Client*> expired;
+	while (wheelTime + wheelSlotTime <= now)
+	{
+		expired.swap(timeWheel[wheelTime / wheelSlotTime % TIME_WHEEL_SIZE]);
+		wheelTime += wheelSlotTime;
+		for (auto client : expired)
+		{
+			client->wheelSlot = UINT32_MAX;
+			if (now - client->lastActiveTime > config.kickTime)
+			{
+				client->kick();
+				continue;
+			}
+			// 期间有活动，按最后活跃时间重新放入
+			addToTimeWheel(*client, client->lastActiveTime + config.kickTime);
+		}
+		expired.clear();
+	}
+}
 
-	std::lock_guard<std::mutex> lock(addMtx);
-	//client->id = ++nextClientID;
-	addingClients.push_back(client);
-	return client.get();
+// main thread
+bool ServerSocket::receiveData(Client& client)
+{
+	return client.recvQueue.consume([this, &client](ByteArray&& data)
+		{
+			// 缓冲区为空时直接接管数据块，不复制
+			if (!client.readerBuffer.size())
+			{
+				client.readerBuffer.swap(data);
+			}
+			else
+			{
+				client.readerBuffer.writeData(data.data(), data.size());
+			}
+			bufferPool.free(std::move(data));
+		}) > 0;
 }
 
 // main thread
-ClientPtr ServerSocket::getClient(uint16_t clientID)
+ClientPtr ServerSocket::getClient(uint32_t clientID)
 {
-	auto iter = allClients.find(clientID);
-	if (iter != allClients.end())
+	uint32_t slotIndex = clientID & CLIENT_INDEX_MASK;
+	if (slotIndex >= clientSlots.size())
 	{
-		return iter->second;
+		return nullptr;
 	}
-	return nullptr;
+	// 代数不同说明id对应的客户端已断开
+	auto& slot = clientSlots[slotIndex];
+	if (slot.index == INVALID_CLIENT_INDEX || slot.generation != clientID >> CLIENT_INDEX_BITS)
+	{
+		return nullptr;
+	}
+	return allClients[slot.index];
 }
 
 // main thread
-bool ServerSocket::kickClient(uint16_t clientID)
+bool ServerSocket::kickClient(uint32_t clientID)
 {
 	ClientPtr client = getClient(clientID);
 	if (!client)
 	{
 		return false;
 	}
-	client->isClosing = true;
+	client->kick();
 	return true;
 }
 
 // main thread
-uint16_t ServerSocket::getNextClientID()
+void ServerSocket::broadcast(PacketPtr packet)
+{
+	for (auto& client : allClients)
+	{
+		client->send(packet);
+	}
+}
+
+// main thread
+void ServerSocket::broadcast(PacketPtr packet, std::span<const uint32_t> clientIDs)
+{
+	for (auto id : clientIDs)
+	{
+		if (auto client = getClient(id))
+		{
+			client->send(packet);
+		}
+	}
+}
+
+// main thread
+void ServerSocket::broadcast(PacketPtr packet, const std::function<bool(const ClientPtr&)>& filter)
+{
+	for (auto& client : allClients)
+	{
+		if (filter(client))
+		{
+			client->send(packet);
+		}
+	}
+}
+
+// main thread
+void ServerSocket::decodeFrames(Client& client)
+{
+	auto& buffer = client.readerBuffer;
+	std::span<const uint8_t> frame;
+	size_t consumed = 0;
+	// 一次处理缓冲区中所有完整的帧
+	while (buffer.readAvailable() && !client.isClosing)
+	{
+		std::span<const uint8_t> data((const uint8_t*)buffer.readerPointer(), buffer.readAvailable());
+		auto result = frameDecoder.next(data, client.frameScanned, frame, consumed);
+		if (result == FrameResult::INCOMPLETE)
+		{
+			break;
+		}
+		if (result == FrameResult::INVALID)
+		{
+			spdlog::error("invalid frame from client {}, {} bytes pending", client.id, data.size());
+			client.kick();
+			break;
+		}
+		++client.statPacketsIn;
+		++stats.packetsIn;
+		client.onPacket(frame);
+		buffer.seek((int)consumed);
+	}
+	// 未完成的帧移到缓冲区头部
+	if (buffer.readPosition() && buffer.readAvailable())
+	{
+		buffer.cutHead(buffer.readPosition());
+	}
+}
+
+// main thread
+MemoryStats ServerSocket::getMemoryStats() const
+{
+	MemoryStats stats;
+	stats.numClients = allClients.size();
+	for (auto& client : allClients)
+	{
+		stats.readerBytes += client->readerBuffer.capacity();
+		stats.writerBytes += client->writerQueue.size();
+	}
+	stats.pooledBytes = bufferPool.pooledBytes();
+	if (stats.numClients)
+	{
+		stats.bytesPerClient = (stats.readerBytes + stats.writerBytes) / stats.numClients;
+	}
+	return stats;
+}
+
+// main thread
+NetStats ServerSocket::getNetStats() const
+{
+	NetStats result = stats;
+	result.bytesIn = statBytesIn.load(std::memory_order_relaxed);
+	result.bytesOut = statBytesOut.load(std::memory_order_relaxed);
+#ifdef __linux__
+	for (auto& reactor : reactors)
+	{
+		result.syscalls += reactor->syscalls.load(std::memory_order_relaxed);
+		result.recvEagain += reactor->recvEagain.load(std::memory_order_relaxed);
+		result.sendEagain += reactor->sendEagain.load(std::memory_order_relaxed);
+		if (reactor->ring)
+		{
+			result.syscalls += reactor->ring->numEnters();
+		}
+	}
+#endif
+	return result;
+}
+
+// main thread
+void ServerSocket::registerClient(const ClientPtr& client)
+{
+	uint32_t slotIndex;
+	if (!freeSlots.empty())
+	{
+		slotIndex = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slotIndex = (uint32_t)clientSlots.size();
+		clientSlots.emplace_back();
+	}
+	auto& slot = clientSlots[slotIndex];
+	// 代数从1开始，保证id不为0
+	slot.generation = slot.generation % MAX_CLIENT_GENERATION + 1;
+	slot.index = (uint32_t)allClients.size();
+	client->id = slot.generation << CLIENT_INDEX_BITS | slotIndex;
+	allClients.push_back(client);
+}
+
+// main thread
+void ServerSocket::unregisterClient(Client& client)
 {
-	static uint16_t nextID = 0;
-	do 
+	uint32_t slotIndex = client.id & CLIENT_INDEX_MASK;
+	auto& slot = clientSlots[slotIndex];
+	// 末尾的客户端移到空出的位置
+	if (slot.index != allClients.size() - 1)
 	{
-		++nextID;
+		auto& moved = allClients[slot.index];
+		moved = std::move(allClients.back());
+		clientSlots[moved->id & CLIENT_INDEX_MASK].index = slot.index;
 	}
-	while (allClients.find(nextID) != allClients.end());
-	return nextID;
+	allClients.pop_back();
+	slot.index = INVALID_CLIENT_INDEX;
+	freeSlots.push_back(slotIndex);
 }
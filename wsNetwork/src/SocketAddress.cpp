@@ -0,0 +1,92 @@
+#include <stddef.h>
+#include <string.h>
+#include <spdlog/spdlog.h>
+#include "ws/network/SocketAddress.h"
+#ifndef _WIN32
+#include <sys/un.h>
+#endif
+
+using namespace ws::network;
+
+bool ws::network::resolveAddress(const std::string& address, uint16_t port, sockaddr_storage& result, socklen_t& length)
+{
+	memset(&result, 0, sizeof(result));
+	if (address.starts_with(UNIX_ADDRESS_PREFIX))
+	{
+#ifdef _WIN32
+		spdlog::error("unix socket is not supported: {}", address);
+		return false;
+#else
+		std::string path = address.substr(sizeof(UNIX_ADDRESS_PREFIX) - 1);
+		auto& unixAddr = (sockaddr_un&)result;
+		if (path.empty() || path.size() >= sizeof(unixAddr.sun_path))
+		{
+			spdlog::error("invalid unix socket path: {}", address);
+			return false;
+		}
+		unixAddr.sun_family = AF_UNIX;
+		memcpy(unixAddr.sun_path, path.data(), path.size());
+		length = (socklen_t)(offsetof(sockaddr_un, sun_path) + path.size());
+		if (path[0] == '@')
+		{
+#ifdef __linux__
+			// 抽象地址以\0开头，长度不包含结尾的\0
+			unixAddr.sun_path[0] = '\0';
+#else
+			spdlog::error("abstract unix socket is only supported on linux: {}", address);
+			return false;
+#endif
+		}
+		else
+		{
+			++length;
+		}
+		return true;
+#endif
+	}
+
+	auto& addr6 = (sockaddr_in6&)result;
+	if (inet_pton(AF_INET6, address.c_str(), &addr6.sin6_addr) == 1)
+	{
+		addr6.sin6_family = AF_INET6;
+		addr6.sin6_port = htons(port);
+		length = sizeof(sockaddr_in6);
+		return true;
+	}
+	auto& addr4 = (sockaddr_in&)result;
+	if (address.empty() || inet_pton(AF_INET, address.c_str(), &addr4.sin_addr) == 1)
+	{
+		addr4.sin_family = AF_INET;
+		addr4.sin_port = htons(port);
+		length = sizeof(sockaddr_in);
+		return true;
+	}
+	spdlog::error("invalid address: {}", address);
+	return false;
+}
+
+std::string ws::network::formatAddress(const sockaddr_storage& address)
+{
+	char buffer[INET6_ADDRSTRLEN] = { 0 };
+	if (address.ss_family == AF_INET)
+	{
+		inet_ntop(AF_INET, (void*)&((const sockaddr_in&)address).sin_addr, buffer, sizeof(buffer));
+	}
+	else if (address.ss_family == AF_INET6)
+	{
+		auto& addr6 = ((const sockaddr_in6&)address).sin6_addr;
+		if (IN6_IS_ADDR_V4MAPPED(&addr6))
+		{
+			inet_ntop(AF_INET, (void*)&addr6.s6_addr[12], buffer, sizeof(buffer));
+		}
+		else
+		{
+			inet_ntop(AF_INET6, (void*)&addr6, buffer, sizeof(buffer));
+		}
+	}
+	else if (address.ss_family == AF_UNIX)
+	{
+		return "unix";
+	}
+	return buffer;
+}
@@ -0,0 +1,387 @@
+#include <string.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/kdf.h>
+#include <openssl/evp.h>
+#include <spdlog/spdlog.h>
+#include "ws/network/TlsContext.h"
+#ifdef __linux__
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#endif
+
+using namespace ws::network;
+using ws::core::ByteArray;
+
+namespace
+{
+	constexpr size_t RECORD_HEADER_SIZE = 5;
+	constexpr size_t MAX_RECORD_SIZE = 16384;
+
+	std::string lastError()
+	{
+		char buffer[256];
+		ERR_error_string_n(ERR_get_error(), buffer, sizeof(buffer));
+		return buffer;
+	}
+
+	void keyLogCallback(const SSL* ssl, const char* line)
+	{
+		if (auto connection = (TlsConnection*)SSL_get_app_data(ssl))
+		{
+			connection->onKeyLog(line);
+		}
+	}
+
+#ifdef __linux__
+	// TLS1.3的HKDF-Expand-Label，context为空
+	bool expandLabel(const EVP_MD* md, const std::vector<uint8_t>& secret, const char* label, uint8_t* out, size_t length)
+	{
+		std::string fullLabel = std::string("tls13 ") + label;
+		std::vector<uint8_t> info;
+		info.push_back((uint8_t)(length >> 8));
+		info.push_back((uint8_t)length);
+		info.push_back((uint8_t)fullLabel.size());
+		info.insert(info.end(), fullLabel.begin(), fullLabel.end());
+		info.push_back(0);
+		EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+		bool result = pctx && EVP_PKEY_derive_init(pctx) > 0
+			&& EVP_PKEY_CTX_set_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0
+			&& EVP_PKEY_CTX_set_hkdf_md(pctx, md) > 0
+			&& EVP_PKEY_CTX_set1_hkdf_key(pctx, secret.data(), (int)secret.size()) > 0
+			&& EVP_PKEY_CTX_add1_hkdf_info(pctx, info.data(), (int)info.size()) > 0
+			&& EVP_PKEY_derive(pctx, out, &length) > 0;
+		EVP_PKEY_CTX_free(pctx);
+		return result;
+	}
+
+	template<class CryptoInfo>
+	bool setKtlsKey(Socket sock, uint16_t cipherType, const EVP_MD* md, const std::vector<uint8_t>& secret, uint64_t sequence)
+	{
+		CryptoInfo info;
+		memset(&info, 0, sizeof(info));
+		info.info.version = TLS_1_3_VERSION;
+		info.info.cipher_type = cipherType;
+		// 12字节的iv前4字节为salt，后8字节为iv
+		uint8_t iv[sizeof(info.salt) + sizeof(info.iv)];
+		if (!expandLabel(md, secret, "key", info.key, sizeof(info.key)) || !expandLabel(md, secret, "iv", iv, sizeof(iv)))
+		{
+			return false;
+		}
+		memcpy(info.salt, iv, sizeof(info.salt));
+		memcpy(info.iv, iv + sizeof(info.salt), sizeof(info.iv));
+		for (size_t i = 0; i < sizeof(info.rec_seq); ++i)
+		{
+			info.rec_seq[i] = (uint8_t)(sequence >> ((sizeof(info.rec_seq) - 1 - i) * 8));
+		}
+		bool result = setsockopt(sock, SOL_TLS, TLS_TX, &info, sizeof(info)) == 0;
+		OPENSSL_cleanse(&info, sizeof(info));
+		OPENSSL_cleanse(iv, sizeof(iv));
+		return result;
+	}
+#endif
+}
+
+//===================== TlsContext Implements ========================
+TlsContext::~TlsContext()
+{
+	SSL_CTX_free(ctx);
+}
+
+bool TlsContext::init(const TlsConfig& cfg)
+{
+	config = cfg;
+	ctx = SSL_CTX_new(TLS_server_method());
+	if (!ctx)
+	{
+		spdlog::error("create ssl context error: {}", lastError());
+		return false;
+	}
+	SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+	if (SSL_CTX_use_certificate_chain_file(ctx, config.certFile.c_str()) != 1
+		|| SSL_CTX_use_PrivateKey_file(ctx, config.keyFile.c_str(), SSL_FILETYPE_PEM) != 1
+		|| SSL_CTX_check_private_key(ctx) != 1)
+	{
+		spdlog::error("load certificate {} error: {}", config.certFile, lastError());
+		return false;
+	}
+	// 服务端缓存会话，票据密钥由所有I/O线程共享
+	static const unsigned char SESSION_ID_CONTEXT[] = "libws";
+	SSL_CTX_set_session_id_context(ctx, SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT) - 1);
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_sess_set_cache_size(ctx, config.sessionCacheSize);
+	SSL_CTX_set_timeout(ctx, config.sessionTimeout);
+	if (!config.sessionTickets)
+	{
+		SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+	}
+	SSL_CTX_set_mode(ctx, SSL_MODE_RELEASE_BUFFERS);
+#ifdef __linux__
+	if (config.enableKtls)
+	{
+		SSL_CTX_set_keylog_callback(ctx, keyLogCallback);
+	}
+#else
+	config.enableKtls = false;
+#endif
+	return true;
+}
+
+//===================== TlsConnection Implements ========================
+TlsConnection::TlsConnection(TlsContext& context)
+{
+	ssl = SSL_new(context.get());
+	rbio = BIO_new(BIO_s_mem());
+	wbio = BIO_new(BIO_s_mem());
+	// 数据读完时返回重试而不是EOF
+	BIO_set_mem_eof_return(rbio, -1);
+	BIO_set_mem_eof_return(wbio, -1);
+	SSL_set_bio(ssl, rbio, wbio);
+	SSL_set_accept_state(ssl);
+	SSL_set_app_data(ssl, this);
+	wantKtls = context.isKtlsEnabled();
+}
+
+TlsConnection::~TlsConnection()
+{
+	// 同时释放两个BIO
+	SSL_free(ssl);
+	OPENSSL_cleanse(serverSecret.data(), serverSecret.size());
+}
+
+// socket thread
+bool TlsConnection::feed(const void* data, size_t length, SendQueue& output)
+{
+	if (length && BIO_write(rbio, data, (int)length) != (int)length)
+	{
+		return false;
+	}
+	if (!handshakeDone)
+	{
+		int result = SSL_do_handshake(ssl);
+		if (result == 1)
+		{
+			// 完成握手时生成的会话票据已经使用应用流量密钥，flushOutput中计数
+			handshakeDone = true;
+			onHandshakeDone();
+		}
+		else
+		{
+			int error = SSL_get_error(ssl, result);
+			if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE)
+			{
+				spdlog::debug("tls handshake error: {}", lastError());
+				flushOutput(output);
+				return false;
+			}
+		}
+	}
+	if (!flushOutput(output))
+	{
+		return false;
+	}
+	if (handshakeDone && !pending.empty())
+	{
+		SendQueue plain(std::move(pending));
+		return encrypt(plain, output);
+	}
+	return true;
+}
+
+// socket thread
+int TlsConnection::read(void* buffer, size_t length)
+{
+	if (!handshakeDone)
+	{
+		return 0;
+	}
+	size_t readBytes = 0;
+	if (SSL_read_ex(ssl, buffer, length, &readBytes) == 1)
+	{
+		return (int)readBytes;
+	}
+	int error = SSL_get_error(ssl, 0);
+	if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+	{
+		return 0;
+	}
+	if (error != SSL_ERROR_ZERO_RETURN)
+	{
+		spdlog::debug("tls read error: {}", lastError());
+	}
+	return -1;
+}
+
+// socket thread
+bool TlsConnection::encrypt(SendQueue& plain, SendQueue& output)
+{
+	if (!handshakeDone)
+	{
+		pending.append(std::move(plain));
+		return true;
+	}
+#ifndef _WIN32
+	iovec iov[MAX_SEND_IOV];
+	while (!plain.empty())
+	{
+#ifdef __linux__
+		// 文件先读入再加密
+		int fileFd = -1;
+		off_t fileOffset = 0;
+		size_t fileLength = 0;
+		if (plain.frontFile(fileFd, fileOffset, fileLength))
+		{
+			char buffer[MAX_RECORD_SIZE];
+			ssize_t readLength = pread(fileFd, buffer, std::min(fileLength, sizeof(buffer)), fileOffset);
+			if (readLength <= 0 || !write(buffer, readLength))
+			{
+				spdlog::error("read file for tls error: {}", readLength ? strerror(errno) : "unexpected end of file");
+				return false;
+			}
+			plain.consume(readLength);
+			continue;
+		}
+#endif
+		size_t count = plain.gather(iov, MAX_SEND_IOV);
+		size_t total = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (!write(iov[i].iov_base, iov[i].iov_len))
+			{
+				return false;
+			}
+			total += iov[i].iov_len;
+		}
+		plain.consume(total);
+	}
+#else
+	char buffer[MAX_RECORD_SIZE];
+	while (!plain.empty())
+	{
+		size_t length = plain.readData(buffer, sizeof(buffer));
+		if (!write(buffer, length))
+		{
+			return false;
+		}
+	}
+#endif
+	return flushOutput(output);
+}
+
+// socket thread
+bool TlsConnection::flushOutput(SendQueue& output)
+{
+	size_t length = BIO_ctrl_pending(wbio);
+	if (!length)
+	{
+		return true;
+	}
+	ByteArray bytes(length);
+	int readLength = BIO_read(wbio, bytes.data(), (int)length);
+	if (readLength <= 0)
+	{
+		return true;
+	}
+	bytes.writePosition(readLength);
+	if (isKtls())
+	{
+		// 内核接管发送后用户态不能再生成记录，如KeyUpdate或关闭通知
+		spdlog::debug("tls output {} bytes after ktls enabled, closing", readLength);
+		return false;
+	}
+	if (handshakeDone)
+	{
+		// 内存BIO中都是完整的记录，统计记录数作为内核TLS的起始序号
+		auto data = (const uint8_t*)bytes.data();
+		for (size_t offset = 0; offset + RECORD_HEADER_SIZE <= (size_t)readLength; ++sendSequence)
+		{
+			offset += RECORD_HEADER_SIZE + ((data[offset + 3] << 8) | data[offset + 4]);
+		}
+	}
+	output.push(std::make_shared<const ByteArray>(std::move(bytes)));
+	return true;
+}
+
+// socket thread
+bool TlsConnection::write(const void* data, size_t length)
+{
+	size_t written = 0;
+	if (SSL_write_ex(ssl, data, length, &written) != 1 || written != length)
+	{
+		spdlog::debug("tls write error: {}", lastError());
+		return false;
+	}
+	return true;
+}
+
+void TlsConnection::onHandshakeDone()
+{
+	if (!wantKtls || serverSecret.empty() || SSL_version(ssl) != TLS1_3_VERSION)
+	{
+		return;
+	}
+	auto cipherID = SSL_CIPHER_get_id(SSL_get_current_cipher(ssl)) & 0xFFFF;
+	// TLS_AES_128_GCM_SHA256和TLS_AES_256_GCM_SHA384
+	if (cipherID == 0x1301 || cipherID == 0x1302)
+	{
+		ktlsState = KtlsState::PENDING;
+	}
+}
+
+void TlsConnection::onKeyLog(const char* line)
+{
+	// 格式为"SERVER_TRAFFIC_SECRET_0 <client_random> <secret>"
+	static constexpr char LABEL[] = "SERVER_TRAFFIC_SECRET_0 ";
+	if (strncmp(line, LABEL, sizeof(LABEL) - 1) != 0)
+	{
+		return;
+	}
+	const char* secret = strchr(line + sizeof(LABEL) - 1, ' ');
+	if (!secret)
+	{
+		return;
+	}
+	serverSecret.clear();
+	for (++secret; secret[0] && secret[1]; secret += 2)
+	{
+		char hex[3] = { secret[0], secret[1], 0 };
+		serverSecret.push_back((uint8_t)strtoul(hex, nullptr, 16));
+	}
+}
+
+// socket thread
+bool TlsConnection::enableKtls(Socket sock)
+{
+	if (ktlsState != KtlsState::PENDING)
+	{
+		return false;
+	}
+	ktlsState = KtlsState::NONE;
+#ifdef __linux__
+	if (setsockopt(sock, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0)
+	{
+		spdlog::debug("tls ulp is not available: {}", strerror(errno));
+		return false;
+	}
+	bool result = false;
+	if ((SSL_CIPHER_get_id(SSL_get_current_cipher(ssl)) & 0xFFFF) == 0x1301)
+	{
+		result = setKtlsKey<tls12_crypto_info_aes_gcm_128>(sock, TLS_CIPHER_AES_GCM_128, EVP_sha256(), serverSecret, sendSequence);
+	}
+	else
+	{
+		result = setKtlsKey<tls12_crypto_info_aes_gcm_256>(sock, TLS_CIPHER_AES_GCM_256, EVP_sha384(), serverSecret, sendSequence);
+	}
+	OPENSSL_cleanse(serverSecret.data(), serverSecret.size());
+	serverSecret.clear();
+	if (!result)
+	{
+		spdlog::debug("set ktls tx key error: {}", strerror(errno));
+		return false;
+	}
+	ktlsState = KtlsState::ENABLED;
+	return true;
+#else
+	return false;
+#endif
+}
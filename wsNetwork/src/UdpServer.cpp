@@ -0,0 +1,567 @@
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include "ws/network/UdpServer.h"
+#include "ws/core/TimeTool.h"
+#ifdef __linux__
+#include <netinet/udp.h>
+#endif
+
+using namespace ws::network;
+using namespace ws::core;
+
+namespace
+{
+	constexpr uint32_t DEFAULT_MAX_SESSIONS = 5000;
+	constexpr uint32_t DEFAULT_BATCH_SIZE = 64;
+	constexpr uint32_t DEFAULT_DATAGRAM_SIZE = 1472;	// 以太网MTU减去IP和UDP头
+	constexpr uint32_t DEFAULT_MAX_RECV = 4096;
+	constexpr size_t MAX_UDP_PAYLOAD = 65507;
+#ifdef __linux__
+#ifndef UDP_SEGMENT
+	constexpr int UDP_SEGMENT = 103;
+#endif
+#ifndef UDP_GRO
+	constexpr int UDP_GRO = 104;
+#endif
+	constexpr size_t MAX_GSO_SEGMENTS = 64;
+	constexpr size_t GRO_BUFFER_SIZE = 65535;
+	constexpr size_t SEND_CONTROL_SIZE = CMSG_SPACE(sizeof(uint16_t));
+	constexpr size_t RECV_CONTROL_SIZE = CMSG_SPACE(sizeof(int));
+#endif
+}
+
+//===================== UdpSession Implements ========================
+std::string UdpSession::getIP() const
+{
+	char buffer[INET_ADDRSTRLEN] = { 0 };
+	inet_ntop(AF_INET, (void*)&addr.sin_addr, buffer, sizeof(buffer));
+	return buffer;
+}
+
+// main thread
+void UdpSession::send(const void* data, size_t length)
+{
+	pushPacket(std::make_shared<const ByteArray>(data, length, true));
+}
+
+// main thread
+void UdpSession::send(const ByteArray& packet)
+{
+	pushPacket(std::make_shared<const ByteArray>(packet.data(), packet.size(), true));
+}
+
+// main thread
+void UdpSession::send(ByteArray&& packet)
+{
+	pushPacket(std::make_shared<const ByteArray>(std::move(packet)));
+}
+
+// main thread
+void UdpSession::send(PacketPtr packet)
+{
+	pushPacket(std::move(packet));
+}
+
+// main thread
+void UdpSession::pushPacket(PacketPtr packet)
+{
+	// 不经过虚函数，派生类重写send后仍可用UdpSession::send发出原始数据报
+	if (!server || isClosing || !packet || !packet->size() || server->isLost())
+	{
+		return;
+	}
+	if (packet->size() > server->config.maxDatagramSize)
+	{
+		spdlog::error("udp datagram size {} exceeds {}", packet->size(), server->config.maxDatagramSize);
+		return;
+	}
+	sendQueue.push_back(std::move(packet));
+	server->markDirty(*this);
+}
+
+// main thread
+void UdpSession::kick()
+{
+	isClosing = true;
+	if (server)
+	{
+		server->markDirty(*this);
+	}
+}
+
+//===================== UdpServer Implements ========================
+// main thread
+bool UdpServer::init(const UdpConfig& cfg)
+{
+	if (!cfg.createSession)
+	{
+		spdlog::error("interface createSession must be implement!");
+		return false;
+	}
+	config = cfg;
+	if (!config.maxSessions)
+	{
+		config.maxSessions = DEFAULT_MAX_SESSIONS;
+	}
+	if (!config.batchSize)
+	{
+		config.batchSize = DEFAULT_BATCH_SIZE;
+	}
+	if (!config.maxDatagramSize || config.maxDatagramSize > MAX_UDP_PAYLOAD)
+	{
+		config.maxDatagramSize = DEFAULT_DATAGRAM_SIZE;
+	}
+	if (!config.maxRecvPerUpdate)
+	{
+		config.maxRecvPerUpdate = DEFAULT_MAX_RECV;
+	}
+#ifndef __linux__
+	config.enableGso = config.enableGro = false;
+#endif
+	return true;
+}
+
+// main thread
+bool UdpServer::startListen()
+{
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		spdlog::error("WSAStartup error");
+		return false;
+	}
+#endif
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock == (Socket)-1)
+	{
+		spdlog::error("create udp socket error.");
+		return false;
+	}
+#ifdef _WIN32
+	u_long nonBlock = 1;
+	ioctlsocket(sock, FIONBIO, &nonBlock);
+#else
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+#endif
+	if (config.socketBufferSize)
+	{
+		setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&config.socketBufferSize, sizeof(config.socketBufferSize));
+		setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const char*)&config.socketBufferSize, sizeof(config.socketBufferSize));
+	}
+
+	sockaddr_in srvAddr;
+	memset(&srvAddr, 0, sizeof(srvAddr));
+	inet_pton(AF_INET, config.listenAddr.c_str(), &srvAddr.sin_addr);
+	srvAddr.sin_family = AF_INET;
+	srvAddr.sin_port = htons(config.listenPort);
+	if (bind(sock, (sockaddr*)&srvAddr, sizeof(srvAddr)) != 0)
+	{
+		spdlog::error("bind udp port {} error. errno={}", config.listenPort, errno);
+		closeSocket();
+		return false;
+	}
+
+#ifdef __linux__
+	// 内核不支持时关闭，不影响收发
+	int optval = 0;
+	if (config.enableGso && setsockopt(sock, SOL_UDP, UDP_SEGMENT, &optval, sizeof(optval)) != 0)
+	{
+		spdlog::warn("UDP_SEGMENT is not supported, gso disabled");
+		config.enableGso = false;
+	}
+	optval = 1;
+	if (config.enableGro && setsockopt(sock, SOL_UDP, UDP_GRO, &optval, sizeof(optval)) != 0)
+	{
+		spdlog::warn("UDP_GRO is not supported, gro disabled");
+		config.enableGro = false;
+	}
+	// GRO合并后的数据报最大为64K
+	recvSegmentSize = config.enableGro ? GRO_BUFFER_SIZE : config.maxDatagramSize;
+	recvBuffer.resize(recvSegmentSize * config.batchSize);
+	recvMsgs.resize(config.batchSize);
+	recvIovs.resize(config.batchSize);
+	recvAddrs.resize(config.batchSize);
+	recvControls.resize(RECV_CONTROL_SIZE * config.batchSize);
+	for (uint32_t i = 0; i < config.batchSize; ++i)
+	{
+		recvIovs[i].iov_base = &recvBuffer[recvSegmentSize * i];
+		auto& msg = recvMsgs[i].msg_hdr;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &recvAddrs[i];
+		msg.msg_iov = &recvIovs[i];
+		msg.msg_iovlen = 1;
+		msg.msg_control = &recvControls[RECV_CONTROL_SIZE * i];
+	}
+#else
+	recvSegmentSize = config.maxDatagramSize;
+	recvBuffer.resize(recvSegmentSize);
+#endif
+	spdlog::info("udp server is listening port {}", config.listenPort);
+	return true;
+}
+
+// main thread
+void UdpServer::update()
+{
+	if (sock == (Socket)-1)
+	{
+		return;
+	}
+	uint64_t now = TimeTool::getTickCount();
+	receiveDatagrams(now);
+	kickIdleSessions(now);
+	for (auto& [key, session] : sessions)
+	{
+		if (!session->isClosing)
+		{
+			session->onUpdate(now);
+		}
+	}
+	flushSessions();
+}
+
+// main thread
+void UdpServer::cleanup()
+{
+	for (auto& session : dirtySessions)
+	{
+		session->isDirty = false;
+	}
+	dirtySessions.clear();
+	auto allSessions = std::move(sessions);
+	sessions.clear();
+	for (auto& [key, session] : allSessions)
+	{
+		session->isClosing = true;
+		destroySession(session);
+	}
+	closeSocket();
+}
+
+// main thread
+UdpSessionPtr UdpServer::getSession(const sockaddr_in& addr)
+{
+	auto iter = sessions.find(addressKey(addr));
+	return iter != sessions.end() ? iter->second : nullptr;
+}
+
+// main thread
+UdpSessionPtr UdpServer::connect(const std::string& ip, uint16_t port)
+{
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) != 1)
+	{
+		spdlog::error("invalid udp address {}", ip);
+		return nullptr;
+	}
+	if (auto session = getSession(addr))
+	{
+		return session;
+	}
+	return createSession(addr, TimeTool::getTickCount());
+}
+
+uint64_t UdpServer::addressKey(const sockaddr_in& addr)
+{
+	return ((uint64_t)addr.sin_addr.s_addr << 16) | addr.sin_port;
+}
+
+// main thread
+void UdpServer::receiveDatagrams(uint64_t now)
+{
+	uint32_t numReceived = 0;
+#ifdef __linux__
+	// 一次系统调用接收多个数据报
+	while (numReceived < config.maxRecvPerUpdate)
+	{
+		uint32_t batch = std::min(config.batchSize, config.maxRecvPerUpdate - numReceived);
+		for (uint32_t i = 0; i < batch; ++i)
+		{
+			recvIovs[i].iov_len = recvSegmentSize;
+			recvMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			recvMsgs[i].msg_hdr.msg_controllen = config.enableGro ? RECV_CONTROL_SIZE : 0;
+		}
+		int count = recvmmsg(sock, recvMsgs.data(), batch, MSG_DONTWAIT, nullptr);
+		if (count <= 0)
+		{
+			if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				spdlog::error("recvmmsg error: {}", strerror(errno));
+			}
+			break;
+		}
+		for (int i = 0; i < count; ++i)
+		{
+			auto& msg = recvMsgs[i].msg_hdr;
+			if (msg.msg_flags & MSG_TRUNC)
+			{
+				continue;
+			}
+			const uint8_t* data = &recvBuffer[recvSegmentSize * i];
+			size_t length = recvMsgs[i].msg_len;
+			// GRO合并的数据报按原始大小拆分，最后一个可能更短
+			size_t segmentSize = length;
+			for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+			{
+				if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+				{
+					int size = 0;
+					memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+					segmentSize = size > 0 ? (size_t)size : length;
+				}
+			}
+			for (size_t offset = 0; offset < length; offset += segmentSize)
+			{
+				dispatchDatagram(recvAddrs[i], { data + offset, std::min(segmentSize, length - offset) }, now);
+			}
+		}
+		numReceived += count;
+		if ((uint32_t)count < batch)
+		{
+			break;
+		}
+	}
+#else
+	while (numReceived < config.maxRecvPerUpdate)
+	{
+		sockaddr_in from;
+		socklen_t addrlen = sizeof(from);
+		int length = (int)recvfrom(sock, (char*)recvBuffer.data(), (int)recvSegmentSize, 0, (sockaddr*)&from, &addrlen);
+		if (length < 0)
+		{
+			break;
+		}
+		dispatchDatagram(from, { recvBuffer.data(), (size_t)length }, now);
+		++numReceived;
+	}
+#endif
+}
+
+// main thread
+void UdpServer::dispatchDatagram(const sockaddr_in& from, std::span<const uint8_t> datagram, uint64_t now)
+{
+	if (isLost())
+	{
+		return;
+	}
+	UdpSessionPtr session;
+	auto iter = sessions.find(addressKey(from));
+	if (iter != sessions.end())
+	{
+		session = iter->second;
+	}
+	else
+	{
+		session = createSession(from, now);
+		if (!session)
+		{
+			return;
+		}
+	}
+	if (session->isClosing)
+	{
+		return;
+	}
+	session->lastActiveTime = now;
+	session->onPacket(datagram);
+}
+
+// main thread
+UdpSessionPtr UdpServer::createSession(const sockaddr_in& addr, uint64_t now)
+{
+	if (sessions.size() >= config.maxSessions)
+	{
+		return nullptr;
+	}
+	auto session = config.createSession();
+	session->id = ++nextSessionID;
+	session->addr = addr;
+	session->server = this;
+	session->lastActiveTime = now;
+	sessions.emplace(addressKey(addr), session);
+	if (config.onSessionCreated)
+	{
+		config.onSessionCreated(session);
+	}
+	return session;
+}
+
+// main thread
+bool UdpServer::isLost()
+{
+	return config.lossRate > 0 && std::uniform_real_distribution<double>(0, 1)(lossRandom) < config.lossRate;
+}
+
+// main thread
+void UdpServer::markDirty(UdpSession& session)
+{
+	if (!session.isDirty)
+	{
+		session.isDirty = true;
+		dirtySessions.push_back(session.shared_from_this());
+	}
+}
+
+// main thread
+void UdpServer::flushSessions()
+{
+	if (dirtySessions.empty())
+	{
+		return;
+	}
+#ifdef __linux__
+	size_t numPackets = 0;
+	for (auto& session : dirtySessions)
+	{
+		numPackets += session->sendQueue.size();
+	}
+	// 每个数据报最多占用一个消息，提前分配保证指针不失效
+	sendMsgs.resize(std::max(sendMsgs.size(), numPackets));
+	sendIovs.resize(std::max(sendIovs.size(), numPackets));
+	sendControls.resize(std::max(sendControls.size(), numPackets * SEND_CONTROL_SIZE));
+	size_t numMsgs = 0, numIovs = 0;
+	for (auto& session : dirtySessions)
+	{
+		auto& queue = session->sendQueue;
+		for (size_t i = 0; i < queue.size();)
+		{
+			// GSO时合并后续等长的数据报，由内核按segmentSize拆分，最后一个可以更短
+			size_t segmentSize = queue[i]->size();
+			size_t count = 1, total = segmentSize;
+			while (config.enableGso && i + count < queue.size() && count < MAX_GSO_SEGMENTS)
+			{
+				size_t size = queue[i + count]->size();
+				if (size > segmentSize || total + size > MAX_UDP_PAYLOAD)
+				{
+					break;
+				}
+				total += size;
+				++count;
+				if (size < segmentSize)
+				{
+					break;
+				}
+			}
+			auto& msg = sendMsgs[numMsgs].msg_hdr;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_name = &session->addr;
+			msg.msg_namelen = sizeof(sockaddr_in);
+			msg.msg_iov = &sendIovs[numIovs];
+			msg.msg_iovlen = count;
+			for (size_t k = 0; k < count; ++k)
+			{
+				auto& packet = queue[i + k];
+				sendIovs[numIovs].iov_base = const_cast<void*>(packet->data());
+				sendIovs[numIovs].iov_len = packet->size();
+				++numIovs;
+			}
+			if (count > 1)
+			{
+				msg.msg_control = &sendControls[SEND_CONTROL_SIZE * numMsgs];
+				msg.msg_controllen = SEND_CONTROL_SIZE;
+				cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+				cmsg->cmsg_level = SOL_UDP;
+				cmsg->cmsg_type = UDP_SEGMENT;
+				cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+				uint16_t gsoSize = (uint16_t)segmentSize;
+				memcpy(CMSG_DATA(cmsg), &gsoSize, sizeof(gsoSize));
+			}
+			++numMsgs;
+			i += count;
+		}
+	}
+	// 一次系统调用发送多个消息，发送缓冲区满时丢弃剩余的数据报
+	for (size_t sent = 0; sent < numMsgs;)
+	{
+		int count = sendmmsg(sock, &sendMsgs[sent], (unsigned)std::min<size_t>(config.batchSize, numMsgs - sent), 0);
+		if (count > 0)
+		{
+			sent += count;
+			continue;
+		}
+		if (errno == EINTR)
+		{
+			continue;
+		}
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			spdlog::debug("udp send buffer is full, drop {} messages", numMsgs - sent);
+			break;
+		}
+		// 单个消息出错只跳过它
+		spdlog::error("sendmmsg error: {}", strerror(errno));
+		++sent;
+	}
+#else
+	for (auto& session : dirtySessions)
+	{
+		for (auto& packet : session->sendQueue)
+		{
+			sendto(sock, (const char*)packet->data(), (int)packet->size(), 0, (sockaddr*)&session->addr, sizeof(sockaddr_in));
+		}
+	}
+#endif
+	auto flushing = std::move(dirtySessions);
+	dirtySessions.clear();
+	for (auto& session : flushing)
+	{
+		session->isDirty = false;
+		session->sendQueue.clear();
+		if (session->isClosing && session->server)
+		{
+			sessions.erase(addressKey(session->addr));
+			destroySession(session);
+		}
+	}
+}
+
+// main thread
+void UdpServer::kickIdleSessions(uint64_t now)
+{
+	if (!config.kickTime || now < nextKickTime)
+	{
+		return;
+	}
+	// UDP没有连接状态，定期扫描一次
+	nextKickTime = now + std::min<uint64_t>(config.kickTime, 1000);
+	for (auto& [key, session] : sessions)
+	{
+		if (!session->isClosing && now - session->lastActiveTime >= config.kickTime)
+		{
+			session->kick();
+		}
+	}
+}
+
+// main thread
+void UdpServer::destroySession(UdpSessionPtr session)
+{
+	if (config.onSessionDestroyed)
+	{
+		config.onSessionDestroyed(session);
+	}
+	session->onDisconnected();
+	session->server = nullptr;
+}
+
+// main thread
+void UdpServer::closeSocket()
+{
+	if (sock == (Socket)-1)
+	{
+		return;
+	}
+#ifdef _WIN32
+	closesocket(sock);
+	WSACleanup();
+#else
+	close(sock);
+#endif
+	sock = (Socket)-1;
+}
@@ -0,0 +1,787 @@
+#include <string.h>
+#include <algorithm>
+#include <zlib.h>
+#include <openssl/evp.h>
+#include <spdlog/spdlog.h>
+#include "ws/core/String.h"
+#include "ws/network/WebSocket.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+
+using namespace ws::network;
+using namespace ws::core;
+using String::iequals;
+using String::trim;
+
+namespace
+{
+	constexpr size_t MAX_HANDSHAKE_SIZE = 8192;
+	constexpr size_t MAX_HEADER_SIZE = 10;
+	constexpr size_t MAX_CONTROL_PAYLOAD = 125;
+	constexpr char ACCEPT_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+	// 压缩消息去掉的同步刷新结尾
+	constexpr uint8_t DEFLATE_TAIL[] = { 0x00, 0x00, 0xFF, 0xFF };
+
+	enum CloseCode : uint16_t
+	{
+		CLOSE_NORMAL = 1000,
+		CLOSE_PROTOCOL_ERROR = 1002,
+		CLOSE_NO_STATUS = 1005,
+		CLOSE_INVALID_DATA = 1007,
+		CLOSE_TOO_BIG = 1009,
+	};
+
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef __GNUC__
+#define WS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define WS_TARGET_AVX2
+#endif
+
+	bool hasAvx2()
+	{
+#ifdef __GNUC__
+		// 在静态初始化中调用，需要先初始化cpu信息
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#else
+		// 还需要确认操作系统保存了YMM寄存器
+		int info[4];
+		__cpuid(info, 1);
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#endif
+	}
+
+	// 返回处理的字节数，总是4的倍数，保证剩余部分的掩码位置不变
+	WS_TARGET_AVX2 size_t maskAvx2(uint8_t* data, size_t length, uint32_t mask)
+	{
+		const __m256i mask256 = _mm256_set1_epi32((int)mask);
+		size_t i = 0;
+		for (; i + 64 <= length; i += 64)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+			__m256i b = _mm256_loadu_si256((const __m256i*)(data + i + 32));
+			_mm256_storeu_si256((__m256i*)(data + i), _mm256_xor_si256(a, mask256));
+			_mm256_storeu_si256((__m256i*)(data + i + 32), _mm256_xor_si256(b, mask256));
+		}
+		for (; i + 32 <= length; i += 32)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)(data + i));
+			_mm256_storeu_si256((__m256i*)(data + i), _mm256_xor_si256(a, mask256));
+		}
+		return i;
+	}
+
+	size_t maskSse2(uint8_t* data, size_t length, uint32_t mask)
+	{
+		const __m128i mask128 = _mm_set1_epi32((int)mask);
+		size_t i = 0;
+		for (; i + 16 <= length; i += 16)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(data + i));
+			_mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(a, mask128));
+		}
+		return i;
+	}
+
+	const bool USE_AVX2 = hasAvx2();
+#endif
+
+	// 按分隔符遍历，每段去掉首尾空白
+	template<class Func>
+	void forEachToken(std::string_view str, char separator, Func&& func)
+	{
+		while (!str.empty())
+		{
+			size_t pos = str.find(separator);
+			func(trim(str.substr(0, pos)));
+			if (pos == std::string_view::npos)
+			{
+				break;
+			}
+			str.remove_prefix(pos + 1);
+		}
+	}
+
+	// RFC 3629，拒绝过长编码、代理区和超过U+10FFFF的码点
+	bool isValidUtf8(std::span<const uint8_t> data)
+	{
+		size_t i = 0;
+		while (i < data.size())
+		{
+			//ASCII快速路径，一次检查8字节
+			while (i + 8 <= data.size())
+			{
+				uint64_t word;
+				memcpy(&word, data.data() + i, sizeof(word));
+				if (word & 0x8080808080808080ull)
+				{
+					break;
+				}
+				i += 8;
+			}
+			if (i == data.size())
+			{
+				break;
+			}
+			uint8_t c = data[i];
+			if (c < 0x80)
+			{
+				++i;
+				continue;
+			}
+			size_t length;
+			uint8_t low = 0x80, high = 0xBF;
+			if (c >= 0xC2 && c <= 0xDF)
+			{
+				length = 2;
+			}
+			else if (c >= 0xE0 && c <= 0xEF)
+			{
+				length = 3;
+				if (c == 0xE0)
+				{
+					low = 0xA0;
+				}
+				else if (c == 0xED)
+				{
+					high = 0x9F;
+				}
+			}
+			else if (c >= 0xF0 && c <= 0xF4)
+			{
+				length = 4;
+				if (c == 0xF0)
+				{
+					low = 0x90;
+				}
+				else if (c == 0xF4)
+				{
+					high = 0x8F;
+				}
+			}
+			else
+			{
+				return false;
+			}
+			if (i + length > data.size() || data[i + 1] < low || data[i + 1] > high)
+			{
+				return false;
+			}
+			for (size_t j = 2; j < length; ++j)
+			{
+				if ((data[i + j] & 0xC0) != 0x80)
+				{
+					return false;
+				}
+			}
+			i += length;
+		}
+		return true;
+	}
+
+	size_t writeFrameHeader(uint8_t* header, WsOpcode opcode, size_t length, bool isCompressed)
+	{
+		header[0] = 0x80 | (isCompressed ? 0x40 : 0) | (uint8_t)opcode;
+		if (length < 126)
+		{
+			header[1] = (uint8_t)length;
+			return 2;
+		}
+		if (length <= 0xFFFF)
+		{
+			header[1] = 126;
+			header[2] = (uint8_t)(length >> 8);
+			header[3] = (uint8_t)length;
+			return 4;
+		}
+		header[1] = 127;
+		for (int i = 0; i < 8; ++i)
+		{
+			header[2 + i] = (uint8_t)((uint64_t)length >> (56 - i * 8));
+		}
+		return 10;
+	}
+}
+
+void ws::network::applyWebSocketMask(uint8_t* data, size_t length, uint32_t mask)
+{
+	size_t i = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+	if (USE_AVX2)
+	{
+		i = maskAvx2(data, length, mask);
+	}
+	i += maskSse2(data + i, length - i, mask);
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	const uint8x16_t mask128 = vreinterpretq_u8_u32(vdupq_n_u32(mask));
+	for (; i + 16 <= length; i += 16)
+	{
+		vst1q_u8(data + i, veorq_u8(vld1q_u8(data + i), mask128));
+	}
+#endif
+	// 剩余部分按8字节处理，两个掩码拼接后的字节顺序与大小端无关
+	const uint64_t mask64 = ((uint64_t)mask << 32) | mask;
+	for (; i + 8 <= length; i += 8)
+	{
+		uint64_t value;
+		memcpy(&value, data + i, sizeof(value));
+		value ^= mask64;
+		memcpy(data + i, &value, sizeof(value));
+	}
+	auto maskBytes = (const uint8_t*)&mask;
+	for (; i < length; ++i)
+	{
+		data[i] ^= maskBytes[i & 3];
+	}
+}
+
+//===================== WebSocketClient Implements ========================
+WebSocketClient::WebSocketClient(const WebSocketConfig& cfg) : config(cfg)
+{
+}
+
+WebSocketClient::~WebSocketClient()
+{
+	if (deflater)
+	{
+		deflateEnd(deflater);
+		delete deflater;
+	}
+	if (inflater)
+	{
+		inflateEnd(inflater);
+		delete inflater;
+	}
+}
+
+// main thread
+void WebSocketClient::sendText(std::string_view text)
+{
+	if (state == State::OPEN)
+	{
+		sendFrame(WsOpcode::TEXT, text.data(), text.size());
+	}
+}
+
+// main thread
+void WebSocketClient::sendBinary(const void* data, size_t length)
+{
+	if (state == State::OPEN)
+	{
+		sendFrame(WsOpcode::BINARY, data, length);
+	}
+}
+
+// main thread
+void WebSocketClient::ping(std::string_view payload)
+{
+	if (state == State::OPEN)
+	{
+		sendFrame(WsOpcode::PING, payload.data(), std::min(payload.size(), MAX_CONTROL_PAYLOAD));
+	}
+}
+
+// main thread
+void WebSocketClient::close(uint16_t code, std::string_view reason)
+{
+	if (state != State::OPEN)
+	{
+		return;
+	}
+	uint8_t payload[MAX_CONTROL_PAYLOAD];
+	payload[0] = (uint8_t)(code >> 8);
+	payload[1] = (uint8_t)code;
+	size_t reasonLength = std::min(reason.size(), MAX_CONTROL_PAYLOAD - 2);
+	memcpy(payload + 2, reason.data(), reasonLength);
+	sendFrame(WsOpcode::CLOSE, payload, reasonLength + 2);
+	state = State::CLOSING;
+}
+
+PacketPtr WebSocketClient::makeFrame(WsOpcode opcode, const void* data, size_t length)
+{
+	ByteArray frame(MAX_HEADER_SIZE + length);
+	size_t headerSize = writeFrameHeader((uint8_t*)frame.data(), opcode, length, false);
+	memcpy(frame.data(headerSize), data, length);
+	frame.writePosition(headerSize + length);
+	return std::make_shared<const ByteArray>(std::move(frame));
+}
+
+// main thread
+void WebSocketClient::onRecv()
+{
+	if (state != State::HANDSHAKE || handshake())
+	{
+		parseFrames();
+	}
+	if (state == State::CLOSED)
+	{
+		readerBuffer.truncate();
+	}
+	else if (readerBuffer.readPosition() && readerBuffer.readAvailable())
+	{
+		// 未完成的帧移到缓冲区头部
+		readerBuffer.cutHead(readerBuffer.readPosition());
+	}
+}
+
+// main thread, 握手完成时返回true
+bool WebSocketClient::handshake()
+{
+	std::string_view request((const char*)readerBuffer.readerPointer(), readerBuffer.readAvailable());
+	size_t end = request.find("\r\n\r\n");
+	if (end == std::string_view::npos)
+	{
+		if (request.size() > MAX_HANDSHAKE_SIZE)
+		{
+			spdlog::debug("websocket handshake of client {} is too large", id);
+			state = State::CLOSED;
+			kick();
+		}
+		return false;
+	}
+	request = request.substr(0, end);
+
+	// 请求行
+	size_t lineEnd = request.find("\r\n");
+	std::string_view requestLine = request.substr(0, lineEnd);
+	std::string_view path;
+	bool isValid = requestLine.starts_with("GET ");
+	if (isValid)
+	{
+		requestLine.remove_prefix(4);
+		path = requestLine.substr(0, requestLine.find(' '));
+	}
+
+	std::string_view upgrade, connection, key, version, extensions;
+	request.remove_prefix(lineEnd == std::string_view::npos ? request.size() : lineEnd + 2);
+	while (isValid && !request.empty())
+	{
+		lineEnd = request.find("\r\n");
+		std::string_view line = request.substr(0, lineEnd);
+		request.remove_prefix(lineEnd == std::string_view::npos ? request.size() : lineEnd + 2);
+		size_t colon = line.find(':');
+		if (colon == std::string_view::npos)
+		{
+			isValid = false;
+			break;
+		}
+		std::string_view name = trim(line.substr(0, colon));
+		std::string_view value = trim(line.substr(colon + 1));
+		if (iequals(name, "Upgrade"))
+		{
+			upgrade = value;
+		}
+		else if (iequals(name, "Connection"))
+		{
+			connection = value;
+		}
+		else if (iequals(name, "Sec-WebSocket-Key"))
+		{
+			key = value;
+		}
+		else if (iequals(name, "Sec-WebSocket-Version"))
+		{
+			version = value;
+		}
+		else if (iequals(name, "Sec-WebSocket-Extensions"))
+		{
+			extensions = value;
+		}
+	}
+	bool hasUpgradeToken = false;
+	forEachToken(connection, ',', [&hasUpgradeToken](std::string_view token) { hasUpgradeToken |= iequals(token, "Upgrade"); });
+	isValid = isValid && hasUpgradeToken && iequals(upgrade, "websocket") && version == "13" && !key.empty();
+
+	std::string_view pathOnly = path.substr(0, path.find('?'));
+	const char* failStatus = nullptr;
+	if (!isValid)
+	{
+		failStatus = "400 Bad Request";
+	}
+	else if (!config.path.empty() && pathOnly != config.path)
+	{
+		failStatus = "404 Not Found";
+	}
+	else if (!onHandshake(path))
+	{
+		failStatus = "403 Forbidden";
+	}
+	if (failStatus)
+	{
+		std::string response = fmt::format("HTTP/1.1 {}\r\nConnection: close\r\nContent-Length: 0\r\n\r\n", failStatus);
+		send(response.data(), response.size());
+		state = State::CLOSED;
+		kick();
+		return false;
+	}
+
+	// Sec-WebSocket-Accept为key拼接GUID后的SHA1的base64
+	std::string acceptKey(key);
+	acceptKey += ACCEPT_GUID;
+	unsigned char digest[EVP_MAX_MD_SIZE];
+	unsigned int digestLength = 0;
+	EVP_Digest(acceptKey.data(), acceptKey.size(), digest, &digestLength, EVP_sha1(), nullptr);
+	char accept[64];
+	EVP_EncodeBlock((unsigned char*)accept, digest, (int)digestLength);
+
+	std::string extensionResponse;
+	if (config.enableDeflate && !extensions.empty())
+	{
+		negotiateDeflate(extensions, extensionResponse);
+	}
+	std::string response = fmt::format("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+		"Sec-WebSocket-Accept: {}\r\n{}\r\n", accept, extensionResponse);
+	send(response.data(), response.size());
+	readerBuffer.seek((int)(end + 4));
+	state = State::OPEN;
+	onOpen();
+	return true;
+}
+
+// main thread, 从客户端的多个提议中选择第一个可以接受的permessage-deflate
+bool WebSocketClient::negotiateDeflate(std::string_view offers, std::string& response)
+{
+	bool isAccepted = false;
+	forEachToken(offers, ',', [this, &isAccepted, &response](std::string_view offer)
+		{
+			if (isAccepted)
+			{
+				return;
+			}
+			bool isFirst = true;
+			bool isValid = true;
+			int windowBits = 15;
+			forEachToken(offer, ';', [&](std::string_view param)
+				{
+					if (isFirst)
+					{
+						isValid = param == "permessage-deflate";
+						isFirst = false;
+						return;
+					}
+					std::string_view name = trim(param.substr(0, param.find('=')));
+					std::string_view value = param.find('=') == std::string_view::npos ? std::string_view() : trim(param.substr(param.find('=') + 1));
+					if (name == "server_max_window_bits")
+					{
+						// zlib不支持8位的窗口
+						windowBits = atoi(std::string(value).c_str());
+						isValid = isValid && windowBits >= 9 && windowBits <= 15;
+					}
+					else if (name != "server_no_context_takeover" && name != "client_no_context_takeover"
+						&& name != "client_max_window_bits")
+					{
+						isValid = false;
+					}
+				});
+			if (!isValid)
+			{
+				return;
+			}
+			isAccepted = true;
+			deflateWindowBits = windowBits;
+			// 双方都不保留上下文，每条消息独立压缩
+			response = "Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover; client_no_context_takeover";
+			if (windowBits != 15)
+			{
+				response += fmt::format("; server_max_window_bits={}", windowBits);
+			}
+			response += "\r\n";
+		});
+	if (!isAccepted)
+	{
+		return false;
+	}
+	deflater = new z_stream();
+	inflater = new z_stream();
+	if (deflateInit2(deflater, config.deflateLevel, Z_DEFLATED, -deflateWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK
+		|| inflateInit2(inflater, -15) != Z_OK)
+	{
+		spdlog::error("init zlib stream error");
+		response.clear();
+		deflateEnd(deflater);
+		delete deflater;
+		deflater = nullptr;
+		delete inflater;
+		inflater = nullptr;
+		return false;
+	}
+	return true;
+}
+
+// main thread
+bool WebSocketClient::parseFrames()
+{
+	while (state == State::OPEN || state == State::CLOSING)
+	{
+		size_t available = readerBuffer.readAvailable();
+		if (available < 2)
+		{
+			break;
+		}
+		auto frame = (uint8_t*)readerBuffer.data(readerBuffer.readPosition());
+		bool isFinal = frame[0] & 0x80;
+		bool isRsv1 = frame[0] & 0x40;
+		auto opcode = (WsOpcode)(frame[0] & 0x0F);
+		bool isControl = (uint8_t)opcode & 0x08;
+		// 客户端发出的帧必须带掩码，RSV2和RSV3没有定义，控制帧不能分片和压缩
+		if ((frame[0] & 0x30) || !(frame[1] & 0x80) || (isControl && (!isFinal || isRsv1 || (frame[1] & 0x7F) > MAX_CONTROL_PAYLOAD)))
+		{
+			fail(CLOSE_PROTOCOL_ERROR);
+			return false;
+		}
+		uint64_t length = frame[1] & 0x7F;
+		size_t headerSize = 2;
+		if (length == 126)
+		{
+			if (available < 4)
+			{
+				break;
+			}
+			length = (frame[2] << 8) | frame[3];
+			headerSize = 4;
+		}
+		else if (length == 127)
+		{
+			if (available < 10)
+			{
+				break;
+			}
+			length = 0;
+			for (int i = 2; i < 10; ++i)
+			{
+				length = (length << 8) | frame[i];
+			}
+			headerSize = 10;
+		}
+		if (length > config.maxMessageSize)
+		{
+			fail(CLOSE_TOO_BIG);
+			return false;
+		}
+		headerSize += 4;
+		if (available < headerSize + length)
+		{
+			break;
+		}
+		uint32_t mask;
+		memcpy(&mask, frame + headerSize - 4, sizeof(mask));
+		uint8_t* payload = frame + headerSize;
+		applyWebSocketMask(payload, length, mask);
+		// 数据在缓冲区压缩前一直有效
+		readerBuffer.seek((int)(headerSize + length));
+		std::span<const uint8_t> payloadSpan(payload, length);
+		if (!(isControl ? onControlFrame(opcode, payloadSpan) : onFrame(opcode, isFinal, isRsv1, payloadSpan)))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// main thread
+bool WebSocketClient::onControlFrame(WsOpcode opcode, std::span<const uint8_t> payload)
+{
+	switch (opcode)
+	{
+	case WsOpcode::PING:
+		if (state == State::OPEN)
+		{
+			sendFrame(WsOpcode::PONG, payload.data(), payload.size());
+		}
+		return true;
+
+	case WsOpcode::PONG:
+		return true;
+
+	case WsOpcode::CLOSE:
+	{
+		if (payload.size() == 1)
+		{
+			fail(CLOSE_PROTOCOL_ERROR);
+			return false;
+		}
+		uint16_t code = payload.size() >= 2 ? (uint16_t)((payload[0] << 8) | payload[1]) : CLOSE_NO_STATUS;
+		if (state == State::OPEN)
+		{
+			// 回复相同的状态码
+			sendFrame(WsOpcode::CLOSE, payload.data(), std::min<size_t>(payload.size(), 2));
+		}
+		state = State::CLOSED;
+		onClose(code);
+		kick();
+		return false;
+	}
+
+	default:
+		fail(CLOSE_PROTOCOL_ERROR);
+		return false;
+	}
+}
+
+// main thread
+bool WebSocketClient::onFrame(WsOpcode opcode, bool isFinal, bool isRsv1, std::span<const uint8_t> payload)
+{
+	if (state == State::CLOSING)
+	{
+		// 已发送关闭帧，丢弃之后的数据
+		return true;
+	}
+	if (opcode == WsOpcode::CONTINUATION)
+	{
+		if (messageOpcode == WsOpcode::CONTINUATION || isRsv1)
+		{
+			fail(CLOSE_PROTOCOL_ERROR);
+			return false;
+		}
+		if (messageBuffer.size() + payload.size() > config.maxMessageSize)
+		{
+			fail(CLOSE_TOO_BIG);
+			return false;
+		}
+		messageBuffer.insert(messageBuffer.end(), payload.begin(), payload.end());
+		if (!isFinal)
+		{
+			return true;
+		}
+		opcode = messageOpcode;
+		messageOpcode = WsOpcode::CONTINUATION;
+		bool isOk = deliver(opcode, messageBuffer, isCompressed);
+		messageBuffer.clear();
+		return isOk;
+	}
+	if ((opcode != WsOpcode::TEXT && opcode != WsOpcode::BINARY) || messageOpcode != WsOpcode::CONTINUATION
+		|| (isRsv1 && !inflater))
+	{
+		fail(CLOSE_PROTOCOL_ERROR);
+		return false;
+	}
+	if (isFinal)
+	{
+		// 单帧消息直接引用接收缓冲区
+		return deliver(opcode, payload, isRsv1);
+	}
+	messageOpcode = opcode;
+	isCompressed = isRsv1;
+	messageBuffer.assign(payload.begin(), payload.end());
+	return true;
+}
+
+// main thread
+bool WebSocketClient::deliver(WsOpcode opcode, std::span<const uint8_t> data, bool compressed)
+{
+	if (compressed)
+	{
+		inflateReset(inflater);
+		size_t total = 0;
+		inflateBuffer.resize(std::min(std::max(data.size() * 4, (size_t)BUFFER_SIZE), config.maxMessageSize));
+		//最后一个块带BFINAL时inflate返回Z_STREAM_END，剩余输入和尾部都不再喂入
+		bool isStreamEnd = false;
+		for (auto input : { data, std::span<const uint8_t>(DEFLATE_TAIL) })
+		{
+			inflater->next_in = (Bytef*)input.data();
+			inflater->avail_in = (uInt)input.size();
+			while (!isStreamEnd && (inflater->avail_in || total == inflateBuffer.size()))
+			{
+				if (total == inflateBuffer.size())
+				{
+					if (total >= config.maxMessageSize)
+					{
+						fail(CLOSE_TOO_BIG);
+						return false;
+					}
+					inflateBuffer.resize(std::min(total * 2, config.maxMessageSize));
+				}
+				uInt availIn = inflater->avail_in;
+				inflater->next_out = inflateBuffer.data() + total;
+				inflater->avail_out = (uInt)(inflateBuffer.size() - total);
+				int result = inflate(inflater, Z_SYNC_FLUSH);
+				size_t produced = inflateBuffer.size() - inflater->avail_out - total;
+				total += produced;
+				isStreamEnd = result == Z_STREAM_END;
+				//既没消耗输入也没产生输出，说明数据有误，继续循环只会空转
+				if ((result != Z_OK && result != Z_BUF_ERROR && !isStreamEnd)
+					|| (!isStreamEnd && availIn && !produced && inflater->avail_in == availIn))
+				{
+					fail(CLOSE_INVALID_DATA);
+					return false;
+				}
+			}
+		}
+		data = std::span<const uint8_t>(inflateBuffer.data(), total);
+	}
+	// RFC 6455 8.1，文本消息必须是合法UTF-8，校验重组和解压后的完整消息
+	if (opcode == WsOpcode::TEXT && !isValidUtf8(data))
+	{
+		fail(CLOSE_INVALID_DATA);
+		return false;
+	}
+	onMessage(data, opcode == WsOpcode::TEXT);
+	return true;
+}
+
+// main thread
+void WebSocketClient::sendFrame(WsOpcode opcode, const void* data, size_t length)
+{
+	bool compressed = false;
+	if (deflater && length >= config.deflateThreshold && (opcode == WsOpcode::TEXT || opcode == WsOpcode::BINARY))
+	{
+		deflateReset(deflater);
+		deflateBuffer.resize(deflateBound(deflater, (uLong)length) + 16);
+		deflater->next_in = (Bytef*)data;
+		deflater->avail_in = (uInt)length;
+		size_t total = 0;
+		do
+		{
+			if (total == deflateBuffer.size())
+			{
+				deflateBuffer.resize(total * 2);
+			}
+			deflater->next_out = deflateBuffer.data() + total;
+			deflater->avail_out = (uInt)(deflateBuffer.size() - total);
+			deflate(deflater, Z_SYNC_FLUSH);
+			total = deflateBuffer.size() - deflater->avail_out;
+		} while (deflater->avail_in || !deflater->avail_out);
+		if (total >= sizeof(DEFLATE_TAIL) && memcmp(deflateBuffer.data() + total - sizeof(DEFLATE_TAIL), DEFLATE_TAIL, sizeof(DEFLATE_TAIL)) == 0)
+		{
+			total -= sizeof(DEFLATE_TAIL);
+		}
+		data = deflateBuffer.data();
+		length = total;
+		compressed = true;
+	}
+	ByteArray frame(MAX_HEADER_SIZE + length);
+	size_t headerSize = writeFrameHeader((uint8_t*)frame.data(), opcode, length, compressed);
+	memcpy(frame.data(headerSize), data, length);
+	frame.writePosition(headerSize + length);
+	send(std::move(frame));
+}
+
+// main thread
+void WebSocketClient::fail(uint16_t code)
+{
+	spdlog::debug("websocket client {} closed with {}", id, code);
+	if (state == State::OPEN)
+	{
+		uint8_t payload[2] = { (uint8_t)(code >> 8), (uint8_t)code };
+		sendFrame(WsOpcode::CLOSE, payload, sizeof(payload));
+	}
+	if (state != State::CLOSED)
+	{
+		state = State::CLOSED;
+		onClose(code);
+	}
+	kick();
+}